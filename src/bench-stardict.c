@@ -0,0 +1,527 @@
+/*
+ * bench-stardict.c: StarDict performance benchmarks
+ *
+ * Copyright (c) 2026, Přemysl Eric Janouch <p@janouch.name>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <errno.h>
+#include <time.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "stardict.h"
+#include "stardict-private.h"
+#include "generator.h"
+#include "utils.h"
+
+
+static struct
+{
+	gint entries;                       ///< Entries in each dictionary
+	gint definition_length;             ///< Average definition length
+	gint queries;                       ///< Operations per measurement
+	gint seed;                          ///< Random generator seed
+}
+g = { .entries = 100000, .definition_length = 200, .queries = 10000 };
+
+/// A kind of dictionary to measure
+typedef struct variant Variant;
+
+struct variant
+{
+	const gchar *name;                  ///< Name used within the output
+	gboolean dictzip;                   ///< Whether data is compressed
+	const gchar *collation;             ///< ICU collation locale, or NULL
+	gboolean synonyms;                  ///< Whether to include a .syn file
+};
+
+static const Variant g_variants[] =
+{
+	{ "plain",        FALSE, NULL, FALSE },
+	{ "plain-syn",    FALSE, NULL, TRUE  },
+	{ "plain-en",     FALSE, "en", FALSE },
+	{ "plain-en-syn", FALSE, "en", TRUE  },
+	{ "dz",           TRUE,  NULL, FALSE },
+	{ "dz-syn",       TRUE,  NULL, TRUE  },
+	{ "dz-en",        TRUE,  "en", FALSE },
+	{ "dz-en-syn",    TRUE,  "en", TRUE  },
+};
+
+// --- Utilities ---------------------------------------------------------------
+
+static gint64
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+static gdouble
+seconds_since (gint64 start)
+{
+	return (now_ns () - start) / 1e9;
+}
+
+/// Print out a measurement as a tab-separated line of output.
+static void
+report (const Variant *v, const gchar *metric, gdouble value, const gchar *unit)
+{
+	printf ("%s\t%s\t%.3f\t%s\n", v->name, metric, value, unit);
+}
+
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gint
+compare_int64 (gconstpointer a, gconstpointer b)
+{
+	gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+	return (x > y) - (x < y);
+}
+
+static gchar *
+generate_word (GRand *rand)
+{
+	gint length = g_rand_int_range (rand, 3, 13);
+	gchar *word = g_malloc (length + 1);
+	for (gint i = 0; i < length; i++)
+		word[i] = g_rand_int_range (rand, 'a', 'z' + 1);
+	word[length] = '\0';
+	return word;
+}
+
+/// Generate unique lower-case words, sorted the way StarDict wants them.
+static GPtrArray *
+generate_words (guint count, GRand *rand)
+{
+	GHashTable *set = g_hash_table_new (g_str_hash, g_str_equal);
+	GPtrArray *words = g_ptr_array_new_with_free_func (g_free);
+	while (words->len < count)
+	{
+		gchar *word = generate_word (rand);
+		if (g_hash_table_contains (set, word))
+			g_free (word);
+		else
+		{
+			g_hash_table_add (set, word);
+			g_ptr_array_add (words, word);
+		}
+	}
+	g_hash_table_destroy (set);
+
+	g_ptr_array_sort (words, compare_strings);
+	return words;
+}
+
+/// Compose a definition out of words, so that it compresses realistically.
+static gchar *
+generate_definition (GPtrArray *words, GRand *rand)
+{
+	gint length = g_rand_int_range (rand, 1, 2 * g.definition_length + 1);
+	GString *s = g_string_sized_new (length + 16);
+	while ((gint) s->len < length)
+	{
+		if (s->len)
+			g_string_append_c (s, ' ');
+		g_string_append (s, g_ptr_array_index (words,
+			g_rand_int_range (rand, 0, words->len)));
+	}
+	return g_string_free (s, FALSE);
+}
+
+static void
+remove_directory (const gchar *path)
+{
+	GDir *dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+	while (dir && (name = g_dir_read_name (dir)))
+	{
+		gchar *child = g_build_filename (path, name, NULL);
+		(void) g_unlink (child);
+		g_free (child);
+	}
+	if (dir)
+		g_dir_close (dir);
+	(void) g_rmdir (path);
+}
+
+// --- Generation --------------------------------------------------------------
+
+static gboolean
+write_synonyms (Generator *generator, const gchar *base,
+	guint count, GRand *rand, GError **error)
+{
+	gchar *path = g_strconcat (base, ".syn", NULL);
+	GFile *file = g_file_new_for_path (path);
+	g_free (path);
+
+	GFileOutputStream *stream = g_file_replace (file,
+		NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+	g_object_unref (file);
+	if (!stream)
+		return FALSE;
+
+	GDataOutputStream *data =
+		g_data_output_stream_new (G_OUTPUT_STREAM (stream));
+	g_data_output_stream_set_byte_order
+		(data, G_DATA_STREAM_BYTE_ORDER_BIG_ENDIAN);
+
+	guint n_entries = generator->info->word_count;
+	GPtrArray *synonyms = generate_words (count, rand);
+	gboolean ok = TRUE;
+	for (guint i = 0; ok && i < synonyms->len; i++)
+		ok = g_data_output_stream_put_string (data,
+				g_ptr_array_index (synonyms, i), NULL, error)
+			&& g_data_output_stream_put_byte (data, '\0', NULL, error)
+			&& g_data_output_stream_put_uint32 (data,
+				g_rand_int_range (rand, 0, n_entries), NULL, error);
+	ok = ok && g_output_stream_close (G_OUTPUT_STREAM (data), NULL, error);
+
+	generator->info->syn_word_count = synonyms->len;
+	g_ptr_array_free (synonyms, TRUE);
+	g_object_unref (data);
+	g_object_unref (stream);
+	return ok;
+}
+
+static void
+generate (const Variant *v, const gchar *base)
+{
+	GRand *rand = g_rand_new_with_seed (g.seed);
+	GPtrArray *words = generate_words (g.entries, rand);
+
+	GError *error = NULL;
+	Generator *generator = generator_new (base, v->dictzip, &error);
+	if (!generator)
+		fatal ("Error: failed to create a dictionary: %s\n", error->message);
+
+	StardictInfo *info = generator->info;
+	info->version = SD_VERSION_3_0_0;
+	info->book_name = g_strdup (v->name);
+	info->same_type_sequence = g_strdup ("m");
+	info->collation = g_strdup (v->collation);
+
+	for (guint i = 0; i < words->len; i++)
+	{
+		gchar *definition = generate_definition (words, rand);
+		generator_begin_entry (generator);
+		if (!generator_write_string (generator, definition, FALSE, &error)
+		 || !generator_finish_entry (generator,
+			g_ptr_array_index (words, i), &error))
+			fatal ("Error: failed to write an entry: %s\n", error->message);
+		g_free (definition);
+	}
+
+	if ((v->synonyms
+	  && !write_synonyms (generator, base, words->len / 4, rand, &error))
+	 || !generator_finish (generator, &error))
+		fatal ("Error: failed to finish the dictionary: %s\n", error->message);
+
+	generator_free (generator);
+	g_ptr_array_free (words, TRUE);
+	g_rand_free (rand);
+}
+
+// --- Measurements ------------------------------------------------------------
+
+static StardictDict *
+bench_load (const Variant *v, const gchar *ifo_path, const gchar *metric)
+{
+	GError *error = NULL;
+	gint64 start = now_ns ();
+	StardictDict *sd = stardict_dict_new (ifo_path, &error);
+	if (!sd)
+		fatal ("Error: opening the dictionary failed: %s\n", error->message);
+
+	report (v, metric, seconds_since (start), "s");
+	return sd;
+}
+
+/// Pick random words from the index, as well as mostly missing ones.
+static GPtrArray *
+pick_queries (StardictDict *sd, GRand *rand)
+{
+	guint32 n = stardict_info_get_word_count (stardict_dict_get_info (sd));
+	GPtrArray *queries = g_ptr_array_new_with_free_func (g_free);
+	for (gint i = 0; i < g.queries; i++)
+	{
+		if (i % 2)
+		{
+			g_ptr_array_add (queries, generate_word (rand));
+			continue;
+		}
+
+		StardictIterator *iterator =
+			stardict_iterator_new (sd, g_rand_int_range (rand, 0, n));
+		g_ptr_array_add (queries,
+			g_strdup (stardict_iterator_get_word (iterator)));
+		g_object_unref (iterator);
+	}
+	return queries;
+}
+
+static void
+bench_search (const Variant *v, StardictDict *sd, GPtrArray *queries)
+{
+	GArray *latencies = g_array_sized_new
+		(FALSE, FALSE, sizeof (gint64), queries->len);
+	for (guint i = 0; i < queries->len; i++)
+	{
+		gint64 start = now_ns ();
+		StardictIterator *iterator = stardict_dict_search
+			(sd, g_ptr_array_index (queries, i), NULL);
+		gint64 latency = now_ns () - start;
+		g_array_append_val (latencies, latency);
+		g_object_unref (iterator);
+	}
+
+	g_array_sort (latencies, compare_int64);
+	static const struct { const gchar *name; gdouble quantile; } points[] =
+	{
+		{ "search-p50", 0.50 }, { "search-p90", 0.90 },
+		{ "search-p99", 0.99 }, { "search-max", 1.00 },
+	};
+	for (gsize i = 0; latencies->len && i < G_N_ELEMENTS (points); i++)
+	{
+		guint k = (latencies->len - 1) * points[i].quantile;
+		report (v, points[i].name,
+			g_array_index (latencies, gint64, k) / 1e3, "us");
+	}
+	g_array_free (latencies, TRUE);
+}
+
+static gsize
+entry_size (StardictEntry *entry)
+{
+	gsize size = 0;
+	for (const GList *iter = stardict_entry_get_fields (entry);
+		 iter; iter = iter->next)
+		size += ((const StardictEntryField *) iter->data)->data_size;
+	return size;
+}
+
+static void
+bench_fetch (const Variant *v, StardictDict *sd, GRand *rand)
+{
+	// We want to see the cost of decoding entries, not of the cache
+	stardict_dict_set_entry_cache_limit (sd, 0);
+	guint32 n = stardict_info_get_word_count (stardict_dict_get_info (sd));
+
+	gsize bytes = 0;
+	gint64 start = now_ns ();
+	StardictScan *scan = stardict_scan_new (sd, 0, n, FALSE);
+	StardictIterator *iterator;
+	while ((iterator = stardict_scan_next (scan)))
+	{
+		StardictEntry *entry = stardict_iterator_get_entry (iterator);
+		bytes += entry_size (entry);
+		g_object_unref (entry);
+	}
+	stardict_scan_free (scan);
+
+	gdouble elapsed = seconds_since (start);
+	report (v, "fetch-sequential", n / elapsed, "entries/s");
+	report (v, "fetch-sequential-bytes", bytes / elapsed / 1e6, "MB/s");
+
+	start = now_ns ();
+	for (gint i = 0; i < g.queries; i++)
+	{
+		iterator = stardict_iterator_new (sd, g_rand_int_range (rand, 0, n));
+		g_object_unref (stardict_iterator_get_entry (iterator));
+		g_object_unref (iterator);
+	}
+	report (v, "fetch-random", g.queries / seconds_since (start),
+		"entries/s");
+}
+
+static void
+bench_prefix (const Variant *v, StardictDict *sd, GPtrArray *queries)
+{
+	// Pair each query with whatever the search lands on, which is what
+	// the user interfaces do in order to highlight the matching part
+	GPtrArray *found = g_ptr_array_new_with_free_func (g_free);
+	for (guint i = 0; i < queries->len; i++)
+	{
+		StardictIterator *iterator = stardict_dict_search
+			(sd, g_ptr_array_index (queries, i), NULL);
+		g_ptr_array_add (found,
+			g_strdup (stardict_iterator_get_word (iterator)));
+		g_object_unref (iterator);
+	}
+
+	gsize total = 0;
+	gint64 start = now_ns ();
+	for (guint i = 0; i < queries->len; i++)
+		total += stardict_longest_common_collation_prefix (sd,
+			g_ptr_array_index (queries, i), g_ptr_array_index (found, i));
+	gint64 elapsed = now_ns () - start;
+	g_ptr_array_free (found, TRUE);
+
+	if (queries->len)
+		report (v, "common-prefix", (gdouble) elapsed / queries->len, "ns");
+	report (v, "common-prefix-length",
+		queries->len ? (gdouble) total / queries->len : 0, "bytes");
+}
+
+static void
+measure (const Variant *v, const gchar *base)
+{
+	gchar *ifo_path = g_strconcat (base, ".ifo", NULL);
+
+	// The first load of a collated dictionary also writes a collation cache
+	g_object_unref (bench_load (v, ifo_path, "load"));
+	StardictDict *sd = bench_load (v, ifo_path, "load-again");
+	g_free (ifo_path);
+
+	GRand *rand = g_rand_new_with_seed (g.seed);
+	GPtrArray *queries = pick_queries (sd, rand);
+	bench_search (v, sd, queries);
+	bench_prefix (v, sd, queries);
+	bench_fetch (v, sd, rand);
+	g_ptr_array_free (queries, TRUE);
+	g_rand_free (rand);
+	g_object_unref (sd);
+
+	struct rusage usage;
+	if (!getrusage (RUSAGE_SELF, &usage))
+		report (v, "peak-rss", usage.ru_maxrss, "KiB");
+}
+
+// --- Main --------------------------------------------------------------------
+
+/// GLib's shared thread pools don't survive fork(), so the parent process
+/// mustn't use any.  Each phase gets its own process, which also makes
+/// the peak RSS specific to it.
+static void
+run_in_child (void (*phase) (const Variant *, const gchar *),
+	const Variant *v, const gchar *base)
+{
+	fflush (stdout);
+	pid_t pid = fork ();
+	if (pid < 0)
+		fatal ("%s: %s\n", "fork", g_strerror (errno));
+	if (!pid)
+	{
+		phase (v, base);
+		fflush (stdout);
+		_exit (EXIT_SUCCESS);
+	}
+
+	int wstatus = 0;
+	if (waitpid (pid, &wstatus, 0) < 0)
+		fatal ("%s: %s\n", "waitpid", g_strerror (errno));
+	if (!WIFEXITED (wstatus) || WEXITSTATUS (wstatus) != EXIT_SUCCESS)
+		fatal ("Error: benchmarking `%s' has failed\n", v->name);
+}
+
+static void
+run_variant (const Variant *v, const gchar *dir)
+{
+	gchar *base = g_build_filename (dir, v->name, NULL);
+
+	gint64 start = now_ns ();
+	run_in_child (generate, v, base);
+	report (v, "generate", seconds_since (start), "s");
+
+	run_in_child (measure, v, base);
+	g_free (base);
+}
+
+static const Variant *
+find_variant (const gchar *name)
+{
+	for (gsize i = 0; i < G_N_ELEMENTS (g_variants); i++)
+		if (!strcmp (g_variants[i].name, name))
+			return &g_variants[i];
+	return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+	// The GLib help includes an ellipsis character, for some reason
+	(void) setlocale (LC_ALL, "");
+
+	GError *error = NULL;
+	GOptionContext *ctx = g_option_context_new ("[VARIANT...]");
+	g_option_context_set_summary (ctx,
+		"Measure the performance of StarDict dictionary operations.");
+
+	GString *description = g_string_new ("Variants:");
+	for (gsize i = 0; i < G_N_ELEMENTS (g_variants); i++)
+		g_string_append_printf (description, " %s", g_variants[i].name);
+	g_option_context_set_description (ctx, description->str);
+	g_string_free (description, TRUE);
+
+	GOptionEntry entries[] =
+	{
+		{ "entries", 'n', 0, G_OPTION_ARG_INT, &g.entries,
+		  "Number of entries in each dictionary", "N" },
+		{ "definition-length", 'l', 0, G_OPTION_ARG_INT,
+		  &g.definition_length, "Average definition length", "BYTES" },
+		{ "queries", 'q', 0, G_OPTION_ARG_INT, &g.queries,
+		  "Number of operations per measurement", "N" },
+		{ "seed", 's', 0, G_OPTION_ARG_INT, &g.seed,
+		  "Seed for the random number generator", "N" },
+		{ }
+	};
+
+	g_option_context_add_main_entries (ctx, entries, NULL);
+	if (!g_option_context_parse (ctx, &argc, &argv, &error))
+		fatal ("Error: option parsing failed: %s\n", error->message);
+	if (g.entries < 1 || g.definition_length < 1 || g.queries < 0)
+		fatal ("%s", g_option_context_get_help (ctx, TRUE, NULL));
+	g_option_context_free (ctx);
+
+	GPtrArray *selected = g_ptr_array_new ();
+	for (int i = 1; i < argc; i++)
+	{
+		const Variant *v = find_variant (argv[i]);
+		if (!v)
+			fatal ("Error: unknown variant: %s\n", argv[i]);
+		g_ptr_array_add (selected, (gpointer) v);
+	}
+	for (gsize i = 0; !selected->len && i < G_N_ELEMENTS (g_variants); i++)
+		g_ptr_array_add (selected, (gpointer) &g_variants[i]);
+
+	gchar *dir = g_dir_make_tmp ("stardict-bench-XXXXXX", &error);
+	if (!dir)
+		fatal ("Error: failed to create a directory: %s\n", error->message);
+
+	printf ("# entries=%d definition-length=%d queries=%d seed=%d\n",
+		g.entries, g.definition_length, g.queries, g.seed);
+	printf ("# variant\tmetric\tvalue\tunit\n");
+	for (guint i = 0; i < selected->len; i++)
+		run_variant (g_ptr_array_index (selected, i), dir);
+
+	remove_directory (dir);
+	g_free (dir);
+	g_ptr_array_free (selected, TRUE);
+	return 0;
+}
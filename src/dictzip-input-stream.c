@@ -260,9 +260,256 @@ read_random_access_field (const gz_header *gzh,
 	return chunks;
 }
 
+// --- DictzipCache ------------------------------------------------------------
+
+// This is a segmented LRU: chunks start out on probation, and only move
+// to the protected segment once they're used again.  Sequential scans thus
+// only churn through the probationary segment, leaving the working set be.
+// Repeated reads from the chunk that the stream has read from last time
+// don't count as reuse, since that is precisely what scans do.
+
+/// Default maximum size of all decompressed chunks in a cache
+#define DICTZIP_CACHE_DEFAULT_LIMIT  (8 << 20)
+
+typedef struct dictzip_cache_entry      DictzipCacheEntry;
+
+struct dictzip_cache_entry
+{
+	GList                link;          ///< Link within a segment
+	DictzipCacheEntry ** slot;          ///< Reference from the stream
+	GBytes             * data;          ///< Decompressed chunk data
+	gboolean             protected;     ///< Within the protected segment?
+	gboolean             prefetched;    ///< Inserted ahead of being read?
+};
+
+struct dictzip_cache
+{
+	gint                 ref_count;     ///< Reference count
+	GMutex               lock;          ///< Guards everything below
+
+	gsize                limit;         ///< Maximum size of all chunks
+	gsize                size;          ///< Current size of all chunks
+	gsize                protected_size;  ///< Size of protected chunks
+	GQueue               probation;     ///< Chunks used once, MRU first
+	GQueue               protected;     ///< Chunks used again, MRU first
+
+	guint64              hits;          ///< Number of cache hits
+	guint64              misses;        ///< Number of cache misses
+	guint64              evictions;     ///< Number of evicted chunks
+};
+
+/// Create a new cache for decompressed dictzip chunks.
+/// @param[in] limit  The maximum combined size of all chunks in bytes
+DictzipCache *
+dictzip_cache_new (gsize limit)
+{
+	DictzipCache *self = g_new0 (DictzipCache, 1);
+	self->ref_count = 1;
+	g_mutex_init (&self->lock);
+	self->limit = limit;
+	g_queue_init (&self->probation);
+	g_queue_init (&self->protected);
+	return self;
+}
+
+/// Return the process-wide cache that all streams use unless told otherwise.
+DictzipCache *
+dictzip_cache_get_default (void)
+{
+	static gsize initialized;
+	static DictzipCache *cache;
+	if (g_once_init_enter (&initialized))
+	{
+		cache = dictzip_cache_new (DICTZIP_CACHE_DEFAULT_LIMIT);
+		g_once_init_leave (&initialized, 1);
+	}
+	return cache;
+}
+
+DictzipCache *
+dictzip_cache_ref (DictzipCache *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+	g_atomic_int_inc (&self->ref_count);
+	return self;
+}
+
+void
+dictzip_cache_unref (DictzipCache *self)
+{
+	g_return_if_fail (self != NULL);
+	if (!g_atomic_int_dec_and_test (&self->ref_count))
+		return;
+
+	// Each stream holds a reference, so there can be no entries left
+	g_warn_if_fail (!self->size);
+	g_mutex_clear (&self->lock);
+	g_free (self);
+}
+
+static void
+dictzip_cache_remove_locked (DictzipCache *self, DictzipCacheEntry *entry)
+{
+	gsize size = g_bytes_get_size (entry->data);
+	if (entry->protected)
+	{
+		g_queue_unlink (&self->protected, &entry->link);
+		self->protected_size -= size;
+	}
+	else
+		g_queue_unlink (&self->probation, &entry->link);
+
+	self->size -= size;
+	*entry->slot = NULL;
+	g_bytes_unref (entry->data);
+	g_slice_free1 (sizeof *entry, entry);
+}
+
+static void
+dictzip_cache_trim_locked (DictzipCache *self, DictzipCacheEntry *keep)
+{
+	// Let the protected segment take up most, but not all, of the space
+	while (self->protected_size > self->limit / 5 * 4)
+	{
+		GList *link = g_queue_pop_tail_link (&self->protected);
+		DictzipCacheEntry *entry = link->data;
+		entry->protected = FALSE;
+		self->protected_size -= g_bytes_get_size (entry->data);
+		g_queue_push_head_link (&self->probation, link);
+	}
+
+	while (self->size > self->limit)
+	{
+		GList *link = g_queue_peek_tail_link (&self->probation);
+		if (!link || link->data == keep)
+			link = g_queue_peek_tail_link (&self->protected);
+		if (!link || link->data == keep)
+			break;
+
+		dictzip_cache_remove_locked (self, link->data);
+		self->evictions++;
+	}
+}
+
+/// Change the maximum combined size of all chunks in the cache.
+void
+dictzip_cache_set_limit (DictzipCache *self, gsize limit)
+{
+	g_return_if_fail (self != NULL);
+
+	g_mutex_lock (&self->lock);
+	self->limit = limit;
+	dictzip_cache_trim_locked (self, NULL);
+	g_mutex_unlock (&self->lock);
+}
+
+/// Retrieve usage statistics of the cache.
+void
+dictzip_cache_get_stats (DictzipCache *self, DictzipCacheStats *stats)
+{
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&self->lock);
+	stats->hits = self->hits;
+	stats->misses = self->misses;
+	stats->evictions = self->evictions;
+	stats->size = self->size;
+	stats->limit = self->limit;
+	g_mutex_unlock (&self->lock);
+}
+
+/// Look up the chunk a stream refers to by @a slot, and return a reference.
+static GBytes *
+dictzip_cache_lookup (DictzipCache *self, DictzipCacheEntry **slot,
+	gboolean reused)
+{
+	g_mutex_lock (&self->lock);
+	DictzipCacheEntry *entry = *slot;
+	if (!entry)
+	{
+		self->misses++;
+		g_mutex_unlock (&self->lock);
+		return NULL;
+	}
+
+	// The first read of a prefetched chunk is what would have inserted it
+	self->hits++;
+	if (entry->prefetched)
+		entry->prefetched = reused = FALSE;
+	if (entry->protected)
+	{
+		g_queue_unlink (&self->protected, &entry->link);
+		g_queue_push_head_link (&self->protected, &entry->link);
+	}
+	else if (reused)
+	{
+		g_queue_unlink (&self->probation, &entry->link);
+		g_queue_push_head_link (&self->protected, &entry->link);
+		entry->protected = TRUE;
+		self->protected_size += g_bytes_get_size (entry->data);
+		dictzip_cache_trim_locked (self, entry);
+	}
+
+	GBytes *data = g_bytes_ref (entry->data);
+	g_mutex_unlock (&self->lock);
+	return data;
+}
+
+/// Check whether the chunk a stream refers to by @a slot is in the cache,
+/// without this counting as its use.
+static gboolean
+dictzip_cache_contains (DictzipCache *self, DictzipCacheEntry **slot)
+{
+	g_mutex_lock (&self->lock);
+	gboolean contained = *slot != NULL;
+	g_mutex_unlock (&self->lock);
+	return contained;
+}
+
+/// Put a chunk into the cache unless it's already there, and return
+/// a reference to what the cache holds for the slot.
+static GBytes *
+dictzip_cache_insert (DictzipCache *self, DictzipCacheEntry **slot,
+	GBytes *data, gboolean prefetched)
+{
+	g_mutex_lock (&self->lock);
+	DictzipCacheEntry *entry = *slot;
+	if (!entry)
+	{
+		entry = g_slice_alloc0 (sizeof *entry);
+		entry->link.data = entry;
+		entry->slot = slot;
+		entry->data = g_bytes_ref (data);
+		entry->prefetched = prefetched;
+		*slot = entry;
+
+		g_queue_push_head_link (&self->probation, &entry->link);
+		self->size += g_bytes_get_size (data);
+		dictzip_cache_trim_locked (self, entry);
+	}
+
+	data = g_bytes_ref (entry->data);
+	g_mutex_unlock (&self->lock);
+	return data;
+}
+
+/// Drop all chunks that a stream refers to through @a slots.
+static void
+dictzip_cache_forget (DictzipCache *self, DictzipCacheEntry **slots, gsize n)
+{
+	g_mutex_lock (&self->lock);
+	for (gsize i = 0; i < n; i++)
+		if (slots[i])
+			dictzip_cache_remove_locked (self, slots[i]);
+	g_mutex_unlock (&self->lock);
+}
+
 // --- DictzipInputStream ------------------------------------------------------
 
 static void dictzip_input_stream_finalize (GObject *gobject);
+static void free_inflater (z_stream *zs);
+static void prefetch_chunk (gpointer data, gpointer user_data);
 
 static void dictzip_input_stream_seekable_init
 	(GSeekableIface *iface, gpointer iface_data);
@@ -282,14 +529,25 @@ struct dictzip_input_stream_private
 	goffset      first_block_offset;   ///< Offset to the first block/chunk
 	gsize        chunk_length;         ///< Uncompressed chunk length
 	gsize        n_chunks;             ///< Number of chunks in file
-	guint16    * chunks;               ///< Chunk sizes after compression
+	goffset    * chunk_offsets;        ///< Chunk file offsets, plus the end
+	GBytes     * mapped;               ///< The whole file mapped, or NULL
 
-	z_stream     zs;                   ///< zlib decompression context
-	gpointer     input_buffer;         ///< Input buffer
+	GMutex       inflaters_lock;       ///< Guards @a inflaters
+	GPtrArray  * inflaters;            ///< Unused zlib decompression contexts
+	GMutex       input_lock;           ///< Guards base stream reads
+	gpointer     input_buffer;         ///< Input buffer for the base stream
 
 	goffset      offset;               ///< Current offset
-	gpointer   * decompressed;         ///< Array of decompressed chunks
-	gsize        last_chunk_length;    ///< Size of the last chunk
+
+	DictzipCache * cache;              ///< Cache of decompressed chunks
+	DictzipCacheEntry ** cached;       ///< Our chunks within the cache
+	gint         last_chunk_id;        ///< The chunk last read from
+
+	GThreadPool * prefetcher;          ///< Inflates chunks ahead of reads
+	gint       * prefetching;          ///< Chunks queued up for prefetching
+
+	GMutex       stats_lock;           ///< Guards @a stats
+	DictzipInputStreamStats stats;     ///< Chunk access statistics
 };
 
 G_DEFINE_TYPE_EXTENDED (DictzipInputStream, dictzip_input_stream,
@@ -325,6 +583,15 @@ static void
 dictzip_input_stream_init (DictzipInputStream *self)
 {
 	self->priv = dictzip_input_stream_get_instance_private (self);
+	g_mutex_init (&self->priv->inflaters_lock);
+	self->priv->inflaters = g_ptr_array_new_with_free_func
+		((GDestroyNotify) free_inflater);
+	g_mutex_init (&self->priv->input_lock);
+	g_mutex_init (&self->priv->stats_lock);
+
+	// Non-exclusive pools only take threads from a shared set as needed
+	self->priv->prefetcher = g_thread_pool_new (prefetch_chunk, self,
+		g_get_num_processors (), FALSE, NULL);
 }
 
 static void
@@ -332,16 +599,27 @@ dictzip_input_stream_finalize (GObject *gobject)
 {
 	DictzipInputStreamPrivate *priv = DICTZIP_INPUT_STREAM (gobject)->priv;
 
+	// Queued chunks are dropped, the ones being inflated need to finish
+	g_thread_pool_free (priv->prefetcher, TRUE, TRUE);
+	g_free (priv->prefetching);
+
 	if (priv->file_info)
 		g_object_unref (priv->file_info);
-	g_free (priv->chunks);
+	g_free (priv->chunk_offsets);
+	if (priv->mapped)
+		g_bytes_unref (priv->mapped);
 	g_free (priv->input_buffer);
-	inflateEnd (&priv->zs);
+	g_ptr_array_free (priv->inflaters, TRUE);
+	g_mutex_clear (&priv->inflaters_lock);
+	g_mutex_clear (&priv->input_lock);
+	g_mutex_clear (&priv->stats_lock);
 
-	guint i;
-	for (i = 0; i < priv->n_chunks; i++)
-		g_free (priv->decompressed[i]);
-	g_free (priv->decompressed);
+	if (priv->cache)
+	{
+		dictzip_cache_forget (priv->cache, priv->cached, priv->n_chunks);
+		dictzip_cache_unref (priv->cache);
+	}
+	g_free (priv->cached);
 
 	G_OBJECT_CLASS (dictzip_input_stream_parent_class)->finalize (gobject);
 }
@@ -352,93 +630,209 @@ dictzip_input_stream_tell (GSeekable *seekable)
 	return DICTZIP_INPUT_STREAM (seekable)->priv->offset;
 }
 
-static gpointer
-inflate_chunk (DictzipInputStream *self,
-	guint chunk_id, gsize *inflated_length, GError **error)
+static z_stream *
+acquire_inflater (DictzipInputStream *self, GError **error)
 {
 	DictzipInputStreamPrivate *priv = self->priv;
-	g_return_val_if_fail (chunk_id < priv->n_chunks, NULL);
-
-	GInputStream *base_stream = G_FILTER_INPUT_STREAM (self)->base_stream;
-
-	guint i;
-	goffset offset = priv->first_block_offset;
-	for (i = 0; i < chunk_id; i++)
-		offset += priv->chunks[i];
-
-	if (!g_seekable_seek (G_SEEKABLE (base_stream),
-		offset, G_SEEK_SET, NULL, error))
-		return NULL;
-
-	gssize read = g_input_stream_read (base_stream, priv->input_buffer,
-		priv->chunks[chunk_id], NULL, error);
-	if (read == -1)
-		return NULL;
-
-	if (read != priv->chunks[chunk_id])
+	z_stream *zs = NULL;
+	g_mutex_lock (&priv->inflaters_lock);
+	if (priv->inflaters->len)
+		zs = g_ptr_array_remove_index_fast (priv->inflaters,
+			priv->inflaters->len - 1);
+	g_mutex_unlock (&priv->inflaters_lock);
+	if (zs)
+		return zs;
+
+	zs = g_slice_new0 (z_stream);
+	int z_err = inflateInit2 (zs, -15);
+	if (z_err != Z_OK)
 	{
 		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-			"premature end of file");
+			"zlib initialisation failed: %s", zError (z_err));
+		g_slice_free (z_stream, zs);
 		return NULL;
 	}
+	return zs;
+}
+
+static void
+release_inflater (DictzipInputStream *self, z_stream *zs)
+{
+	DictzipInputStreamPrivate *priv = self->priv;
+	g_mutex_lock (&priv->inflaters_lock);
+	g_ptr_array_add (priv->inflaters, zs);
+	g_mutex_unlock (&priv->inflaters_lock);
+}
+
+static void
+free_inflater (z_stream *zs)
+{
+	inflateEnd (zs);
+	g_slice_free (z_stream, zs);
+}
+
+static gpointer
+inflate_data (DictzipInputStream *self, const gchar *input, gsize length,
+	gsize *inflated_length, GError **error)
+{
+	DictzipInputStreamPrivate *priv = self->priv;
+	z_stream *zs = acquire_inflater (self, error);
+	if (!zs)
+		return NULL;
 
 	int z_err;
 	gpointer chunk_data = g_malloc (priv->chunk_length);
 
-	priv->zs.next_in   = (Bytef *) priv->input_buffer;
-	priv->zs.avail_in  = read;
-	priv->zs.total_in  = 0;
+	zs->next_in   = (Bytef *) input;
+	zs->avail_in  = length;
+	zs->total_in  = 0;
 
-	priv->zs.next_out  = (Bytef *) chunk_data;
-	priv->zs.avail_out = priv->chunk_length;
-	priv->zs.total_out = 0;
+	zs->next_out  = (Bytef *) chunk_data;
+	zs->avail_out = priv->chunk_length;
+	zs->total_out = 0;
 
-	z_err = inflateReset (&priv->zs);
+	z_err = inflateReset (zs);
 	if (z_err != Z_OK)
 		goto error_zlib;
 
-	z_err = inflate (&priv->zs, Z_BLOCK);
-	if (z_err != Z_OK)
+	// Chunks may span several blocks, and the last one ends the stream
+	do z_err = inflate (zs, Z_BLOCK);
+	while (z_err == Z_OK && zs->avail_in && zs->avail_out);
+	if (z_err != Z_OK && z_err != Z_STREAM_END)
 		goto error_zlib;
 
-	*inflated_length = priv->zs.total_out;
+	*inflated_length = zs->total_out;
+	release_inflater (self, zs);
 	return chunk_data;
 
 error_zlib:
 	g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
 		"failed to inflate the requested block: %s", zError (z_err));
 	g_free (chunk_data);
+	release_inflater (self, zs);
 	return NULL;
 }
 
 static gpointer
-get_chunk (DictzipInputStream *self, guint chunk_id, GError **error)
+inflate_chunk (DictzipInputStream *self,
+	guint chunk_id, gsize *inflated_length, GError **error)
 {
 	DictzipInputStreamPrivate *priv = self->priv;
-	gpointer chunk = priv->decompressed[chunk_id];
-	if (!chunk)
-	{
-		// Just inflating the file piece by piece as needed.
-		gsize chunk_size;
-		chunk = inflate_chunk (self, chunk_id, &chunk_size, error);
-		if (!chunk)
-			return NULL;
+	g_return_val_if_fail (chunk_id < priv->n_chunks, NULL);
 
-		if (chunk_id + 1 == priv->n_chunks)
-			priv->last_chunk_length = chunk_size;
-		else if (chunk_size < priv->chunk_length)
+	goffset offset = priv->chunk_offsets[chunk_id];
+	gsize length = priv->chunk_offsets[chunk_id + 1] - offset;
+	if (priv->mapped)
+	{
+		gsize mapped_length = 0;
+		const gchar *data = g_bytes_get_data (priv->mapped, &mapped_length);
+		if ((gsize) priv->chunk_offsets[chunk_id + 1] > mapped_length)
 		{
 			g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-				"inflated dictzip chunk is too short");
-			g_free (chunk);
+				"premature end of file");
 			return NULL;
 		}
+		return inflate_data (self, data + offset, length,
+			inflated_length, error);
+	}
+
+	// The base stream has a position, and we share the input buffer
+	gpointer chunk_data = NULL;
+	g_mutex_lock (&priv->input_lock);
+
+	GInputStream *base_stream = G_FILTER_INPUT_STREAM (self)->base_stream;
+	if (!g_seekable_seek (G_SEEKABLE (base_stream),
+		offset, G_SEEK_SET, NULL, error))
+		goto out;
+
+	gssize read = g_input_stream_read (base_stream, priv->input_buffer,
+		length, NULL, error);
+	if (read == -1)
+		goto out;
+
+	if ((gsize) read != length)
+	{
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			"premature end of file");
+		goto out;
+	}
+
+	chunk_data = inflate_data (self, priv->input_buffer, length,
+		inflated_length, error);
+out:
+	g_mutex_unlock (&priv->input_lock);
+	return chunk_data;
+}
 
-		priv->decompressed[chunk_id] = chunk;
+/// Inflate a chunk and put it in the cache, returning what the cache holds.
+static GBytes *
+load_chunk (DictzipInputStream *self, guint chunk_id, gboolean prefetched,
+	GError **error)
+{
+	DictzipInputStreamPrivate *priv = self->priv;
+	gsize chunk_size;
+	gpointer data = inflate_chunk (self, chunk_id, &chunk_size, error);
+	if (!data)
+		return NULL;
+
+	if (chunk_id + 1 != priv->n_chunks && chunk_size < priv->chunk_length)
+	{
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			"inflated dictzip chunk is too short");
+		g_free (data);
+		return NULL;
 	}
+
+	g_mutex_lock (&priv->stats_lock);
+	priv->stats.inflated += chunk_size;
+	g_mutex_unlock (&priv->stats_lock);
+
+	GBytes *inflated = g_bytes_new_take (data, chunk_size);
+	GBytes *chunk = dictzip_cache_insert (priv->cache,
+		&priv->cached[chunk_id], inflated, prefetched);
+	g_bytes_unref (inflated);
 	return chunk;
 }
 
+static GBytes *
+get_chunk (DictzipInputStream *self, guint chunk_id, GError **error)
+{
+	DictzipInputStreamPrivate *priv = self->priv;
+	gboolean reused = g_atomic_int_get (&priv->last_chunk_id) != (gint) chunk_id;
+	g_atomic_int_set (&priv->last_chunk_id, chunk_id);
+
+	GBytes *chunk =
+		dictzip_cache_lookup (priv->cache, &priv->cached[chunk_id], reused);
+
+	g_mutex_lock (&priv->stats_lock);
+	if (chunk)
+		priv->stats.hits++;
+	else
+		priv->stats.misses++;
+	g_mutex_unlock (&priv->stats_lock);
+	if (chunk)
+		return chunk;
+
+	// Just inflating the file piece by piece as needed.
+	return load_chunk (self, chunk_id, FALSE, error);
+}
+
+static void
+prefetch_chunk (gpointer data, gpointer user_data)
+{
+	DictzipInputStream *self = user_data;
+	DictzipInputStreamPrivate *priv = self->priv;
+	guint chunk_id = GPOINTER_TO_UINT (data) - 1;
+
+	// Errors will resurface once the chunk is actually read
+	GBytes *chunk = NULL;
+	if (!dictzip_cache_contains (priv->cache, &priv->cached[chunk_id])
+	 && (chunk = load_chunk (self, chunk_id, TRUE, NULL)))
+		g_bytes_unref (chunk);
+
+	g_atomic_int_set (&priv->prefetching[chunk_id], FALSE);
+}
+
 static gboolean
 dictzip_input_stream_seek (GSeekable *seekable, goffset offset,
 	GSeekType type, GCancellable *cancellable, GError **error)
@@ -484,57 +878,96 @@ dictzip_input_stream_read (GInputStream *stream, void *buffer,
 		return -1;
 
 	DictzipInputStream *self = DICTZIP_INPUT_STREAM (stream);
+	gssize read = dictzip_input_stream_read_at
+		(self, buffer, count, self->priv->offset, error);
+	if (read > 0)
+		self->priv->offset += read;
+	return read;
+}
+
+static gssize
+dictzip_input_stream_skip (GInputStream *stream, gsize count,
+	GCancellable *cancellable, GError **error)
+{
+	if (!dictzip_input_stream_seek (G_SEEKABLE (stream), count,
+		G_SEEK_CUR, cancellable, error))
+		return -1;
+
+	return count;
+}
+
+/// Read data from the given uncompressed @a offset, leaving the stream's
+/// own position alone.  Unlike regular stream operations, this may be called
+/// from multiple threads at once.  Returns the number of bytes read,
+/// which is only less than @a count at the end of data, or -1 on error.
+gssize
+dictzip_input_stream_read_at (DictzipInputStream *self, gpointer buffer,
+	gsize count, goffset offset, GError **error)
+{
+	g_return_val_if_fail (DICTZIP_IS_INPUT_STREAM (self), -1);
+	g_return_val_if_fail (offset >= 0, -1);
+
 	DictzipInputStreamPrivate *priv = self->priv;
+	gchar *out = buffer;
 	gssize read = 0;
 
-	guint chunk_id     = priv->offset / priv->chunk_length;
-	guint chunk_offset = priv->offset % priv->chunk_length;
+	guint chunk_id     = offset / priv->chunk_length;
+	guint chunk_offset = offset % priv->chunk_length;
 
-	do
+	while (count)
 	{
 		if (chunk_id >= priv->n_chunks)
 			return read;
 
-		gpointer chunk = get_chunk (self, chunk_id, error);
+		GBytes *chunk = get_chunk (self, chunk_id, error);
 		if (!chunk)
 			return -1;
 
-		glong to_copy;
-		if (chunk_id + 1 == priv->n_chunks)
-			// Set by the call to get_chunk().
-			to_copy = priv->last_chunk_length - chunk_offset;
-		else
-			to_copy = priv->chunk_length - chunk_offset;
-
+		// Only the last chunk may be shorter, which get_chunk() ensures
+		gsize chunk_size = 0;
+		const gchar *data = g_bytes_get_data (chunk, &chunk_size);
+		glong to_copy = chunk_size - chunk_offset;
 		if (to_copy > (glong) count)
 			to_copy = count;
 
 		if (to_copy > 0)
 		{
-			memcpy (buffer, chunk + chunk_offset, to_copy);
-			buffer += to_copy;
-			priv->offset += to_copy;
+			memcpy (out, data + chunk_offset, to_copy);
+			out += to_copy;
 			count -= to_copy;
 			read += to_copy;
 		}
+		g_bytes_unref (chunk);
 
 		chunk_id++;
 		chunk_offset = 0;
 	}
-	while (count);
-
 	return read;
 }
 
-static gssize
-dictzip_input_stream_skip (GInputStream *stream, gsize count,
-	GCancellable *cancellable, GError **error)
+/// Start inflating chunks that cover the given range of uncompressed data
+/// in the background, so that reads of it will later find them in the cache.
+/// Chunks that are already cached or queued up are skipped.
+void
+dictzip_input_stream_prefetch (DictzipInputStream *self,
+	goffset offset, gsize count)
 {
-	if (!dictzip_input_stream_seek (G_SEEKABLE (stream), count,
-		G_SEEK_CUR, cancellable, error))
-		return -1;
+	g_return_if_fail (DICTZIP_IS_INPUT_STREAM (self));
+	g_return_if_fail (offset >= 0);
 
-	return count;
+	DictzipInputStreamPrivate *priv = self->priv;
+	if (!count)
+		return;
+
+	guint64 first = offset / priv->chunk_length;
+	guint64 last = (offset + count - 1) / priv->chunk_length;
+	for (guint64 id = first; id <= last && id < priv->n_chunks; id++)
+	{
+		// Chunk identifiers are offset by one, so that they aren't NULL
+		if (g_atomic_int_compare_and_exchange (&priv->prefetching[id], 0, 1))
+			g_thread_pool_push (priv->prefetcher,
+				GUINT_TO_POINTER (id + 1), NULL);
+	}
 }
 
 /// Create an input stream for the underlying dictzip file.
@@ -565,7 +998,7 @@ dictzip_input_stream_new (GInputStream *base_stream, GError **error)
 		goto error;
 	}
 
-	priv->chunks = read_random_access_field (&gzh,
+	guint16 *chunks = read_random_access_field (&gzh,
 		&priv->chunk_length, &priv->n_chunks, &err);
 	if (err)
 	{
@@ -573,13 +1006,20 @@ dictzip_input_stream_new (GInputStream *base_stream, GError **error)
 		goto error;
 	}
 
-	if (!priv->chunks)
+	if (!chunks)
 	{
 		g_set_error (error, DICTZIP_ERROR, DICTZIP_ERROR_INVALID_HEADER,
 			"not a dictzip file");
 		goto error;
 	}
 
+	// Chunks would otherwise have to be located by summing up their sizes
+	priv->chunk_offsets = g_new (goffset, priv->n_chunks + 1);
+	priv->chunk_offsets[0] = priv->first_block_offset;
+	for (gsize i = 0; i < priv->n_chunks; i++)
+		priv->chunk_offsets[i + 1] = priv->chunk_offsets[i] + chunks[i];
+	g_free (chunks);
+
 	// Store file information.
 	priv->file_info = g_file_info_new ();
 
@@ -592,19 +1032,17 @@ dictzip_input_stream_new (GInputStream *base_stream, GError **error)
 	if (gzh.name && *gzh.name)
 		g_file_info_set_name (priv->file_info, (gchar *) gzh.name);
 
-	// Initialise zlib.
-	int z_err;
-	z_err = inflateInit2 (&priv->zs, -15);
-	if (z_err != Z_OK)
-	{
-		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-			"zlib initialisation failed: %s", zError (z_err));
+	// Initialise zlib, so that we find out about problems early.
+	z_stream *zs = acquire_inflater (self, error);
+	if (!zs)
 		goto error;
-	}
+	release_inflater (self, zs);
 
 	priv->input_buffer = g_malloc (65536);
-	priv->decompressed = g_new0 (gpointer, priv->n_chunks);
-	priv->last_chunk_length = -1;  // We don't know yet.
+	priv->cache = dictzip_cache_ref (dictzip_cache_get_default ());
+	priv->cached = g_new0 (DictzipCacheEntry *, priv->n_chunks);
+	priv->last_chunk_id = -1;
+	priv->prefetching = g_new0 (gint, priv->n_chunks);
 
 	free_gzip_header (&gzh);
 	return self;
@@ -615,6 +1053,60 @@ error:
 	return NULL;
 }
 
+/// Create an input stream for a dictzip file, which will be memory-mapped,
+/// so that chunks can be read from any position without seeking.
+DictzipInputStream *
+dictzip_input_stream_new_for_path (const gchar *path, GError **error)
+{
+	g_return_val_if_fail (path != NULL, NULL);
+
+	GMappedFile *mf = g_mapped_file_new (path, FALSE, error);
+	if (!mf)
+		return NULL;
+
+	GBytes *bytes = g_mapped_file_get_bytes (mf);
+	g_mapped_file_unref (mf);
+
+	// The header parser needs a stream, memory streams are seekable
+	GInputStream *mis = g_memory_input_stream_new_from_bytes (bytes);
+	DictzipInputStream *self = dictzip_input_stream_new (mis, error);
+	if (self)
+		self->priv->mapped = g_bytes_ref (bytes);
+
+	g_object_unref (mis);
+	g_bytes_unref (bytes);
+	return self;
+}
+
+/// Make the stream keep its decompressed chunks in the given cache,
+/// which may be shared with other streams to have them use a common budget.
+void
+dictzip_input_stream_set_cache (DictzipInputStream *self, DictzipCache *cache)
+{
+	g_return_if_fail (DICTZIP_IS_INPUT_STREAM (self));
+	g_return_if_fail (cache != NULL);
+
+	DictzipInputStreamPrivate *priv = self->priv;
+	dictzip_cache_ref (cache);
+	dictzip_cache_forget (priv->cache, priv->cached, priv->n_chunks);
+	dictzip_cache_unref (priv->cache);
+	priv->cache = cache;
+}
+
+/// Retrieve statistics about the stream's chunk accesses.
+void
+dictzip_input_stream_get_stats (DictzipInputStream *self,
+	DictzipInputStreamStats *stats)
+{
+	g_return_if_fail (DICTZIP_IS_INPUT_STREAM (self));
+	g_return_if_fail (stats != NULL);
+
+	DictzipInputStreamPrivate *priv = self->priv;
+	g_mutex_lock (&priv->stats_lock);
+	*stats = priv->stats;
+	g_mutex_unlock (&priv->stats_lock);
+}
+
 /// Return file information for the compressed file.
 GFileInfo *
 dictzip_input_stream_get_file_info (DictzipInputStream *self)
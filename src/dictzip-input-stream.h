@@ -53,8 +53,40 @@ typedef enum {
 
 GQuark dictzip_error_quark (void);
 
+// --- DictzipCache ------------------------------------------------------------
+
+/// A memory-bounded cache of decompressed chunks, shareable between streams.
+typedef struct dictzip_cache                 DictzipCache;
+typedef struct dictzip_cache_stats           DictzipCacheStats;
+
+struct dictzip_cache_stats
+{
+	guint64      hits;                 ///< Chunks found within the cache
+	guint64      misses;               ///< Chunks that had to be inflated
+	guint64      evictions;            ///< Chunks dropped to fit the limit
+	gsize        size;                 ///< Current size of all chunks
+	gsize        limit;                ///< Maximum size of all chunks
+};
+
+DictzipCache *dictzip_cache_new (gsize limit);
+DictzipCache *dictzip_cache_get_default (void);
+DictzipCache *dictzip_cache_ref (DictzipCache *self);
+void dictzip_cache_unref (DictzipCache *self);
+void dictzip_cache_set_limit (DictzipCache *self, gsize limit);
+void dictzip_cache_get_stats (DictzipCache *self, DictzipCacheStats *stats);
+
 // --- DictzipInputStream ------------------------------------------------------
 
+/// Statistics of a single stream's chunk accesses
+typedef struct dictzip_input_stream_stats    DictzipInputStreamStats;
+
+struct dictzip_input_stream_stats
+{
+	guint64      hits;                 ///< Chunks found within the cache
+	guint64      misses;               ///< Chunks that had to be inflated
+	guint64      inflated;             ///< Bytes inflated, with read-ahead
+};
+
 struct dictzip_input_stream
 {
 	GFilterInputStream parent_instance;
@@ -69,7 +101,17 @@ struct dictzip_input_stream_class
 GType dictzip_input_stream_get_type (void);
 DictzipInputStream *dictzip_input_stream_new
 	(GInputStream *base_stream, GError **error);
+DictzipInputStream *dictzip_input_stream_new_for_path
+	(const gchar *path, GError **error);
 GFileInfo *dictzip_input_stream_get_file_info (DictzipInputStream *self);
+gssize dictzip_input_stream_read_at (DictzipInputStream *self,
+	gpointer buffer, gsize count, goffset offset, GError **error);
+void dictzip_input_stream_prefetch (DictzipInputStream *self,
+	goffset offset, gsize count);
+void dictzip_input_stream_set_cache
+	(DictzipInputStream *self, DictzipCache *cache);
+void dictzip_input_stream_get_stats
+	(DictzipInputStream *self, DictzipInputStreamStats *stats);
 
 
 #endif  // ! DICTZIP_INPUT_STREAM_H
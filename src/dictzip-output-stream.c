@@ -0,0 +1,496 @@
+/*
+ * dictzip-output-stream.c: dictzip GIO stream writer
+ *
+ * Copyright (c) 2026, Přemysl Eric Janouch <p@janouch.name>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <zlib.h>
+
+#include "dictzip-output-stream.h"
+
+
+/// Uncompressed chunk length, the same one that dictzip(1) uses
+#define DICTZIP_CHUNK_LENGTH  58315
+
+/// The RA subfield, including its chunk sizes, must fit within the 16-bit
+/// length of the gzip header's "extra" field.  This amounts to about 1.9 GB
+/// of uncompressed data, beyond which the stream stops compressing.
+#define DICTZIP_MAX_CHUNKS    ((G_MAXUINT16 - 10) / 2)
+
+// --- Chunks ------------------------------------------------------------------
+
+typedef struct dictzip_chunk DictzipChunk;
+
+struct dictzip_chunk
+{
+	gpointer     data;                 ///< Uncompressed data
+	gsize        length;               ///< Length of uncompressed data
+	gboolean     last;                 ///< Whether this chunk ends the stream
+
+	gpointer     deflated;             ///< Compressed data
+	gsize        deflated_length;      ///< Length of compressed data
+	guint32      crc;                  ///< CRC-32 of uncompressed data
+	int          z_err;                ///< zlib error code, or Z_OK
+};
+
+static void
+dictzip_chunk_free (DictzipChunk *self)
+{
+	g_free (self->data);
+	g_free (self->deflated);
+	g_slice_free (DictzipChunk, self);
+}
+
+/// Deflate a chunk so that it doesn't depend on any preceding data,
+/// while the chunks can still be simply concatenated into a valid stream.
+static int
+dictzip_chunk_deflate (DictzipChunk *self)
+{
+	z_stream zs;
+	memset (&zs, 0, sizeof zs);
+
+	int z_err = deflateInit2 (&zs, Z_BEST_COMPRESSION, Z_DEFLATED,
+		-15, 9, Z_DEFAULT_STRATEGY);
+	if (z_err != Z_OK)
+		return z_err;
+
+	// Leave room for the flush marker and the final empty block
+	gsize bound = deflateBound (&zs, self->length) + 16;
+	self->deflated = g_malloc (bound);
+
+	zs.next_in   = (Bytef *) self->data;
+	zs.avail_in  = self->length;
+	zs.next_out  = (Bytef *) self->deflated;
+	zs.avail_out = bound;
+
+	// Flushing byte-aligns the chunk, and resets the compression dictionary;
+	// the last chunk then also ends the deflate stream with an empty block
+	z_err = deflate (&zs, Z_FULL_FLUSH);
+	if (z_err == Z_OK && self->last)
+		z_err = deflate (&zs, Z_FINISH) == Z_STREAM_END ? Z_OK : Z_BUF_ERROR;
+	if (z_err == Z_OK && (zs.avail_in || zs.total_out > G_MAXUINT16))
+		z_err = Z_BUF_ERROR;
+
+	self->deflated_length = zs.total_out;
+	deflateEnd (&zs);
+	return z_err;
+}
+
+/// Inflate a chunk that doesn't end the stream back into @a out,
+/// which needs to be able to hold its uncompressed length.
+static int
+dictzip_chunk_inflate (DictzipChunk *self, gpointer out)
+{
+	z_stream zs;
+	memset (&zs, 0, sizeof zs);
+
+	int z_err = inflateInit2 (&zs, -15);
+	if (z_err != Z_OK)
+		return z_err;
+
+	zs.next_in   = (Bytef *) self->deflated;
+	zs.avail_in  = self->deflated_length;
+	zs.next_out  = (Bytef *) out;
+	zs.avail_out = self->length;
+
+	z_err = inflate (&zs, Z_SYNC_FLUSH);
+	if (z_err == Z_OK && zs.total_out != self->length)
+		z_err = Z_DATA_ERROR;
+
+	inflateEnd (&zs);
+	return z_err;
+}
+
+// --- DictzipOutputStream -----------------------------------------------------
+
+static void dictzip_output_stream_finalize (GObject *gobject);
+static void compress_chunk (gpointer data, gpointer user_data);
+
+static void dictzip_output_stream_seekable_init
+	(GSeekableIface *iface, gpointer iface_data);
+static goffset dictzip_output_stream_tell (GSeekable *seekable);
+static gboolean dictzip_output_stream_seek (GSeekable *seekable,
+	goffset offset, GSeekType type, GCancellable *cancellable, GError **error);
+static gboolean dictzip_output_stream_truncate (GSeekable *seekable,
+	goffset offset, GCancellable *cancellable, GError **error);
+
+static gssize dictzip_output_stream_write (GOutputStream *stream,
+	const void *buffer, gsize count,
+	GCancellable *cancellable, GError **error);
+static gboolean dictzip_output_stream_close (GOutputStream *stream,
+	GCancellable *cancellable, GError **error);
+
+struct dictzip_output_stream_private
+{
+	gchar      * buffer;               ///< The chunk being filled
+	gsize        buffer_len;           ///< How much of the buffer is used
+	goffset      offset;               ///< Uncompressed data written so far
+
+	GPtrArray  * chunks;               ///< All chunks, in stream order
+	GThreadPool * compressor;          ///< Deflates filled chunks
+
+	GMutex       lock;                 ///< Guards @a in_flight
+	GCond        cond;                 ///< Signals @a in_flight decrements
+	guint        in_flight;            ///< Chunks waiting to be deflated
+	guint        max_in_flight;        ///< Limit for @a in_flight
+
+	gboolean     uncompressed;         ///< Passing data through as they are
+};
+
+G_DEFINE_TYPE_EXTENDED (DictzipOutputStream, dictzip_output_stream,
+	G_TYPE_FILTER_OUTPUT_STREAM, 0,
+	G_ADD_PRIVATE (DictzipOutputStream)
+	G_IMPLEMENT_INTERFACE (G_TYPE_SEEKABLE,
+		dictzip_output_stream_seekable_init))
+
+static gboolean seekable_false (G_GNUC_UNUSED GSeekable *x) { return FALSE; }
+
+static void
+dictzip_output_stream_seekable_init
+	(GSeekableIface *iface, G_GNUC_UNUSED gpointer iface_data)
+{
+	iface->tell            = dictzip_output_stream_tell;
+	iface->can_seek        = seekable_false;
+	iface->seek            = dictzip_output_stream_seek;
+	iface->can_truncate    = seekable_false;
+	iface->truncate_fn     = dictzip_output_stream_truncate;
+}
+
+static void
+dictzip_output_stream_class_init (DictzipOutputStreamClass *klass)
+{
+	GOutputStreamClass *stream_class = G_OUTPUT_STREAM_CLASS (klass);
+	stream_class->write_fn = dictzip_output_stream_write;
+	stream_class->close_fn = dictzip_output_stream_close;
+
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = dictzip_output_stream_finalize;
+}
+
+static void
+dictzip_output_stream_init (DictzipOutputStream *self)
+{
+	DictzipOutputStreamPrivate *priv =
+		self->priv = dictzip_output_stream_get_instance_private (self);
+
+	priv->buffer = g_malloc (DICTZIP_CHUNK_LENGTH);
+	priv->chunks = g_ptr_array_new_with_free_func
+		((GDestroyNotify) dictzip_chunk_free);
+
+	g_mutex_init (&priv->lock);
+	g_cond_init (&priv->cond);
+
+	// Non-exclusive pools only take threads from a shared set as needed
+	guint n_processors = g_get_num_processors ();
+	priv->compressor = g_thread_pool_new (compress_chunk, priv,
+		n_processors, FALSE, NULL);
+	priv->max_in_flight = n_processors * 2;
+}
+
+static void
+dictzip_output_stream_finalize (GObject *gobject)
+{
+	DictzipOutputStreamPrivate *priv = DICTZIP_OUTPUT_STREAM (gobject)->priv;
+
+	// Chunks still queued refer to our array, let them finish
+	g_thread_pool_free (priv->compressor, FALSE, TRUE);
+	g_ptr_array_free (priv->chunks, TRUE);
+	g_free (priv->buffer);
+	g_mutex_clear (&priv->lock);
+	g_cond_clear (&priv->cond);
+
+	G_OBJECT_CLASS (dictzip_output_stream_parent_class)->finalize (gobject);
+}
+
+static goffset
+dictzip_output_stream_tell (GSeekable *seekable)
+{
+	return DICTZIP_OUTPUT_STREAM (seekable)->priv->offset;
+}
+
+static gboolean
+dictzip_output_stream_seek (G_GNUC_UNUSED GSeekable *seekable,
+	G_GNUC_UNUSED goffset offset, G_GNUC_UNUSED GSeekType type,
+	G_GNUC_UNUSED GCancellable *cancellable, GError **error)
+{
+	g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		"dictzip output streams cannot seek");
+	return FALSE;
+}
+
+static gboolean
+dictzip_output_stream_truncate (G_GNUC_UNUSED GSeekable *seekable,
+	G_GNUC_UNUSED goffset offset,
+	G_GNUC_UNUSED GCancellable *cancellable, GError **error)
+{
+	g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		"dictzip output streams cannot be truncated");
+	return FALSE;
+}
+
+static void
+compress_chunk (gpointer data, gpointer user_data)
+{
+	DictzipChunk *chunk = data;
+	DictzipOutputStreamPrivate *priv = user_data;
+
+	chunk->crc = crc32 (0, chunk->data, chunk->length);
+	chunk->z_err = dictzip_chunk_deflate (chunk);
+
+	// The uncompressed data is of no further use, and it adds up
+	g_free (chunk->data);
+	chunk->data = NULL;
+
+	g_mutex_lock (&priv->lock);
+	priv->in_flight--;
+	g_cond_signal (&priv->cond);
+	g_mutex_unlock (&priv->lock);
+}
+
+static void
+wait_for_compressor (DictzipOutputStreamPrivate *priv)
+{
+	g_mutex_lock (&priv->lock);
+	while (priv->in_flight)
+		g_cond_wait (&priv->cond, &priv->lock);
+	g_mutex_unlock (&priv->lock);
+}
+
+/// Having run out of chunks, write all data so far into the base stream
+/// uncompressed, including the buffer, and continue in that fashion.
+static gboolean
+give_up_compression (DictzipOutputStream *self, GError **error)
+{
+	DictzipOutputStreamPrivate *priv = self->priv;
+	GOutputStream *base_stream = G_FILTER_OUTPUT_STREAM (self)->base_stream;
+	wait_for_compressor (priv);
+
+	gboolean ok = TRUE;
+	gchar *inflated = g_malloc (DICTZIP_CHUNK_LENGTH);
+	for (guint i = 0; ok && i < priv->chunks->len; i++)
+	{
+		DictzipChunk *chunk = g_ptr_array_index (priv->chunks, i);
+		int z_err = chunk->z_err;
+		if (z_err == Z_OK)
+			z_err = dictzip_chunk_inflate (chunk, inflated);
+		if (z_err != Z_OK)
+		{
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				"failed to decompress a chunk: %s", zError (z_err));
+			ok = FALSE;
+		}
+		else
+			ok = g_output_stream_write_all (base_stream,
+				inflated, chunk->length, NULL, NULL, error);
+	}
+	g_free (inflated);
+
+	ok = ok && g_output_stream_write_all (base_stream,
+		priv->buffer, priv->buffer_len, NULL, NULL, error);
+	priv->buffer_len = 0;
+
+	g_ptr_array_set_size (priv->chunks, 0);
+	priv->uncompressed = TRUE;
+	return ok;
+}
+
+/// Hand over the buffered chunk to the compressor.
+static gboolean
+dispatch_chunk (DictzipOutputStream *self, gboolean last, GError **error)
+{
+	DictzipOutputStreamPrivate *priv = self->priv;
+	if (priv->chunks->len == DICTZIP_MAX_CHUNKS)
+		return give_up_compression (self, error);
+
+	DictzipChunk *chunk = g_slice_new0 (DictzipChunk);
+	chunk->data = priv->buffer;
+	chunk->length = priv->buffer_len;
+	chunk->last = last;
+	g_ptr_array_add (priv->chunks, chunk);
+
+	priv->buffer = last ? NULL : g_malloc (DICTZIP_CHUNK_LENGTH);
+	priv->buffer_len = 0;
+
+	// Don't let uncompressed data pile up when we outpace the compressor
+	g_mutex_lock (&priv->lock);
+	while (priv->in_flight >= priv->max_in_flight)
+		g_cond_wait (&priv->cond, &priv->lock);
+	priv->in_flight++;
+	g_mutex_unlock (&priv->lock);
+
+	if (g_thread_pool_push (priv->compressor, chunk, error))
+		return TRUE;
+
+	g_mutex_lock (&priv->lock);
+	priv->in_flight--;
+	g_mutex_unlock (&priv->lock);
+	return FALSE;
+}
+
+static gssize
+dictzip_output_stream_write (GOutputStream *stream, const void *buffer,
+	gsize count, GCancellable *cancellable, GError **error)
+{
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return -1;
+
+	// Whether a full chunk is the last one is only known once we get more
+	// data, or the stream is closed, so we don't dispatch it right away
+	DictzipOutputStreamPrivate *priv = DICTZIP_OUTPUT_STREAM (stream)->priv;
+	if (priv->buffer_len == DICTZIP_CHUNK_LENGTH
+	 && !dispatch_chunk (DICTZIP_OUTPUT_STREAM (stream), FALSE, error))
+		return -1;
+
+	if (priv->uncompressed)
+	{
+		gssize written = g_output_stream_write (G_FILTER_OUTPUT_STREAM
+			(stream)->base_stream, buffer, count, cancellable, error);
+		if (written > 0)
+			priv->offset += written;
+		return written;
+	}
+
+	gsize n = MIN (count, DICTZIP_CHUNK_LENGTH - priv->buffer_len);
+	memcpy (priv->buffer + priv->buffer_len, buffer, n);
+	priv->buffer_len += n;
+	priv->offset += n;
+	return n;
+}
+
+static void
+append_le (GByteArray *array, guint32 value, guint bytes)
+{
+	while (bytes--)
+	{
+		guint8 byte = value & 0xff;
+		g_byte_array_append (array, &byte, 1);
+		value >>= 8;
+	}
+}
+
+/// Write out the gzip header, including the RA subfield, all compressed
+/// chunks, and the gzip trailer, into the base stream.
+static gboolean
+write_file (DictzipOutputStream *self,
+	GCancellable *cancellable, GError **error)
+{
+	DictzipOutputStreamPrivate *priv = self->priv;
+	GOutputStream *base_stream = G_FILTER_OUTPUT_STREAM (self)->base_stream;
+	guint n_chunks = priv->chunks->len;
+
+	// Magic, deflate, FEXTRA, no timestamp, maximum compression, Unix
+	static const guint8 gzip_header[] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 2, 3 };
+	GByteArray *header = g_byte_array_new ();
+	g_byte_array_append (header, gzip_header, sizeof gzip_header);
+	append_le (header, 10 + n_chunks * 2, 2);
+
+	g_byte_array_append (header, (const guint8 *) "RA", 2);
+	append_le (header, 6 + n_chunks * 2, 2);
+	append_le (header, 1, 2);
+	append_le (header, DICTZIP_CHUNK_LENGTH, 2);
+	append_le (header, n_chunks, 2);
+
+	gboolean ok = FALSE;
+	guint32 crc = crc32 (0, NULL, 0);
+	for (guint i = 0; i < n_chunks; i++)
+	{
+		DictzipChunk *chunk = g_ptr_array_index (priv->chunks, i);
+		if (chunk->z_err != Z_OK)
+		{
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				"failed to deflate a chunk: %s", zError (chunk->z_err));
+			goto out;
+		}
+
+		append_le (header, chunk->deflated_length, 2);
+		crc = crc32_combine (crc, chunk->crc, chunk->length);
+	}
+
+	if (!g_output_stream_write_all (base_stream,
+		header->data, header->len, NULL, cancellable, error))
+		goto out;
+
+	for (guint i = 0; i < n_chunks; i++)
+	{
+		DictzipChunk *chunk = g_ptr_array_index (priv->chunks, i);
+		if (!g_output_stream_write_all (base_stream, chunk->deflated,
+			chunk->deflated_length, NULL, cancellable, error))
+			goto out;
+	}
+
+	GByteArray *trailer = g_byte_array_new ();
+	append_le (trailer, crc, 4);
+	append_le (trailer, priv->offset & 0xffffffff, 4);
+	ok = g_output_stream_write_all (base_stream,
+		trailer->data, trailer->len, NULL, cancellable, error);
+	g_byte_array_free (trailer, TRUE);
+out:
+	g_byte_array_free (header, TRUE);
+	return ok;
+}
+
+static gboolean
+dictzip_output_stream_close (GOutputStream *stream,
+	GCancellable *cancellable, GError **error)
+{
+	DictzipOutputStream *self = DICTZIP_OUTPUT_STREAM (stream);
+	DictzipOutputStreamPrivate *priv = self->priv;
+
+	// The last chunk may itself turn out to be one too many
+	GError *e = NULL;
+	if (!priv->uncompressed && dispatch_chunk (self, TRUE, &e)
+	 && !priv->uncompressed)
+	{
+		wait_for_compressor (priv);
+		(void) write_file (self, cancellable, &e);
+	}
+
+	// Chaining up closes the base stream, unless told otherwise
+	GOutputStreamClass *parent_class =
+		G_OUTPUT_STREAM_CLASS (dictzip_output_stream_parent_class);
+	if (!e)
+		return parent_class->close_fn (stream, cancellable, error);
+
+	(void) parent_class->close_fn (stream, cancellable, NULL);
+	g_propagate_error (error, e);
+	return FALSE;
+}
+
+/// Create a stream that writes dictzip data into the base stream.
+/// Compressed chunks are kept in memory until the stream is closed,
+/// since the header lists their sizes.  Should there be too much data
+/// for the format, they're written out uncompressed instead.
+DictzipOutputStream *
+dictzip_output_stream_new (GOutputStream *base_stream)
+{
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (base_stream), NULL);
+	return g_object_new (DICTZIP_TYPE_OUTPUT_STREAM,
+		"base-stream", base_stream, NULL);
+}
+
+/// Return whether the stream still produces dictzip data.
+gboolean
+dictzip_output_stream_is_compressed (DictzipOutputStream *self)
+{
+	g_return_val_if_fail (DICTZIP_IS_OUTPUT_STREAM (self), FALSE);
+	return !self->priv->uncompressed;
+}
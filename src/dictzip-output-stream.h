@@ -0,0 +1,62 @@
+/*
+ * dictzip-output-stream.h: dictzip GIO stream writer
+ *
+ * Copyright (c) 2026, Přemysl Eric Janouch <p@janouch.name>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef DICTZIP_OUTPUT_STREAM_H
+#define DICTZIP_OUTPUT_STREAM_H
+
+/// Dictzip writer, compressing chunks in parallel.
+typedef struct dictzip_output_stream          DictzipOutputStream;
+typedef struct dictzip_output_stream_class    DictzipOutputStreamClass;
+typedef struct dictzip_output_stream_private  DictzipOutputStreamPrivate;
+
+// GObject boilerplate.
+#define DICTZIP_TYPE_OUTPUT_STREAM  (dictzip_output_stream_get_type ())
+#define DICTZIP_OUTPUT_STREAM(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+	DICTZIP_TYPE_OUTPUT_STREAM, DictzipOutputStream))
+#define DICTZIP_IS_OUTPUT_STREAM(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+	DICTZIP_TYPE_OUTPUT_STREAM))
+#define DICTZIP_OUTPUT_STREAM_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST ((klass), \
+	DICTZIP_TYPE_OUTPUT_STREAM, DictzipOutputStreamClass))
+#define DICTZIP_IS_OUTPUT_STREAM_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE ((klass), \
+	DICTZIP_TYPE_OUTPUT_STREAM))
+#define DICTZIP_OUTPUT_STREAM_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS ((obj), \
+	DICTZIP_TYPE_OUTPUT_STREAM, DictzipOutputStreamClass))
+
+// --- DictzipOutputStream -----------------------------------------------------
+
+struct dictzip_output_stream
+{
+	GFilterOutputStream parent_instance;
+	DictzipOutputStreamPrivate *priv;
+};
+
+struct dictzip_output_stream_class
+{
+	GFilterOutputStreamClass parent_class;
+};
+
+GType dictzip_output_stream_get_type (void);
+DictzipOutputStream *dictzip_output_stream_new (GOutputStream *base_stream);
+gboolean dictzip_output_stream_is_compressed (DictzipOutputStream *self);
+
+#endif  // ! DICTZIP_OUTPUT_STREAM_H
@@ -19,13 +19,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 
 #include "stardict.h"
 #include "stardict-private.h"
 #include "generator.h"
+#include "dictzip-output-stream.h"
 
 
 /// Creates an output stream for a path plus suffix.
@@ -43,23 +46,34 @@ replace_file_by_suffix (const gchar *base, const gchar *suffix, GError **error)
 }
 
 /// Creates a Stardict dictionary generator for the specified basename.
+/// With @a dictzip, the data file is compressed as it is being written,
+/// unless it grows too large for the format.
 Generator *
-generator_new (const gchar *base, GError **error)
+generator_new (const gchar *base, gboolean dictzip, GError **error)
 {
 	Generator *self = g_malloc0 (sizeof *self);
 	self->info = g_malloc0 (sizeof *self->info);
 	self->info->path = g_strconcat (base, ".ifo", NULL);
 
-	self->dict_stream = replace_file_by_suffix (base, ".dict", error);
-	if (!self->dict_stream)
+	GFileOutputStream *dict_file =
+		replace_file_by_suffix (base, dictzip ? ".dict.dz" : ".dict", error);
+	if (!dict_file)
 		goto error_dict;
 
+	if (!dictzip)
+		self->dict_stream = G_OUTPUT_STREAM (dict_file);
+	else
+	{
+		self->dict_stream = G_OUTPUT_STREAM
+			(dictzip_output_stream_new (G_OUTPUT_STREAM (dict_file)));
+		g_object_unref (dict_file);
+	}
+
 	self->idx_stream = replace_file_by_suffix (base, ".idx", error);
 	if (!self->idx_stream)
 		goto error_idx;
 
-	self->dict_data = g_data_output_stream_new
-		(G_OUTPUT_STREAM (self->dict_stream));
+	self->dict_data = g_data_output_stream_new (self->dict_stream);
 	g_data_output_stream_set_byte_order
 		(self->dict_data, G_DATA_STREAM_BYTE_ORDER_BIG_ENDIAN);
 
@@ -78,6 +92,47 @@ error_dict:
 	return NULL;
 }
 
+/// Returns the path of the uncompressed data file.
+static gchar *
+get_uncompressed_dict_path (Generator *self)
+{
+	const gchar *ifo_path = self->info->path;
+	return g_strdup_printf ("%.*s.dict",
+		(int) (strlen (ifo_path) - strlen (".ifo")), ifo_path);
+}
+
+/// Removes any uncompressed data file, which would take precedence.
+static gboolean
+remove_uncompressed_dict (Generator *self, GError **error)
+{
+	gchar *path = get_uncompressed_dict_path (self);
+	gboolean ok = !g_unlink (path) || errno == ENOENT;
+	if (!ok)
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"%s: %s", path, g_strerror (errno));
+	g_free (path);
+	return ok;
+}
+
+/// Gives the data file its proper name, after the dictzip stream has given up
+/// compressing it for there being too much data.
+static gboolean
+rename_to_uncompressed_dict (Generator *self, GError **error)
+{
+	if (!remove_uncompressed_dict (self, error))
+		return FALSE;
+
+	gchar *path = get_uncompressed_dict_path (self);
+	gchar *dz_path = g_strconcat (path, ".dz", NULL);
+	gboolean ok = !g_rename (dz_path, path);
+	if (!ok)
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"%s: %s", dz_path, g_strerror (errno));
+	g_free (dz_path);
+	g_free (path);
+	return ok;
+}
+
 /// Finishes the dictionary and writes the .ifo file.
 gboolean
 generator_finish (Generator *self, GError **error)
@@ -92,11 +147,18 @@ generator_finish (Generator *self, GError **error)
 	self->info->idx_filesize = g_seekable_tell (G_SEEKABLE (self->idx_stream));
 	self->info->idx_offset_bits = 32;
 
-	if (!g_output_stream_close
-		(G_OUTPUT_STREAM (self->dict_stream), NULL, error)
+	if (!g_output_stream_close (self->dict_stream, NULL, error)
 	 || !g_output_stream_close
 		(G_OUTPUT_STREAM (self->idx_stream), NULL, error))
 		return FALSE;
+	if (DICTZIP_IS_OUTPUT_STREAM (self->dict_stream))
+	{
+		DictzipOutputStream *dz = DICTZIP_OUTPUT_STREAM (self->dict_stream);
+		if (dictzip_output_stream_is_compressed (dz)
+			? !remove_uncompressed_dict (self, error)
+			: !rename_to_uncompressed_dict (self, error))
+			return FALSE;
+	}
 
 	guint i;
 	for (i = 0; i < _stardict_ifo_keys_length; i++)
@@ -152,7 +214,7 @@ generator_write_raw (Generator *self,
 	gsize written;
 	if ((mark_end && !g_data_output_stream_put_uint32
 			(self->dict_data, data_size, NULL, error))
-	 || !g_output_stream_write_all (G_OUTPUT_STREAM (self->dict_stream),
+	 || !g_output_stream_write_all (self->dict_stream,
 			data, data_size, &written, NULL, error))
 		return FALSE;
 	return TRUE;
@@ -31,14 +31,15 @@ struct generator
 
 	goffset              entry_mark;   ///< Marks the entry's start offset
 
-	GFileOutputStream  * dict_stream;  ///< Dictionary stream
+	GOutputStream      * dict_stream;  ///< Dictionary stream, maybe dictzip
 	GDataOutputStream  * dict_data;    ///< Dictionary data stream wrapper
 
 	GFileOutputStream  * idx_stream;   ///< Index file stream
 	GDataOutputStream  * idx_data;     ///< Index file data stream wrapper
 };
 
-Generator *generator_new (const gchar *base, GError **error);
+Generator *generator_new (const gchar *base, gboolean dictzip,
+	GError **error);
 gboolean generator_finish (Generator *self, GError **error);
 void generator_free (Generator *self);
 
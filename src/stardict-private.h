@@ -22,9 +22,6 @@
 /// Describes a single entry in the dictionary index.
 typedef struct stardict_index_entry     StardictIndexEntry;
 
-/// Describes a single entry in the synonyms index.
-typedef struct stardict_synonym_entry   StardictSynonymEntry;
-
 
 typedef enum stardict_version StardictVersion;
 enum stardict_version { SD_VERSION_2_4_2, SD_VERSION_3_0_0 };
@@ -51,16 +48,9 @@ struct stardict_info
 
 struct stardict_index_entry
 {
-	gchar           * name;             ///< The word in utf-8
+	const gchar     * name;             ///< The word in utf-8
 	guint64           data_offset;      ///< Offset of the definition
 	guint32           data_size;        ///< Size of the definition
-	guint32           reverse_index;    ///< Word at this index before sorting
-};
-
-struct stardict_synonym_entry
-{
-	gchar           * word;             ///< A synonymous word
-	guint32           original_word;    ///< The original word's index
 };
 
 struct stardict_ifo_key
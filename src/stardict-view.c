@@ -27,12 +27,17 @@ typedef struct view_entry ViewEntry;
 
 struct view_entry
 {
+	StardictDict *dict;                 ///< The entry's dictionary (weak)
+	guint position;                     ///< Index within the dictionary
+
 	gchar *word;                        ///< The word
 	gsize word_matched;                 ///< Initial matching bytes of the word
 	gchar *definition;                  ///< Definition lines, in Pango markup
 
 	PangoLayout *word_layout;           ///< Ellipsized one-line layout or NULL
 	PangoLayout *definition_layout;     ///< Multiline layout or NULL
+	gint layout_width;                  ///< Width the layouts were made for
+	guint layout_serial;                ///< PangoContext serial of the layouts
 };
 
 static void
@@ -88,6 +93,8 @@ view_entry_new (StardictIterator *iterator, const gchar *matched)
 	g_object_unref (entry);
 
 	ViewEntry *ve = g_slice_alloc0 (sizeof *ve);
+	ve->dict = iterator->owner;
+	ve->position = stardict_iterator_get_offset (iterator);
 	ve->word = g_string_free (adjusted_word, FALSE);
 	ve->word_matched = stardict_longest_common_collation_prefix
 		(iterator->owner, word, matched);
@@ -253,21 +260,30 @@ view_entry_draw (ViewEntry *ve, ViewEntryRenderCtx *ctx)
 	return ctx->height;
 }
 
+/// Make sure the entry has layouts fitting the widget.  Layouts are only
+/// rebuilt when their width or the font setup has changed since.
 static void
-view_entry_rebuild_layouts (ViewEntry *ve, GtkWidget *widget)
+view_entry_ensure_layouts (ViewEntry *ve, GtkWidget *widget)
 {
 	PangoContext *pc = gtk_widget_get_pango_context (widget);
 	GtkStyleContext *style = gtk_widget_get_style_context (widget);
 	gint full_width = gtk_widget_get_allocated_width (widget);
 
-	g_clear_object (&ve->word_layout);
-	g_clear_object (&ve->definition_layout);
-
 	GtkBorder padding = view_entry_get_padding (style);
 	gint part_width = full_width / 2 - padding.left - padding.right;
+	guint serial = pango_context_get_serial (pc);
+	if (ve->word_layout
+	 && ve->layout_width == part_width && ve->layout_serial == serial)
+		return;
+
+	g_clear_object (&ve->word_layout);
+	g_clear_object (&ve->definition_layout);
 	if (part_width < 1)
 		return;
 
+	ve->layout_width = part_width;
+	ve->layout_serial = serial;
+
 	// Left/right-dependent fonts aren't supported
 	ve->word_layout = pango_layout_new (pc);
 	pango_layout_set_text (ve->word_layout, ve->word, -1);
@@ -294,18 +310,30 @@ view_entry_rebuild_layouts (ViewEntry *ve, GtkWidget *widget)
 
 // --- Widget ------------------------------------------------------------------
 
+/// How many entries that have gone out of view are kept for reuse
+#define VIEW_RECYCLE_LIMIT  64
+
+/// How many entries may be made ahead of time in each direction
+#define VIEW_PREFETCH_LIMIT  16
+
 struct _StardictView
 {
 	GtkWidget parent_instance;
 
 	StardictDict *dict;                 ///< The displayed dictionary
-	guint top_position;                 ///< Index of the topmost dict. entry
+	GArray *results;                    ///< Displayed positions, or all if NULL
+	GArray *merged;                     ///< Displayed MergedResult-s, or NULL
+	guint top_position;                 ///< Index of the topmost view entry
 	gchar *matched;                     ///< Highlight common word part of this
 
 	gint top_offset;                    ///< Pixel offset into the entry
 	gdouble drag_last_offset;           ///< Last offset when dragging
 	GList *entries;                     ///< ViewEntry-s within the view
 
+	GQueue recycled;                    ///< Other ViewEntry-s, newest first
+	guint prefetch_source;              ///< Idle source making entries ahead
+	gint estimated_height;              ///< Running average of entry heights
+
 	GtkGesture *selection_gesture;      ///< Selection gesture
 	GWeakRef selection;                 ///< Selected PangoLayout, if any
 	int selection_begin;                ///< Start index within `selection`
@@ -321,10 +349,179 @@ make_entry (StardictView *self, StardictIterator *iterator)
 {
 	const gchar *matched = self->matched ? self->matched : "";
 	ViewEntry *ve = view_entry_new (iterator, matched);
-	view_entry_rebuild_layouts (ve, GTK_WIDGET (self));
+	if (!ve)
+		return NULL;
+
+	// Entries of merged results can come from any dictionary
+	if (self->merged)
+	{
+		gchar *word = g_strdup_printf ("%s (%s)", ve->word,
+			stardict_info_get_book_name
+				(stardict_dict_get_info (iterator->owner)));
+		g_free (ve->word);
+		ve->word = word;
+	}
+
+	view_entry_ensure_layouts (ve, GTK_WIDGET (self));
+	if (ve->word_layout)
+	{
+		gint height = view_entry_height (ve, NULL, NULL);
+		self->estimated_height = self->estimated_height
+			? (7 * self->estimated_height + height) / 8
+			: height;
+	}
 	return ve;
 }
 
+/// Return the number of positions within the displayed contents.
+static guint
+displayed_count (StardictView *self)
+{
+	if (self->merged)
+		return self->merged->len;
+	if (self->results)
+		return self->results->len;
+	return stardict_info_get_word_count (stardict_dict_get_info (self->dict));
+}
+
+/// Find out which dictionary entry is shown at the given position
+/// within the displayed contents, if any.
+static gboolean
+resolve_position (StardictView *self, guint position,
+	StardictDict **dict, guint *dict_position)
+{
+	*dict = self->dict;
+	*dict_position = position;
+	if (self->merged)
+	{
+		if (position >= self->merged->len)
+			return FALSE;
+
+		MergedResult *result =
+			&g_array_index (self->merged, MergedResult, position);
+		*dict = result->dict;
+		*dict_position = result->position;
+	}
+	else if (self->results)
+	{
+		if (position >= self->results->len)
+			return FALSE;
+		*dict_position = g_array_index (self->results, guint32, position);
+	}
+	return TRUE;
+}
+
+static GList *
+find_recycled (StardictView *self, StardictDict *dict, guint position)
+{
+	for (GList *iter = self->recycled.head; iter; iter = iter->next)
+	{
+		ViewEntry *ve = iter->data;
+		if (ve->dict == dict && ve->position == position)
+			return iter;
+	}
+	return NULL;
+}
+
+/// Keep an entry that has gone out of view, so that it can be reused.
+static void
+recycle_entry (StardictView *self, ViewEntry *ve)
+{
+	g_queue_push_head (&self->recycled, ve);
+	while (self->recycled.length > VIEW_RECYCLE_LIMIT)
+		view_entry_destroy (g_queue_pop_tail (&self->recycled));
+}
+
+static void
+clear_recycled (StardictView *self)
+{
+	ViewEntry *ve = NULL;
+	while ((ve = g_queue_pop_head (&self->recycled)))
+		view_entry_destroy (ve);
+}
+
+/// Make an entry for the given position within the displayed contents,
+/// or return NULL if there is no such position.
+static ViewEntry *
+make_entry_at (StardictView *self, guint position)
+{
+	StardictDict *dict = NULL;
+	if (!resolve_position (self, position, &dict, &position))
+		return NULL;
+
+	GList *link = find_recycled (self, dict, position);
+	if (link)
+	{
+		ViewEntry *ve = link->data;
+		g_queue_delete_link (&self->recycled, link);
+		view_entry_ensure_layouts (ve, GTK_WIDGET (self));
+		return ve;
+	}
+
+	StardictIterator *iterator = stardict_iterator_new (dict, position);
+	ViewEntry *ve = NULL;
+	if (stardict_iterator_is_valid (iterator))
+		ve = make_entry (self, iterator);
+	g_object_unref (iterator);
+	return ve;
+}
+
+/// Make an entry for the given position ahead of time, unless it exists.
+/// Returns whether any work has been done.
+static gboolean
+prefetch_entry_at (StardictView *self, guint position)
+{
+	StardictDict *dict = NULL;
+	if (!resolve_position (self, position, &dict, &position)
+	 || find_recycled (self, dict, position))
+		return FALSE;
+
+	StardictIterator *iterator = stardict_iterator_new (dict, position);
+	ViewEntry *ve = NULL;
+	if (stardict_iterator_is_valid (iterator)
+	 && (ve = make_entry (self, iterator)))
+		recycle_entry (self, ve);
+	g_object_unref (iterator);
+	return ve != NULL;
+}
+
+/// Prepare entries surrounding the view while idle, one at a time,
+/// so that scrolling rarely has to lay anything out.
+static gboolean
+on_prefetch (gpointer user_data)
+{
+	StardictView *self = STARDICT_VIEW (user_data);
+	GtkWidget *widget = GTK_WIDGET (self);
+	if (!gtk_widget_get_realized (widget) || !self->dict)
+		goto out;
+
+	// Estimated heights stand for those of entries not yet made,
+	// and about a screenful is needed on either side
+	gint screenful = gtk_widget_get_allocated_height (widget)
+		/ MAX (1, self->estimated_height) + 1;
+	guint count = MIN (VIEW_PREFETCH_LIMIT, screenful);
+
+	guint below = self->top_position + g_list_length (self->entries);
+	for (guint i = 0; i < count; i++)
+	{
+		if (prefetch_entry_at (self, below + i)
+		 || (i < self->top_position
+		  && prefetch_entry_at (self, self->top_position - 1 - i)))
+			return G_SOURCE_CONTINUE;
+	}
+out:
+	self->prefetch_source = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_prefetch (StardictView *self)
+{
+	if (!self->prefetch_source)
+		self->prefetch_source =
+			g_idle_add_full (G_PRIORITY_LOW, on_prefetch, self, NULL);
+}
+
 static void
 reset_hover (StardictView *self)
 {
@@ -346,8 +543,7 @@ static void
 adjust_for_height (StardictView *self)
 {
 	GtkWidget *widget = GTK_WIDGET (self);
-	StardictIterator *iterator =
-		stardict_iterator_new (self->dict, self->top_position);
+	guint position = self->top_position;
 
 	gint missing = gtk_widget_get_allocated_height (widget) + self->top_offset;
 	for (GList *iter = self->entries, *next;
@@ -357,21 +553,19 @@ adjust_for_height (StardictView *self)
 			missing -= view_entry_height (iter->data, NULL, NULL);
 		else
 		{
-			view_entry_destroy (iter->data);
+			recycle_entry (self, iter->data);
 			self->entries = g_list_delete_link (self->entries, iter);
 		}
-		stardict_iterator_next (iterator);
+		position++;
 	}
 
 	GList *append = NULL;
-	while (missing > 0 && stardict_iterator_is_valid (iterator))
+	ViewEntry *ve = NULL;
+	while (missing > 0 && (ve = make_entry_at (self, position++)))
 	{
-		ViewEntry *ve = make_entry (self, iterator);
 		missing -= view_entry_height (ve, NULL, NULL);
 		append = g_list_prepend (append, ve);
-		stardict_iterator_next (iterator);
 	}
-	g_object_unref (iterator);
 
 	// Also handling this for adjust_for_offset(), which calls this.
 	PangoLayout *selection = g_weak_ref_get (&self->selection);
@@ -383,29 +577,27 @@ adjust_for_height (StardictView *self)
 	reset_hover (self);
 	self->entries = g_list_concat (self->entries, g_list_reverse (append));
 	gtk_widget_queue_draw (widget);
+	schedule_prefetch (self);
 }
 
 static void
 adjust_for_offset (StardictView *self)
 {
 	// If scrolled way up, prepend entries so long as it's possible
-	StardictIterator *iterator =
-		stardict_iterator_new (self->dict, self->top_position);
 	while (self->top_offset < 0)
 	{
-		stardict_iterator_prev (iterator);
-		if (!stardict_iterator_is_valid (iterator))
+		ViewEntry *ve = NULL;
+		if (!self->top_position
+		 || !(ve = make_entry_at (self, self->top_position - 1)))
 		{
 			self->top_offset = 0;
 			break;
 		}
 
-		self->top_position = stardict_iterator_get_offset (iterator);
-		ViewEntry *ve = make_entry (self, iterator);
+		self->top_position--;
 		self->top_offset += view_entry_height (ve, NULL, NULL);
 		self->entries = g_list_prepend (self->entries, ve);
 	}
-	g_object_unref (iterator);
 
 	// If scrolled way down, drop leading entries so long as it's possible
 	while (self->entries)
@@ -415,10 +607,19 @@ adjust_for_offset (StardictView *self)
 			break;
 
 		self->top_offset -= height;
-		view_entry_destroy (self->entries->data);
+		recycle_entry (self, self->entries->data);
 		self->entries = g_list_delete_link (self->entries, self->entries);
 		self->top_position++;
+	}
 
+	// When scrolled past everything that has been made, skip entries
+	// by their estimated height, rather than laying them all out
+	if (self->top_offset && !self->entries && self->estimated_height)
+	{
+		guint count = displayed_count (self);
+		guint skip = self->top_offset / self->estimated_height;
+		if (self->top_position < count)
+			self->top_position += MIN (skip, count - 1 - self->top_position);
 	}
 	if (self->top_offset && !self->entries)
 		self->top_offset = 0;
@@ -434,6 +635,7 @@ reload (StardictView *self)
 
 	g_list_free_full (self->entries, (GDestroyNotify) view_entry_destroy);
 	self->entries = NULL;
+	clear_recycled (self);
 	gtk_widget_queue_draw (widget);
 
 	// For consistency, and the check in make_context_menu()
@@ -586,9 +788,14 @@ stardict_view_finalize (GObject *gobject)
 {
 	StardictView *self = STARDICT_VIEW (gobject);
 	g_clear_object (&self->dict);
+	g_clear_pointer (&self->results, g_array_unref);
+	g_clear_pointer (&self->merged, g_array_unref);
 
 	g_list_free_full (self->entries, (GDestroyNotify) view_entry_destroy);
 	self->entries = NULL;
+	clear_recycled (self);
+	if (self->prefetch_source)
+		g_source_remove (self->prefetch_source);
 
 	g_object_unref (self->selection_gesture);
 	g_weak_ref_clear (&self->selection);
@@ -791,8 +998,9 @@ stardict_view_size_allocate (GtkWidget *widget, GtkAllocation *allocation)
 	if (selection)
 		g_object_unref (selection);
 
+	// Out of view entries get their layouts updated once they're needed
 	for (GList *iter = self->entries; iter; iter = iter->next)
-		view_entry_rebuild_layouts (iter->data, widget);
+		view_entry_ensure_layouts (iter->data, widget);
 	if (origin)
 		g_weak_ref_set (&self->selection, *origin);
 
@@ -1134,6 +1342,8 @@ stardict_view_class_init (StardictViewClass *klass)
 static void
 stardict_view_init (StardictView *self)
 {
+	g_queue_init (&self->recycled);
+
 	g_weak_ref_init (&self->selection, NULL);
 	self->selection_begin = -1;
 	self->selection_end = -1;
@@ -1183,12 +1393,74 @@ stardict_view_set_position (StardictView *self,
 
 	g_clear_object (&self->dict);
 	self->dict = dict ? g_object_ref (dict) : NULL;
+	g_clear_pointer (&self->results, g_array_unref);
+	g_clear_pointer (&self->merged, g_array_unref);
 	self->top_position = position;
 	self->top_offset = 0;
 
 	reload (self);
 }
 
+/// Only show entries at the given index positions, in order.
+void
+stardict_view_set_results (StardictView *self,
+	StardictDict *dict, GArray *positions)
+{
+	g_return_if_fail (STARDICT_IS_VIEW (self));
+	g_return_if_fail (STARDICT_IS_DICT (dict));
+	g_return_if_fail (positions != NULL);
+
+	if (!self->dict)
+		gtk_widget_queue_resize (GTK_WIDGET (self));
+
+	g_clear_object (&self->dict);
+	self->dict = g_object_ref (dict);
+	g_clear_pointer (&self->results, g_array_unref);
+	g_clear_pointer (&self->merged, g_array_unref);
+	self->results = g_array_ref (positions);
+	self->top_position = 0;
+	self->top_offset = 0;
+
+	reload (self);
+}
+
+/// Show results of a merged search.  When called again for the same search
+/// from within its callback, the view keeps showing the same entries.
+void
+stardict_view_set_merged (StardictView *self,
+	StardictDict *dict, MergedSearch *search)
+{
+	g_return_if_fail (STARDICT_IS_VIEW (self));
+	g_return_if_fail (STARDICT_IS_DICT (dict));
+	g_return_if_fail (search != NULL);
+
+	if (self->merged == search->results)
+	{
+		gboolean dropped = FALSE;
+		if (self->entries && (self->top_position || self->top_offset))
+			self->top_position =
+				merged_search_remap (search, self->top_position, &dropped);
+		if (dropped)
+			self->top_offset = 0;
+
+		reload (self);
+		return;
+	}
+
+	if (!self->dict)
+		gtk_widget_queue_resize (GTK_WIDGET (self));
+
+	g_clear_object (&self->dict);
+	self->dict = g_object_ref (dict);
+	g_clear_pointer (&self->results, g_array_unref);
+	g_clear_pointer (&self->merged, g_array_unref);
+	self->merged = g_array_ref (search->results);
+	self->top_position = 0;
+	self->top_offset = 0;
+
+	reload (self);
+}
+
 void
 stardict_view_set_matched (StardictView *self, const gchar *matched)
 {
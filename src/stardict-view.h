@@ -22,6 +22,7 @@
 #include <gtk/gtk.h>
 
 #include "stardict.h"
+#include "utils.h"
 
 #define STARDICT_TYPE_VIEW  (stardict_view_get_type ())
 G_DECLARE_FINAL_TYPE (StardictView, stardict_view, STARDICT, VIEW, GtkWidget)
@@ -29,6 +30,10 @@ G_DECLARE_FINAL_TYPE (StardictView, stardict_view, STARDICT, VIEW, GtkWidget)
 GtkWidget *stardict_view_new (void);
 void stardict_view_set_position (StardictView *view,
 	StardictDict *dict, guint position);
+void stardict_view_set_results (StardictView *view,
+	StardictDict *dict, GArray *positions);
+void stardict_view_set_merged (StardictView *view,
+	StardictDict *dict, MergedSearch *search);
 void stardict_view_set_matched (StardictView *view, const gchar *matched);
 void stardict_view_scroll (StardictView *view,
 	GtkScrollStep step, gdouble amount);
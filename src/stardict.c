@@ -20,14 +20,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h>
+#include <errno.h>
 
 #include <glib.h>
 #include <gio/gio.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include <unicode/ucol.h>
 #include <unicode/ustring.h>
 #include <unicode/ubrk.h>
+#include <unicode/uversion.h>
 
 #include "stardict.h"
 #include "stardict-private.h"
@@ -403,18 +406,67 @@ stardict_list_dictionaries (const gchar *path)
 
 // --- StardictDict ------------------------------------------------------------
 
+/// The default limit for the total size of decoded entries kept around
+#define STARDICT_ENTRY_CACHE_DEFAULT_LIMIT  (4 << 20)
+
+typedef struct entry_cache_item EntryCacheItem;
+
+/// A decoded entry kept within the dictionary's entry cache
+struct entry_cache_item
+{
+	GList           link;               //!< Link within the LRU queue
+	guint32         offset;             //!< Index offset of the entry
+	StardictEntry * entry;              //!< The decoded entry
+	gsize           size;               //!< Approximate memory usage
+};
+
+static void
+entry_cache_item_free (EntryCacheItem *self)
+{
+	g_object_unref (self->entry);
+	g_slice_free (EntryCacheItem, self);
+}
+
+/// A trigram index of folded words for finding misspelled ones
+typedef struct fuzzy_index FuzzyIndex;
+
+static void fuzzy_index_free (FuzzyIndex *self);
+static gsize fuzzy_index_size (const FuzzyIndex *self);
+
 struct stardict_dict_private
 {
 	StardictInfo  * info;               //!< General information about the dict
-	GArray        * index;              //!< Word index
-	GArray        * synonyms;           //!< Synonyms
-	GStringChunk  * string_allocator;   //!< String allocator (index+synonyms)
+
+	// The index and synonyms are kept in their on-disk form, only entry
+	// positions are stored.  The tables are usually mapped from the index
+	// cache, so that all processes using the dictionary share them.
+
+	GBytes        * idx_data;           //!< Index file contents
+	const gchar   * idx;                //!< Data of @a idx_data
+	GBytes        * syn_data;           //!< Synonyms file contents or NULL
+	const gchar   * syn;                //!< Data of @a syn_data
+
+	GBytes        * tables;             //!< Memory of all the tables below
+	const guint32 * index_words;        //!< Entry offsets within @a idx
+	const guint32 * index_reverse;      //!< Original -> collated, or NULL
+	guint32         index_length;       //!< Number of index entries
+	const guint32 * synonym_words;      //!< Sorted entry offsets within @a syn
+	guint32         synonyms_length;    //!< Number of synonyms
+
+	// Uncollated indexes are searched through ASCII-folded word prefixes,
+	// packed so that they compare as integers, and laid out in the Eytzinger
+	// order for better cache locality.  The root node is at position 1.
+
+	guint64       * search_prefixes;    //!< Prefixes of words, or NULL
+	guint32       * search_positions;   //!< Index positions of the prefixes
 
 	// The collated indexes are only permutations of their normal selves.
 
 	UCollator     * collator;           //!< ICU index collator
-	UCollator     * collator_root;      //!< ICU fallback root collator
-	GArray        * collated_synonyms;  //!< Sorted indexes into @a synonyms
+	UCollator     * collator_primary;   //!< The same, at primary strength
+
+	const guint32 * sort_key_offsets;   //!< Offsets of sort keys, or NULL
+	const gchar   * sort_key_data;      //!< NUL-terminated sort keys
 
 	// There are currently three ways the dictionary data can be read:
 	// through mmap(), from a seekable GInputStream, or from a preallocated
@@ -426,29 +478,66 @@ struct stardict_dict_private
 	GMappedFile   * mapped_dict;        //!< Dictionary memory map handle
 	gpointer        dict;               //!< Dictionary data
 	gsize           dict_length;        //!< Length of the dict data in bytes
+
+	// Decoded entries, so that redrawing the same screenful is cheap.
+
+	GMutex          entry_cache_lock;   //!< Guards the entry cache
+	GHashTable    * entry_cache;        //!< Index offset -> EntryCacheItem
+	GQueue          entry_cache_lru;    //!< Most recently used items first
+	gsize           entry_cache_size;   //!< Current size of cached entries
+	gsize           entry_cache_limit;  //!< Maximum size of cached entries
+	guint64         entry_cache_hits;   //!< Entries found within the cache
+	guint64         entry_cache_misses; //!< Entries that had to be decoded
+	guint64         entry_cache_evictions;  //!< Entries dropped to fit
+
+	// Secondary indexes are built on demand, and kept in separate files.
+
+	gchar         * idx_path;           //!< Path to the index file
+	GMutex          fuzzy_lock;         //!< Guards the fuzzy index
+	GCond           fuzzy_cond;         //!< Signals a finished fuzzy index
+	FuzzyIndex    * fuzzy;              //!< Fuzzy index, or NULL
+	gboolean        fuzzy_building;     //!< The fuzzy index is being built
+	GMutex          fulltext_lock;      //!< Guards the full-text index
+	GBytes        * fulltext;           //!< Full-text index, or NULL
+
+	GMutex          stats_lock;         //!< Guards @a stats
+	StardictDictStats stats;            //!< Our own part of the statistics
+
+	// Data may be loaded only once they are needed, and released again
+	// when nothing is using them, leaving just @a info in place.
+
+	GMutex          load_lock;          //!< Serializes (un)loading of data
+	GError        * load_error;         //!< Why loading failed, or NULL
+	gint            load_warned;        //!< @a load_error was logged, atomic
+	gint            loaded;             //!< Whether data are loaded, atomic
+	gint            users;              //!< Current users of data, atomic
+	gint            last_used;          //!< Monotonic time in seconds, atomic
 };
 
 G_DEFINE_TYPE_WITH_CODE (StardictDict, stardict_dict, G_TYPE_OBJECT,
 	G_ADD_PRIVATE (StardictDict))
 
+static void stardict_dict_set_tables (StardictDict *sd, GBytes *tables);
+
+/// Release all data of the dictionary, making it look empty.
 static void
-stardict_dict_finalize (GObject *self)
+stardict_dict_free_data (StardictDict *sd)
 {
-	StardictDictPrivate *priv = STARDICT_DICT (self)->priv;
-
-	if (priv->info)
-		stardict_info_free (priv->info);
+	StardictDictPrivate *priv = sd->priv;
 
-	g_array_free (priv->index, TRUE);
-	g_array_free (priv->synonyms, TRUE);
-	g_string_chunk_free (priv->string_allocator);
+	if (priv->idx_data)
+		g_bytes_unref (priv->idx_data);
+	if (priv->syn_data)
+		g_bytes_unref (priv->syn_data);
+	priv->idx_data = priv->syn_data = NULL;
+	priv->idx = priv->syn = NULL;
+	stardict_dict_set_tables (sd, NULL);
 
 	if (priv->collator)
 		ucol_close (priv->collator);
-	if (priv->collator_root)
-		ucol_close (priv->collator_root);
-	if (priv->collated_synonyms)
-		g_array_free (priv->collated_synonyms, TRUE);
+	if (priv->collator_primary)
+		ucol_close (priv->collator_primary);
+	priv->collator = priv->collator_primary = NULL;
 
 	if (priv->mapped_dict)
 		g_mapped_file_unref (priv->mapped_dict);
@@ -456,6 +545,48 @@ stardict_dict_finalize (GObject *self)
 		g_object_unref (priv->dict_stream);
 	else
 		g_free (priv->dict);
+	priv->dict_stream = NULL;
+	priv->mapped_dict = NULL;
+	priv->dict = NULL;
+	priv->dict_length = 0;
+
+	g_mutex_lock (&priv->entry_cache_lock);
+	g_hash_table_remove_all (priv->entry_cache);
+	g_queue_init (&priv->entry_cache_lru);
+	priv->entry_cache_size = 0;
+	g_mutex_unlock (&priv->entry_cache_lock);
+
+	g_free (priv->idx_path);
+	priv->idx_path = NULL;
+	if (priv->fuzzy)
+		fuzzy_index_free (priv->fuzzy);
+	priv->fuzzy = NULL;
+	if (priv->fulltext)
+		g_bytes_unref (priv->fulltext);
+	priv->fulltext = NULL;
+}
+
+static void
+stardict_dict_finalize (GObject *self)
+{
+	StardictDictPrivate *priv = STARDICT_DICT (self)->priv;
+
+	if (priv->info)
+		stardict_info_free (priv->info);
+
+	stardict_dict_free_data (STARDICT_DICT (self));
+
+	g_hash_table_destroy (priv->entry_cache);
+	g_mutex_clear (&priv->entry_cache_lock);
+	g_mutex_clear (&priv->stats_lock);
+
+	g_mutex_clear (&priv->fuzzy_lock);
+	g_cond_clear (&priv->fuzzy_cond);
+	g_mutex_clear (&priv->fulltext_lock);
+
+	if (priv->load_error)
+		g_error_free (priv->load_error);
+	g_mutex_clear (&priv->load_lock);
 
 	G_OBJECT_CLASS (stardict_dict_parent_class)->finalize (self);
 }
@@ -470,6 +601,19 @@ static void
 stardict_dict_init (StardictDict *self)
 {
 	self->priv = stardict_dict_get_instance_private (self);
+
+	StardictDictPrivate *priv = self->priv;
+	g_mutex_init (&priv->entry_cache_lock);
+	priv->entry_cache = g_hash_table_new_full (NULL, NULL,
+		NULL, (GDestroyNotify) entry_cache_item_free);
+	g_queue_init (&priv->entry_cache_lru);
+	priv->entry_cache_limit = STARDICT_ENTRY_CACHE_DEFAULT_LIMIT;
+
+	g_mutex_init (&priv->fuzzy_lock);
+	g_cond_init (&priv->fuzzy_cond);
+	g_mutex_init (&priv->stats_lock);
+	g_mutex_init (&priv->fulltext_lock);
+	g_mutex_init (&priv->load_lock);
 }
 
 /// Load a StarDict dictionary.
@@ -498,58 +642,58 @@ stardict_dict_get_info (StardictDict *sd)
 	return sd->priv->info;
 }
 
-/// Load a StarDict index from a GIO input stream.
+static inline guint32
+read_be32 (const gchar *p)
+{
+	guint32 value;
+	memcpy (&value, p, sizeof value);
+	return GUINT32_FROM_BE (value);
+}
+
+static inline guint64
+read_be64 (const gchar *p)
+{
+	guint64 value;
+	memcpy (&value, p, sizeof value);
+	return GUINT64_FROM_BE (value);
+}
+
+/// Take over the contents of a StarDict index.  Its entries are only found
+/// when building the index tables, see stardict_dict_load_tables().
 static gboolean
-load_idx_internal (StardictDict *sd, GInputStream *is, GError **error)
+load_idx_data (StardictDict *sd, GBytes *data,
+	const gchar *filename, GError **error)
 {
 	StardictDictPrivate *priv = sd->priv;
-	GDataInputStream *dis = g_data_input_stream_new (G_INPUT_STREAM (is));
-	g_data_input_stream_set_byte_order (dis,
-		G_DATA_STREAM_BYTE_ORDER_BIG_ENDIAN);
+	priv->idx_data = data;
+	priv->idx = g_bytes_get_data (data, NULL);
 
-	StardictIndexEntry entry;
-	GError *err = NULL;
-	// Ignoring "wordcount", just reading as long as we can
-	gchar *name;
-	while ((name = stream_read_string (dis, &err)))
+	// Entries are referenced by 32-bit offsets
+	if (g_bytes_get_size (data) > G_MAXUINT32)
 	{
-		if (priv->info->idx_offset_bits == 32)
-			entry.data_offset
-				= g_data_input_stream_read_uint32 (dis, NULL, &err);
-		else
-			entry.data_offset
-				= g_data_input_stream_read_uint64 (dis, NULL, &err);
-		if (err)
-			goto error;
-
-		entry.data_size = g_data_input_stream_read_uint32 (dis, NULL, &err);
-		if (err)
-			goto error;
-
-		entry.name = g_string_chunk_insert (sd->priv->string_allocator, name);
-		entry.reverse_index = priv->index->len;
-		g_array_append_val (priv->index, entry);
-		g_free (name);
+		g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_INVALID_DATA,
+			"%s: %s", filename, _("index file is too large"));
+		return FALSE;
 	}
-
-	if (err != NULL)
-		goto error;
-
-	g_object_unref (dis);
 	return TRUE;
-
-error:
-	g_propagate_error (error, err);
-	g_free (name);
-	g_object_unref (dis);
-	return FALSE;
 }
 
-/// Load a StarDict index.
+/// Load a StarDict index.  Uncompressed ones are simply mapped into memory.
 static gboolean
 load_idx (StardictDict *sd, const gchar *filename,
 	gboolean gzipped, GError **error)
 {
+	if (!gzipped)
+	{
+		GMappedFile *mf = g_mapped_file_new (filename, FALSE, error);
+		if (!mf)
+			return FALSE;
+
+		GBytes *data = g_mapped_file_get_bytes (mf);
+		g_mapped_file_unref (mf);
+		return load_idx_data (sd, data, filename, error);
+	}
+
 	gboolean ret_val = FALSE;
 	GFile *file = g_file_new_for_path (filename);
 	GFileInputStream *fis = g_file_read (file, NULL, error);
@@ -557,69 +701,84 @@ load_idx (StardictDict *sd, const gchar *filename,
 	if (!fis)
 		goto cannot_open;
 
-	if (gzipped)
-	{
-		GZlibDecompressor *zd
-			= g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
-		GInputStream *cis = g_converter_input_stream_new
-			(G_INPUT_STREAM (fis), G_CONVERTER (zd));
-
-		ret_val = load_idx_internal (sd, cis, error);
+	GZlibDecompressor *zd
+		= g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+	GInputStream *cis = g_converter_input_stream_new
+		(G_INPUT_STREAM (fis), G_CONVERTER (zd));
 
-		g_object_unref (cis);
-		g_object_unref (zd);
-	}
+	GByteArray *ba = g_byte_array_new ();
+	if (stream_read_all (ba, cis, error))
+		ret_val = load_idx_data (sd,
+			g_byte_array_free_to_bytes (ba), filename, error);
 	else
-		ret_val = load_idx_internal (sd, G_INPUT_STREAM (fis), error);
+		g_byte_array_free (ba, TRUE);
 
+	g_object_unref (cis);
+	g_object_unref (zd);
 	g_object_unref (fis);
 cannot_open:
 	g_object_unref (file);
 	return ret_val;
 }
 
-static gboolean
-load_syn (StardictDict *sd, const gchar *filename, GError **error)
+/// Return the word of the entry at position @a i of the index.
+static inline const gchar *
+stardict_dict_index_word (StardictDict *sd, guint32 i)
 {
-	gboolean ret_val = FALSE;
-	GFile *file = g_file_new_for_path (filename);
-	GFileInputStream *fis = g_file_read (file, NULL, error);
-
-	if (!fis)
-		goto cannot_open;
+	return sd->priv->idx + sd->priv->index_words[i];
+}
 
-	GDataInputStream *dis = g_data_input_stream_new (G_INPUT_STREAM (fis));
-	g_data_input_stream_set_byte_order (dis,
-		G_DATA_STREAM_BYTE_ORDER_BIG_ENDIAN);
+/// Return the word of the synonym at position @a i, in the sorted order.
+/// The position of the word in the original index follows its terminator.
+static inline const gchar *
+stardict_dict_synonym_word (StardictDict *sd, guint32 i)
+{
+	return sd->priv->syn + sd->priv->synonym_words[i];
+}
 
-	StardictSynonymEntry entry;
-	GError *err = NULL;
-	// Ignoring "synwordcount", just reading as long as we can
-	gchar *word;
-	while ((word = stream_read_string (dis, &err)))
+/// Decode the entry at position @a i of the index.
+static void
+stardict_dict_index_entry (StardictDict *sd, guint32 i,
+	StardictIndexEntry *entry)
+{
+	StardictDictPrivate *priv = sd->priv;
+	const gchar *p = entry->name = stardict_dict_index_word (sd, i);
+	p += strlen (p) + 1;
+	if (priv->info->idx_offset_bits == 32)
 	{
-		entry.original_word = g_data_input_stream_read_uint32 (dis, NULL, &err);
-		if (err)
-			break;
-
-		entry.word = g_string_chunk_insert (sd->priv->string_allocator, word);
-		g_array_append_val (sd->priv->synonyms, entry);
-		g_free (word);
+		entry->data_offset = read_be32 (p);
+		p += sizeof (guint32);
+	}
+	else
+	{
+		entry->data_offset = read_be64 (p);
+		p += sizeof (guint64);
 	}
+	entry->data_size = read_be32 (p);
+}
+
+/// Map StarDict synonyms into memory.  Their entries are only found
+/// when building the index tables, see stardict_dict_load_tables().
+static gboolean
+load_syn (StardictDict *sd, const gchar *filename, GError **error)
+{
+	GMappedFile *mf = g_mapped_file_new (filename, FALSE, error);
+	if (!mf)
+		return FALSE;
 
-	if (err != NULL)
+	GBytes *data = g_mapped_file_get_bytes (mf);
+	g_mapped_file_unref (mf);
+	if (g_bytes_get_size (data) > G_MAXUINT32)
 	{
-		g_free (word);
-		g_propagate_error (error, err);
+		g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_INVALID_DATA,
+			"%s: %s", filename, _("synonyms file is too large"));
+		g_bytes_unref (data);
+		return FALSE;
 	}
-	else
-		ret_val = TRUE;
 
-	g_object_unref (dis);
-	g_object_unref (fis);
-cannot_open:
-	g_object_unref (file);
-	return ret_val;
+	sd->priv->syn_data = data;
+	sd->priv->syn = g_bytes_get_data (data, NULL);
+	return TRUE;
 }
 
 /// Load StarDict dictionary data.
@@ -631,33 +790,29 @@ load_dict (StardictDict *sd, const gchar *filename, gboolean gzipped,
 
 	if (gzipped)
 	{
-		gboolean ret_val = FALSE;
-		GFile *file = g_file_new_for_path (filename);
-		GFileInputStream *fis = g_file_read (file, NULL, error);
-
-		if (!fis)
-			goto cannot_open;
-
 	// As a simple workaround for GLib < 2.33.1 and the lack of support for
 	// the GSeekable interface in GDataInputStream, disable dictzip.
 	//
 	// http://lists.gnu.org/archive/html/qemu-devel/2013-06/msg04690.html
 	if (!glib_check_version (2, 33, 1))
 	{
-		// Try opening it as a dictzip file first
+		// Try opening it as a dictzip file first, through a memory map
 		DictzipInputStream *dzis =
-			dictzip_input_stream_new (G_INPUT_STREAM (fis), NULL);
+			dictzip_input_stream_new_for_path (filename, NULL);
 		if (dzis)
 		{
 			priv->dict_stream = G_INPUT_STREAM (dzis);
-			ret_val = TRUE;
-			goto done;
+			return TRUE;
 		}
+	}
 
 		// If unsuccessful, just read it all, as it is, into memory
-		if (!g_seekable_seek (G_SEEKABLE (fis), 0, G_SEEK_SET, NULL, error))
-			goto done;
-	}
+		gboolean ret_val = FALSE;
+		GFile *file = g_file_new_for_path (filename);
+		GFileInputStream *fis = g_file_read (file, NULL, error);
+
+		if (!fis)
+			goto cannot_open;
 
 		GByteArray *ba = g_byte_array_new ();
 		GZlibDecompressor *zd
@@ -678,7 +833,6 @@ load_dict (StardictDict *sd, const gchar *filename, gboolean gzipped,
 		else
 			g_byte_array_free (ba, TRUE);
 
-done:
 		g_object_unref (fis);
 cannot_open:
 		g_object_unref (file);
@@ -698,13 +852,12 @@ cannot_open:
 
 /// Compare the two strings by collation rules.
 static inline gint
-stardict_dict_strcoll (gconstpointer s1, gconstpointer s2, gpointer data)
+collator_strcoll (const UCollator *collator, const gchar *s1, const gchar *s2)
 {
-	StardictDict *sd = data;
 	UErrorCode error = U_ZERO_ERROR;
 
 #if U_ICU_VERSION_MAJOR_NUM >= 50
-	return ucol_strcollUTF8 (sd->priv->collator, s1, -1, s2, -1, &error);
+	return ucol_strcollUTF8 (collator, s1, -1, s2, -1, &error);
 #else  // U_ICU_VERSION_MAJOR_NUM >= 50
 	// This remarkably retarded API absolutely reeks of corporate;
 	// I don't have to tell you that this code runs slow, do I?
@@ -724,16 +877,34 @@ stardict_dict_strcoll (gconstpointer s1, gconstpointer s2, gpointer data)
 	error = U_ZERO_ERROR;
 	u_strFromUTF8WithSub (uc2, uc2_len, NULL, s2, -1, 0xFFFD, NULL, &error);
 
-	return ucol_strcoll (sd->priv->collator, uc1, uc1_len, uc2, uc2_len);
+	return ucol_strcoll (collator, uc1, uc1_len, uc2, uc2_len);
 #endif  // U_ICU_VERSION_MAJOR_NUM >= 50
 }
 
+/// Compare the two strings by collation rules of the dictionary.
+static inline gint
+stardict_dict_strcoll (gconstpointer s1, gconstpointer s2, gpointer data)
+{
+	StardictDict *sd = data;
+	return collator_strcoll (sd->priv->collator, s1, s2);
+}
+
+/// Context for the sorting comparators, each thread needs its own collator.
+typedef struct sort_ctx                 SortCtx;
+
+struct sort_ctx
+{
+	UCollator     * collator;           ///< Collator to use
+	const gchar   * data;               ///< Contents of the file being sorted
+	const guint32 * offsets;            ///< Entry offsets within @a data
+};
+
 /// Stricter stardict_dict_strcoll() used to sort the collated index.
 static inline gint
 stardict_dict_strcoll_for_sorting
-	(gconstpointer s1, gconstpointer s2, gpointer data)
+	(const gchar *s1, const gchar *s2, const SortCtx *ctx)
 {
-	UCollationResult a = stardict_dict_strcoll (s1, s2, data);
+	UCollationResult a = collator_strcoll (ctx->collator, s1, s2);
 	return a ? a : strcmp (s1, s2);
 }
 
@@ -741,348 +912,2780 @@ static inline gint
 stardict_dict_index_coll_for_sorting
 	(gconstpointer x1, gconstpointer x2, gpointer data)
 {
-	const StardictIndexEntry *e1 = x1, *e2 = x2;
-	return stardict_dict_strcoll_for_sorting (e1->name, e2->name, data);
+	const SortCtx *ctx = data;
+	const gchar *s1 = ctx->data + ctx->offsets[*(guint32 *) x1];
+	const gchar *s2 = ctx->data + ctx->offsets[*(guint32 *) x2];
+	return stardict_dict_strcoll_for_sorting (s1, s2, ctx);
 }
 
 static inline gint
 stardict_dict_synonyms_coll_for_sorting
 	(gconstpointer x1, gconstpointer x2, gpointer data)
 {
-	StardictDict *sd = data;
-	const gchar *s1 = g_array_index
-		(sd->priv->index, StardictSynonymEntry, *(guint32 *) x1).word;
-	const gchar *s2 = g_array_index
-		(sd->priv->index, StardictSynonymEntry, *(guint32 *) x2).word;
-	return stardict_dict_strcoll_for_sorting (s1, s2, data);
+	const SortCtx *ctx = data;
+	const gchar *s1 = ctx->data + *(guint32 *) x1;
+	const gchar *s2 = ctx->data + *(guint32 *) x2;
+	return stardict_dict_strcoll_for_sorting (s1, s2, ctx);
 }
 
-static gboolean
-stardict_dict_set_collation (StardictDict *sd, const gchar *collation)
-{
-	StardictDictPrivate *priv = sd->priv;
-	UErrorCode error = U_ZERO_ERROR;
-	if (!(priv->collator = ucol_open (collation, &error)))
-	{
-		// TODO: set a meaningful error
-		g_info ("failed to create a collator for `%s'", collation);
-		return FALSE;
-	}
-
-	// TODO: if error != U_ZERO_ERROR, report a meaningful message
-
-	// Reorder the index according to the ICU locale
-	ucol_setAttribute (priv->collator, UCOL_CASE_FIRST, UCOL_OFF, &error);
-	g_array_sort_with_data (sd->priv->index,
-		stardict_dict_index_coll_for_sorting, sd);
-
-	// Construct a reverse index from the original index as it's used less
-	guint32 *reverse = g_malloc_n (priv->index->len, sizeof *reverse);
-	for (guint32 i = 0; i < priv->index->len; i++)
-		reverse[g_array_index (priv->index,
-			StardictIndexEntry, i).reverse_index] = i;
-	for (guint32 i = 0; i < priv->index->len; i++)
-		g_array_index (priv->index,
-			StardictIndexEntry, i).reverse_index = reverse[i];
-	g_free (reverse);
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-	priv->collated_synonyms = g_array_sized_new (FALSE, FALSE,
-		sizeof (guint32), priv->synonyms->len);
-	for (guint32 i = 0; i < priv->synonyms->len; i++)
-		g_array_append_val (priv->collated_synonyms, i);
-	g_array_sort_with_data (sd->priv->collated_synonyms,
-		stardict_dict_synonyms_coll_for_sorting, sd);
+// Collation is expensive, so large arrays are sorted in contiguous runs
+// by several threads, which are then merged pairwise, also in parallel.
 
-	// Make the collator something like case-insensitive, see:
-	// http://userguide.icu-project.org/collation/concepts
-	// We shouldn't need to sort the data anymore, and if we did, we could just
-	// reset the strength to its default value for the given locale.
-	ucol_setStrength (priv->collator, UCOL_SECONDARY);
-	return TRUE;
-}
+/// Elements per thread below which it makes no sense to parallelize
+#define PARALLEL_SORT_MIN_RUN  8192
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+typedef struct sort_run                 SortRun;
 
-/// Load a StarDict dictionary.
-/// @param[in] sdi  Parsed .ifo data.  The dictionary assumes ownership.
-StardictDict *
-stardict_dict_new_from_info (StardictInfo *sdi, GError **error)
+/// A unit of work for a sorting thread: either sort @a left elements
+/// at @a data in place, or merge them with the @a right elements following
+/// them into @a out, if that is set.
+struct sort_run
 {
-	g_return_val_if_fail (sdi != NULL, NULL);
-
-	StardictDict *sd = g_object_new (STARDICT_TYPE_DICT, NULL);
-	StardictDictPrivate *priv = sd->priv;
-	priv->info = sdi;
-	priv->index = g_array_new (FALSE, FALSE, sizeof (StardictIndexEntry));
-	priv->synonyms = g_array_new (FALSE, FALSE, sizeof (StardictSynonymEntry));
-	priv->string_allocator = g_string_chunk_new ((1 << 15));
-
-	const gchar *dot = strrchr (sdi->path, '.');
-	gchar *base = dot ? g_strndup (sdi->path, dot - sdi->path)
-		: g_strdup (sdi->path);
+	gchar         * data;               ///< Elements to process
+	gchar         * out;                ///< Merge output or NULL
+	gsize           left;               ///< Elements in the first run
+	gsize           right;              ///< Elements in the second run
+	gsize           size;               ///< Size of an element
+	GCompareDataFunc compare;           ///< Comparator
+	SortCtx         ctx;                ///< Comparator context
+};
 
-	gchar *base_idx = g_strconcat (base, ".idx", NULL);
-	gboolean ret = FALSE;
-	if (g_file_test (base_idx, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
-		ret = load_idx (sd, base_idx, FALSE, error);
-	else
+static gpointer
+sort_run_worker (gpointer data)
+{
+	SortRun *run = data;
+	if (!run->out)
 	{
-		gchar *base_idx_gz = g_strconcat (base_idx, ".gz", NULL);
-		g_free (base_idx);
-		base_idx = base_idx_gz;
+		g_qsort_with_data (run->data, run->left, run->size,
+			run->compare, &run->ctx);
+		return NULL;
+	}
 
-		if (g_file_test (base_idx, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
-			ret = load_idx (sd, base_idx, TRUE, error);
+	const gchar *a = run->data, *a_end = a + run->left * run->size;
+	const gchar *b = a_end, *b_end = b + run->right * run->size;
+	gchar *out = run->out;
+	while (a < a_end && b < b_end)
+	{
+		// Taking from the left run on ties keeps the sort stable
+		if (run->compare (b, a, &run->ctx) < 0)
+		{
+			memcpy (out, b, run->size);
+			b += run->size;
+		}
 		else
 		{
-			g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND,
-				"%s: %s", sdi->path, _("cannot find .idx file"));
+			memcpy (out, a, run->size);
+			a += run->size;
 		}
+		out += run->size;
 	}
-	g_free (base_idx);
+	memcpy (out, a, a_end - a);
+	memcpy (out + (a_end - a), b, b_end - b);
+	return NULL;
+}
 
-	if (!ret)
-		goto error;
+static UCollator *
+clone_collator (const UCollator *collator)
+{
+	UErrorCode error = U_ZERO_ERROR;
+#if U_ICU_VERSION_MAJOR_NUM >= 71
+	UCollator *clone = ucol_clone (collator, &error);
+#else  // U_ICU_VERSION_MAJOR_NUM >= 71
+	// Any insufficient buffer size makes it allocate memory on its own
+	int32_t buffer_size = 1;
+	UCollator *clone = ucol_safeClone (collator, NULL, &buffer_size, &error);
+#endif  // U_ICU_VERSION_MAJOR_NUM >= 71
+	if (U_FAILURE (error) && clone)
+	{
+		ucol_close (clone);
+		return NULL;
+	}
+	return clone;
+}
 
-	gchar *base_dict = g_strconcat (base, ".dict", NULL);
-	ret = FALSE;
-	if (g_file_test (base_dict, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
-		ret = load_dict (sd, base_dict, FALSE, error);
-	else
+/// Stable-sort an array using as many threads as seems reasonable, each with
+/// its own clone of the collator, into which the comparator gets a SortCtx.
+static void
+parallel_sort (gpointer base, gsize n, gsize size, GCompareDataFunc compare,
+	const SortCtx *ctx)
+{
+	guint threads = MIN (g_get_num_processors (), n / PARALLEL_SORT_MIN_RUN);
+	UCollator **collators = g_new0 (UCollator *, threads + 1);
+	guint cloned = 0;
+	if (threads >= 2)
+		while (cloned < threads
+			&& (collators[cloned] = clone_collator (ctx->collator)))
+			cloned++;
+
+	if (threads < 2 || cloned < threads)
 	{
-		gchar *base_dict_dz = g_strconcat (base_dict, ".dz", NULL);
-		g_free (base_dict);
-		base_dict = base_dict_dz;
+		g_qsort_with_data (base, n, size, compare, (gpointer) ctx);
+		goto out;
+	}
 
-		if (g_file_test (base_dict, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
-			ret = load_dict (sd, base_dict, TRUE, error);
-		else
+	gsize *bounds = g_new (gsize, threads + 1);
+	for (guint i = 0; i <= threads; i++)
+		bounds[i] = n * i / threads;
+
+	SortRun *runs = g_new0 (SortRun, threads);
+	GThread **workers = g_new (GThread *, threads);
+	for (guint i = 0; i < threads; i++)
+	{
+		runs[i] = (SortRun)
 		{
-			g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND,
-				"%s: %s", sdi->path, _("cannot find .dict file"));
-		}
+			.data = (gchar *) base + bounds[i] * size,
+			.left = bounds[i + 1] - bounds[i],
+			.size = size,
+			.compare = compare,
+			.ctx = *ctx,
+		};
+		runs[i].ctx.collator = collators[i];
+		workers[i] = g_thread_new ("sort", sort_run_worker, &runs[i]);
 	}
-	g_free (base_dict);
+	for (guint i = 0; i < threads; i++)
+		g_thread_join (workers[i]);
 
-	if (!ret)
-		goto error;
-
-	gchar *base_syn = g_strconcat (base, ".syn", NULL);
-	if (g_file_test (base_syn, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
-		(void) load_syn (sd, base_syn, NULL);
-	g_free (base_syn);
+	gchar *src = base, *dst = g_malloc_n (n, size);
+	for (guint width = 1; width < threads; width *= 2)
+	{
+		guint count = 0;
+		for (guint i = 0; i < threads; i += 2 * width)
+		{
+			gsize lo = bounds[i],
+				mid = bounds[MIN (i + width, threads)],
+				hi = bounds[MIN (i + 2 * width, threads)];
+			runs[count] = (SortRun)
+			{
+				.data = src + lo * size,
+				.out = dst + lo * size,
+				.left = mid - lo,
+				.right = hi - mid,
+				.size = size,
+				.compare = compare,
+				.ctx = *ctx,
+			};
+			runs[count].ctx.collator = collators[count];
+			workers[count] = g_thread_new ("sort",
+				sort_run_worker, &runs[count]);
+			count++;
+		}
+		for (guint i = 0; i < count; i++)
+			g_thread_join (workers[i]);
 
-	// We need a fallback collator to find common prefixes
-	if (!sdi->collation || !stardict_dict_set_collation (sd, sdi->collation))
+		gchar *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	if (src != base)
 	{
-		UErrorCode error = U_ZERO_ERROR;
-		sd->priv->collator_root = ucol_open ("" /* root collator */, &error);
+		memcpy (base, src, n * size);
+		dst = src;
 	}
+	g_free (dst);
+
+	g_free (workers);
+	g_free (runs);
+	g_free (bounds);
+out:
+	for (guint i = 0; i < cloned; i++)
+		ucol_close (collators[i]);
+	g_free (collators);
+}
 
-	g_free (base);
-	return sd;
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-error:
-	g_free (base);
-	priv->info = NULL;
-	g_object_unref (sd);
-	return NULL;
-}
+// ICU sort keys turn each comparison during lookups into a mere strcmp().
+// They are stored as an array of offsets for the collated index, followed by
+// the collated synonyms and the total length, and then the keys themselves.
 
-static gint
-stardict_dict_cmp_synonym (StardictDict *sd, const gchar *word, gint i)
+/// Compute the sort key of a UTF-8 string and append it to @a out.
+static void
+sort_key_append (GByteArray *out, GArray *scratch,
+	const UCollator *collator, const gchar *s)
 {
-	GArray *collated = sd->priv->collated_synonyms;
-	GArray *synonyms = sd->priv->synonyms;
-
-	if (sd->priv->collator)
-		return stardict_dict_strcoll (word,
-			g_array_index (synonyms, StardictSynonymEntry,
-				g_array_index (collated, guint32, i)).word, sd);
-	return g_ascii_strcasecmp (word,
-		g_array_index (synonyms, StardictSynonymEntry, i).word);
+	UErrorCode error = U_ZERO_ERROR;
+	int32_t uc_len = 0;
+	u_strFromUTF8WithSub (NULL, 0, &uc_len, s, -1, 0xFFFD, NULL, &error);
+	g_array_set_size (scratch, uc_len);
+	error = U_ZERO_ERROR;
+	u_strFromUTF8WithSub ((UChar *) scratch->data, uc_len, NULL,
+		s, -1, 0xFFFD, NULL, &error);
+
+	// The returned length includes the terminating NUL, and it is zero
+	// on failure, in which case we just provide an empty key
+	static const int32_t guess = 64;
+	guint start = out->len;
+	g_byte_array_set_size (out, start + guess);
+	int32_t key_len = ucol_getSortKey (collator,
+		(const UChar *) scratch->data, uc_len, out->data + start, guess);
+	if (key_len > guess)
+	{
+		g_byte_array_set_size (out, start + key_len);
+		key_len = ucol_getSortKey (collator,
+			(const UChar *) scratch->data, uc_len, out->data + start, key_len);
+	}
+	if (key_len <= 0)
+	{
+		out->data[start] = 0;
+		key_len = 1;
+	}
+	g_byte_array_set_size (out, start + key_len);
 }
 
-/// Return words of which the argument is a synonym or NULL
-/// if there are no such words.
-gchar **
-stardict_dict_get_synonyms (StardictDict *sd, const gchar *word)
+/// Return the sort key for a word to be looked up, or NULL if there are
+/// no sort keys to compare it against.
+static GByteArray *
+stardict_dict_make_lookup_key (StardictDict *sd, const gchar *word)
 {
-	GArray *collated = sd->priv->collated_synonyms;
-	GArray *synonyms = sd->priv->synonyms;
-	GArray *index = sd->priv->index;
+	if (!sd->priv->sort_key_offsets)
+		return NULL;
 
-	BINARY_SEARCH_BEGIN (synonyms->len - 1,
-		stardict_dict_cmp_synonym (sd, word, imid))
+	GByteArray *key = g_byte_array_new ();
+	GArray *scratch = g_array_new (FALSE, FALSE, sizeof (UChar));
+	sort_key_append (key, scratch, sd->priv->collator, word);
+	g_array_free (scratch, TRUE);
+	return key;
+}
+
+/// Compute sort keys for entries at offsets @a words within @a data.
+static void
+sort_keys_append (GArray *offsets, GByteArray *keys, const UCollator *collator,
+	const gchar *data, const guint32 *words, guint32 n)
+{
+	GArray *scratch = g_array_new (FALSE, FALSE, sizeof (UChar));
+	for (guint32 i = 0; i < n; i++)
+	{
+		g_array_append_val (offsets, keys->len);
+		sort_key_append (keys, scratch, collator, data + words[i]);
+	}
+	g_array_free (scratch, TRUE);
+}
+
+static inline const gchar *
+stardict_dict_index_sort_key (StardictDict *sd, guint32 i)
+{
+	StardictDictPrivate *priv = sd->priv;
+	return priv->sort_key_data + priv->sort_key_offsets[i];
+}
+
+static inline const gchar *
+stardict_dict_synonym_sort_key (StardictDict *sd, guint32 i)
+{
+	StardictDictPrivate *priv = sd->priv;
+	return priv->sort_key_data + priv->sort_key_offsets[priv->index_length + i];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Finding entries in large indexes, and sorting them by ICU collation rules
+// in particular, takes a considerable amount of time and memory, so we store
+// the resulting tables in a file next to the index, and map it into memory,
+// so that they can be shared by all processes using the dictionary.
+// The tables only contain offsets into the index and synonyms, which are
+// mapped as well.  The file uses native byte order, and any kind of mismatch
+// simply invalidates it.
+
+#define COLLATION_CACHE_SUFFIX   ".coll"
+#define COLLATION_CACHE_MAGIC    "TDVCOLL"
+#define COLLATION_CACHE_VERSION  3
+
+typedef struct collation_cache_header   CollationCacheHeader;
+
+/// The fixed part of a collation cache file.  It is followed by the collation
+/// name padded to four bytes, then the index, the reverse map, and synonyms,
+/// all as arrays of guint32, and finally by sort keys in the format that
+/// stardict_dict uses.  Dictionaries that aren't collated have no name,
+/// and their files lack both the reverse map and sort keys.
+struct collation_cache_header
+{
+	gchar           magic[8];           ///< COLLATION_CACHE_MAGIC
+	guint32         version;            ///< COLLATION_CACHE_VERSION
+	guint32         collation_length;   ///< Size of the name with its NUL or 0
+	guint8          icu_version[4];     ///< ICU library version or 0
+	guint8          ucol_version[4];    ///< Version of the collator or 0
+
+	guint64         idx_size;           ///< Size of the index file
+	gint64          idx_mtime;          ///< Last modification of the index
+	guint64         syn_size;           ///< Size of the synonyms file or 0
+	gint64          syn_mtime;          ///< Last modification of synonyms or 0
+
+	// These fields aren't known before the cache has been loaded
+	guint32         index_length;       ///< Number of index entries
+	guint32         synonyms_length;    ///< Number of synonyms
+	guint64         keys_length;        ///< Length of all sort keys
+};
+
+static gsize
+collation_cache_data_offset (const CollationCacheHeader *header)
+{
+	return sizeof *header + ((header->collation_length + 3) & ~3);
+}
+
+static guint64
+collation_cache_length (const CollationCacheHeader *header)
+{
+	guint64 n = header->index_length, m = header->synonyms_length;
+	guint64 cells = n + m;
+	if (header->collation_length)
+		cells += n + (n + m + 1);
+	return collation_cache_data_offset (header)
+		+ cells * sizeof (guint32) + header->keys_length;
+}
+
+/// Describe the files that the index tables are derived from.
+static gboolean
+collation_cache_header_init (CollationCacheHeader *header, StardictDict *sd,
+	const gchar *collation, const gchar *idx_path, const gchar *syn_path)
+{
+	StardictDictPrivate *priv = sd->priv;
+	memset (header, 0, sizeof *header);
+	memcpy (header->magic, COLLATION_CACHE_MAGIC, sizeof header->magic);
+	header->version = COLLATION_CACHE_VERSION;
+	if (priv->collator)
+	{
+		header->collation_length = strlen (collation) + 1;
+		u_getVersion (header->icu_version);
+		ucol_getVersion (priv->collator, header->ucol_version);
+	}
+
+	GStatBuf sb;
+	if (g_stat (idx_path, &sb))
+		return FALSE;
+	header->idx_size = sb.st_size;
+	header->idx_mtime = sb.st_mtime;
+
+	if (syn_path)
+	{
+		if (g_stat (syn_path, &sb))
+			return FALSE;
+		header->syn_size = sb.st_size;
+		header->syn_mtime = sb.st_mtime;
+	}
+	return TRUE;
+}
+
+typedef struct collation_identity       CollationIdentity;
+
+/// Identifies the order of a collated index, for files derived from it
+struct collation_identity
+{
+	gchar           name[60];           ///< Collation name, maybe truncated
+	guint32         name_hash;          ///< g_str_hash() of the whole name
+	guint8          icu_version[4];     ///< ICU library version or 0
+	guint8          ucol_version[4];    ///< Version of the collator or 0
+};
+
+/// Describe how the index is ordered, all zeros when it isn't collated.
+static void
+collation_identity_init (CollationIdentity *identity, StardictDict *sd)
+{
+	StardictDictPrivate *priv = sd->priv;
+	memset (identity, 0, sizeof *identity);
+	if (!priv->collator)
+		return;
+
+	g_strlcpy (identity->name, priv->info->collation, sizeof identity->name);
+	identity->name_hash = g_str_hash (priv->info->collation);
+	u_getVersion (identity->icu_version);
+	ucol_getVersion (priv->collator, identity->ucol_version);
+}
+
+/// Pack the first bytes of a word, folded to lowercase, into an integer
+/// that compares the same way as the word does with g_ascii_strcasecmp().
+static guint64
+search_prefix (const gchar *word)
+{
+	guint64 prefix = 0;
+	for (gsize i = 0; i < sizeof prefix; i++)
+	{
+		prefix <<= 8;
+		if (*word)
+			prefix |= (guchar) g_ascii_tolower (*word++);
+	}
+	return prefix;
+}
+
+/// Fill in the Eytzinger layout of the subtree rooted at @a k with entries
+/// from the index position @a i on.  Returns the position following them.
+static guint32
+search_prefixes_fill (StardictDict *sd, gsize k, guint32 i)
+{
+	StardictDictPrivate *priv = sd->priv;
+	if (k > priv->index_length)
+		return i;
+
+	i = search_prefixes_fill (sd, 2 * k, i);
+	priv->search_prefixes[k] = search_prefix (stardict_dict_index_word (sd, i));
+	priv->search_positions[k] = i++;
+	return search_prefixes_fill (sd, 2 * k + 1, i);
+}
+
+/// Point the dictionary to tables in the collation cache format,
+/// assuming they have already been validated.  Takes ownership of @a tables.
+static void
+stardict_dict_set_tables (StardictDict *sd, GBytes *tables)
+{
+	StardictDictPrivate *priv = sd->priv;
+	if (priv->tables)
+		g_bytes_unref (priv->tables);
+	g_free (priv->search_prefixes);
+	g_free (priv->search_positions);
+	priv->search_prefixes = NULL;
+	priv->search_positions = NULL;
+
+	priv->tables = tables;
+	priv->index_words = priv->index_reverse = priv->synonym_words = NULL;
+	priv->index_length = priv->synonyms_length = 0;
+	priv->sort_key_offsets = NULL;
+	priv->sort_key_data = NULL;
+	if (!tables)
+		return;
+
+	const gchar *data = g_bytes_get_data (tables, NULL);
+	const CollationCacheHeader *header = (const CollationCacheHeader *) data;
+	const guint32 *p =
+		(const guint32 *) (data + collation_cache_data_offset (header));
+
+	guint32 n = priv->index_length = header->index_length;
+	guint32 m = priv->synonyms_length = header->synonyms_length;
+	priv->index_words = p;
+	p += n;
+	if (header->collation_length)
+	{
+		priv->index_reverse = p;
+		p += n;
+	}
+	priv->synonym_words = p;
+	p += m;
+	if (header->collation_length)
+	{
+		priv->sort_key_offsets = p;
+		priv->sort_key_data = (const gchar *) (p + n + m + 1);
+	}
+	else
+	{
+		priv->search_prefixes = g_new (guint64, (gsize) n + 1);
+		priv->search_positions = g_new (guint32, (gsize) n + 1);
+		(void) search_prefixes_fill (sd, 1, 0);
+	}
+}
+
+/// Find the starts of all entries in @a data, each of which is
+/// a NUL-terminated word followed by @a tail bytes.
+/// @return FALSE if the last entry is truncated
+static gboolean
+scan_entries (GArray *out, const gchar *data, gsize length, gsize tail)
+{
+	const gchar *p = data, *end = data + length;
+	while (p < end)
+	{
+		const gchar *nul = memchr (p, '\0', end - p);
+		if (!nul || (gsize) (end - nul - 1) < tail)
+			return FALSE;
+
+		guint32 offset = p - data;
+		g_array_append_val (out, offset);
+		p = nul + 1 + tail;
+	}
+	return TRUE;
+}
+
+/// Check that all entries at @a offsets lie within @a data.
+static gboolean
+entries_are_valid (const guint32 *offsets, guint32 n,
+	const gchar *data, gsize length, gsize tail)
+{
+	for (guint32 i = 0; i < n; i++)
+	{
+		if (offsets[i] >= length)
+			return FALSE;
+
+		const gchar *nul =
+			memchr (data + offsets[i], '\0', length - offsets[i]);
+		if (!nul || (gsize) (data + length - nul - 1) < tail)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/// Check that each of @a n sort keys ends within the data and with a NUL.
+static gboolean
+sort_keys_are_valid (const guint32 *offsets, guint32 n,
+	const gchar *data, guint64 length)
+{
+	if (offsets[0] || offsets[n] != length)
+		return FALSE;
+	for (guint32 i = 0; i < n; i++)
+		if (offsets[i] >= offsets[i + 1] || offsets[i + 1] > length
+		 || data[offsets[i + 1] - 1])
+			return FALSE;
+	return TRUE;
+}
+
+/// Map index tables from a collation cache file.
+static gboolean
+collation_cache_load (StardictDict *sd, const gchar *path,
+	const gchar *collation, const CollationCacheHeader *expected)
+{
+	StardictDictPrivate *priv = sd->priv;
+	GMappedFile *mf = g_mapped_file_new (path, FALSE, NULL);
+	if (!mf)
+		return FALSE;
+
+	gboolean ret_val = FALSE;
+	const gchar *data = g_mapped_file_get_contents (mf);
+	gsize length = g_mapped_file_get_length (mf);
+	const CollationCacheHeader *header = (const CollationCacheHeader *) data;
+	if (length < sizeof *header
+	 || memcmp (header, expected, offsetof (CollationCacheHeader, index_length))
+	 || length != collation_cache_length (header)
+	 || memcmp (data + sizeof *header, collation, header->collation_length))
+		goto out;
+
+	// Make sure that no offset leads outside of the files, so that the worst
+	// thing a corrupted cache can cause is a misordered index
+	guint32 n = header->index_length, m = header->synonyms_length;
+	const guint32 *words =
+		(const guint32 *) (data + collation_cache_data_offset (header));
+	const guint32 *reverse = header->collation_length ? words + n : NULL;
+	const guint32 *synonyms = (reverse ? reverse : words) + n;
+	gsize entry_tail = priv->info->idx_offset_bits / 8 + sizeof (guint32);
+	if (!entries_are_valid (words, n,
+			priv->idx, g_bytes_get_size (priv->idx_data), entry_tail)
+	 || !entries_are_valid (synonyms, m, priv->syn,
+			priv->syn_data ? g_bytes_get_size (priv->syn_data) : 0,
+			sizeof (guint32)))
+		goto out;
+	if (!reverse)
+		goto valid;
+
+	// The reverse map has to be a permutation, so it must list the entries
+	// in the order of the original index
+	for (guint32 i = 0; i < n; i++)
+		if (reverse[i] >= n
+		 || (i && words[reverse[i]] <= words[reverse[i - 1]]))
+			goto out;
+
+	const guint32 *key_offsets = synonyms + m;
+	if (!sort_keys_are_valid (key_offsets, n + m,
+		(const gchar *) (key_offsets + n + m + 1), header->keys_length))
+		goto out;
+
+valid:
+	// The tables can stay where they are, and be paged in as needed
+	stardict_dict_set_tables (sd, g_mapped_file_get_bytes (mf));
+	ret_val = TRUE;
+
+out:
+	g_mapped_file_unref (mf);
+	return ret_val;
+}
+
+/// Build index tables in the collation cache format.
+static GBytes *
+collation_cache_build (StardictDict *sd, const gchar *idx_path,
+	const gchar *collation, const CollationCacheHeader *expected,
+	GError **error)
+{
+	StardictDictPrivate *priv = sd->priv;
+	gsize idx_length = g_bytes_get_size (priv->idx_data);
+
+	// Don't trust "wordcount" more than what the file can possibly contain
+	gsize entry_tail = priv->info->idx_offset_bits / 8 + sizeof (guint32);
+	GArray *words = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+		MIN (priv->info->word_count, idx_length / (entry_tail + 1)));
+
+	// Ignoring "wordcount", just reading as long as we can
+	if (!scan_entries (words, priv->idx, idx_length, entry_tail))
+	{
+		g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_INVALID_DATA,
+			"%s: %s", idx_path, _("unexpected end of file"));
+		g_array_free (words, TRUE);
+		return NULL;
+	}
+
+	// Likewise, and synonyms that can't be read are simply ignored
+	gsize syn_length = priv->syn_data ? g_bytes_get_size (priv->syn_data) : 0;
+	GArray *synonyms = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+		MIN (priv->info->syn_word_count, syn_length / (sizeof (guint32) + 1)));
+	if (priv->syn)
+		(void) scan_entries (synonyms,
+			priv->syn, syn_length, sizeof (guint32));
+
+	CollationCacheHeader header = *expected;
+	guint32 n = header.index_length = words->len;
+	guint32 m = header.synonyms_length = synonyms->len;
+
+	guint32 *reverse = NULL;
+	GArray *key_offsets = NULL;
+	GByteArray *keys = NULL;
+	if (priv->collator)
+	{
+		SortCtx ctx = { .collator = priv->collator,
+			.data = priv->idx, .offsets = (const guint32 *) words->data };
+
+		guint32 *order = g_malloc_n (n, sizeof *order);
+		for (guint32 i = 0; i < n; i++)
+			order[i] = i;
+		parallel_sort (order, n, sizeof *order,
+			stardict_dict_index_coll_for_sorting, &ctx);
+
+		// Reorder the index by the permutation of its original positions
+		guint32 *sorted = g_malloc_n (n, sizeof *sorted);
+		reverse = g_malloc_n (n, sizeof *reverse);
+		for (guint32 i = 0; i < n; i++)
+		{
+			sorted[i] = g_array_index (words, guint32, order[i]);
+			reverse[order[i]] = i;
+		}
+		memcpy (words->data, sorted, n * sizeof *sorted);
+		g_free (sorted);
+		g_free (order);
+
+		ctx.data = priv->syn;
+		parallel_sort (synonyms->data, m, sizeof (guint32),
+			stardict_dict_synonyms_coll_for_sorting, &ctx);
+
+		// Sort keys have to be made with the same strength as used
+		// for searching, see stardict_dict_load_tables()
+		ucol_setStrength (priv->collator, UCOL_SECONDARY);
+
+		key_offsets = g_array_sized_new (FALSE, FALSE,
+			sizeof (guint32), n + m + 1);
+		keys = g_byte_array_new ();
+		sort_keys_append (key_offsets, keys, priv->collator,
+			priv->idx, (const guint32 *) words->data, n);
+		sort_keys_append (key_offsets, keys, priv->collator,
+			priv->syn, (const guint32 *) synonyms->data, m);
+		g_array_append_val (key_offsets, keys->len);
+		header.keys_length = keys->len;
+	}
+
+	gsize length = collation_cache_length (&header);
+	gchar *data = g_malloc0 (length);
+	memcpy (data, &header, sizeof header);
+	memcpy (data + sizeof header, collation, header.collation_length);
+
+	gchar *p = data + collation_cache_data_offset (&header);
+	memcpy (p, words->data, n * sizeof (guint32));
+	p += n * sizeof (guint32);
+	if (reverse)
+	{
+		memcpy (p, reverse, n * sizeof (guint32));
+		p += n * sizeof (guint32);
+	}
+	memcpy (p, synonyms->data, m * sizeof (guint32));
+	p += m * sizeof (guint32);
+	if (keys)
+	{
+		memcpy (p, key_offsets->data, key_offsets->len * sizeof (guint32));
+		p += key_offsets->len * sizeof (guint32);
+		memcpy (p, keys->data, keys->len);
+
+		g_array_free (key_offsets, TRUE);
+		g_byte_array_free (keys, TRUE);
+	}
+
+	g_free (reverse);
+	g_array_free (synonyms, TRUE);
+	g_array_free (words, TRUE);
+	return g_bytes_new_take (data, length);
+}
+
+/// Store index tables in a collation cache file.
+static gboolean
+collation_cache_save (const gchar *path, GBytes *tables)
+{
+	gsize length = 0;
+	const gchar *data = g_bytes_get_data (tables, &length);
+
+	// The dictionary may easily be installed in a read-only location
+	GError *error = NULL;
+	if (g_file_set_contents (path, data, length, &error))
+		return TRUE;
+
+	g_debug ("%s: %s", path, error->message);
+	g_error_free (error);
+	return FALSE;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static gboolean
+stardict_dict_set_collation (StardictDict *sd, const gchar *collation)
+{
+	StardictDictPrivate *priv = sd->priv;
+	UErrorCode error = U_ZERO_ERROR;
+	if (!(priv->collator = ucol_open (collation, &error)))
+	{
+		// TODO: set a meaningful error
+		g_info ("failed to create a collator for `%s'", collation);
+		return FALSE;
+	}
+
+	// TODO: if error != U_ZERO_ERROR, report a meaningful message
+
+	// The index is going to be reordered according to the ICU locale
+	ucol_setAttribute (priv->collator, UCOL_CASE_FIRST, UCOL_OFF, &error);
+	return TRUE;
+}
+
+/// Find all entries of the index and synonyms, and order them according
+/// to the collator, unless we've already done so and the result is still
+/// available in the collation cache.
+static gboolean
+stardict_dict_load_tables (StardictDict *sd,
+	const gchar *idx_path, const gchar *syn_path, GError **error)
+{
+	StardictDictPrivate *priv = sd->priv;
+	const gchar *collation = priv->collator ? priv->info->collation : "";
+
+	gboolean ok = TRUE;
+	CollationCacheHeader header;
+	gchar *cache_path = g_strconcat (idx_path, COLLATION_CACHE_SUFFIX, NULL);
+	gboolean cacheable = collation_cache_header_init
+		(&header, sd, collation, idx_path, syn_path);
+	if (!cacheable
+	 || !collation_cache_load (sd, cache_path, collation, &header))
+	{
+		GBytes *tables =
+			collation_cache_build (sd, idx_path, collation, &header, error);
+
+		// Preferably, even the process that has built the tables shares them
+		if (!tables)
+			ok = FALSE;
+		else if (cacheable && collation_cache_save (cache_path, tables)
+		 && collation_cache_load (sd, cache_path, collation, &header))
+			g_bytes_unref (tables);
+		else
+			stardict_dict_set_tables (sd, tables);
+	}
+
+	// Make the collator something like case-insensitive, see:
+	// http://userguide.icu-project.org/collation/concepts
+	// We shouldn't need to sort the data anymore, and if we did, we could just
+	// reset the strength to its default value for the given locale.
+	if (priv->collator)
+		ucol_setStrength (priv->collator, UCOL_SECONDARY);
+
+	g_free (cache_path);
+	return ok;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/// Load all data of the dictionary, as described by its information.
+static gboolean
+stardict_dict_load_data (StardictDict *sd, GError **error)
+{
+	StardictDictPrivate *priv = sd->priv;
+	StardictInfo *sdi = priv->info;
+	gint64 idx_time = 0, dict_time = 0, syn_time = 0, collation_time = 0;
+
+	const gchar *dot = strrchr (sdi->path, '.');
+	gchar *base = dot ? g_strndup (sdi->path, dot - sdi->path)
+		: g_strdup (sdi->path);
+
+	gchar *base_idx = g_strconcat (base, ".idx", NULL);
+	gboolean ret = FALSE;
+	gint64 start = g_get_monotonic_time ();
+	if (g_file_test (base_idx, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
+		ret = load_idx (sd, base_idx, FALSE, error);
+	else
+	{
+		gchar *base_idx_gz = g_strconcat (base_idx, ".gz", NULL);
+		g_free (base_idx);
+		base_idx = base_idx_gz;
+
+		if (g_file_test (base_idx, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
+			ret = load_idx (sd, base_idx, TRUE, error);
+		else
+		{
+			g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND,
+				"%s: %s", sdi->path, _("cannot find .idx file"));
+		}
+	}
+
+	if (!ret)
+		goto error;
+
+	idx_time = g_get_monotonic_time () - start;
+	start = g_get_monotonic_time ();
+
+	gchar *base_dict = g_strconcat (base, ".dict", NULL);
+	ret = FALSE;
+	if (g_file_test (base_dict, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
+		ret = load_dict (sd, base_dict, FALSE, error);
+	else
+	{
+		gchar *base_dict_dz = g_strconcat (base_dict, ".dz", NULL);
+		g_free (base_dict);
+		base_dict = base_dict_dz;
+
+		if (g_file_test (base_dict, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
+			ret = load_dict (sd, base_dict, TRUE, error);
+		else
+		{
+			g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND,
+				"%s: %s", sdi->path, _("cannot find .dict file"));
+		}
+	}
+	g_free (base_dict);
+
+	if (!ret)
+		goto error;
+
+	dict_time = g_get_monotonic_time () - start;
+	start = g_get_monotonic_time ();
+
+	gchar *base_syn = g_strconcat (base, ".syn", NULL);
+	if (g_file_test (base_syn, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_REGULAR))
+		(void) load_syn (sd, base_syn, NULL);
+	else
+	{
+		g_free (base_syn);
+		base_syn = NULL;
+	}
+
+	syn_time = g_get_monotonic_time () - start;
+	start = g_get_monotonic_time ();
+
+	// Without a collator, the index stays in the order of stardict_strcmp()
+	if (sdi->collation)
+		(void) stardict_dict_set_collation (sd, sdi->collation);
+
+	ret = stardict_dict_load_tables (sd, base_idx, base_syn, error);
+	g_free (base_syn);
+	if (!ret)
+		goto error;
+
+	collation_time = g_get_monotonic_time () - start;
+
+	// Finding common prefixes needs a different strength than searching,
+	// and the collator mustn't be modified once it can be used concurrently
+	if (priv->collator
+	 && (priv->collator_primary = clone_collator (priv->collator)))
+		ucol_setStrength (priv->collator_primary, UCOL_PRIMARY);
+
+	priv->idx_path = base_idx;
+	g_free (base);
+
+	g_mutex_lock (&priv->stats_lock);
+	priv->stats.load_idx_time = idx_time;
+	priv->stats.load_dict_time = dict_time;
+	priv->stats.load_syn_time = syn_time;
+	priv->stats.load_collation_time = collation_time;
+	g_mutex_unlock (&priv->stats_lock);
+	return TRUE;
+
+error:
+	g_free (base_idx);
+	g_free (base);
+	stardict_dict_free_data (sd);
+	return FALSE;
+}
+
+/// Create a dictionary object without loading any of its data yet.
+/// They will be loaded once they are first needed, or by stardict_dict_load().
+/// @param[in] sdi  Parsed .ifo data.  The dictionary assumes ownership.
+StardictDict *
+stardict_dict_new_deferred (StardictInfo *sdi)
+{
+	g_return_val_if_fail (sdi != NULL, NULL);
+
+	StardictDict *sd = g_object_new (STARDICT_TYPE_DICT, NULL);
+	sd->priv->info = sdi;
+	return sd;
+}
+
+/// Load a StarDict dictionary.
+/// @param[in] sdi  Parsed .ifo data.  The dictionary assumes ownership.
+StardictDict *
+stardict_dict_new_from_info (StardictInfo *sdi, GError **error)
+{
+	g_return_val_if_fail (sdi != NULL, NULL);
+
+	StardictDict *sd = stardict_dict_new_deferred (sdi);
+	if (stardict_dict_load (sd, error))
+		return sd;
+
+	sd->priv->info = NULL;
+	g_object_unref (sd);
+	return NULL;
+}
+
+static gint
+monotonic_seconds (void)
+{
+	return g_get_monotonic_time () / G_USEC_PER_SEC;
+}
+
+/// Load the dictionary's data, unless they have already been loaded.
+/// Failures are remembered, and loading isn't attempted again.
+/// This may be called from multiple threads at once.
+gboolean
+stardict_dict_load (StardictDict *sd, GError **error)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), FALSE);
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->load_lock);
+	if (!g_atomic_int_get (&priv->loaded) && !priv->load_error
+	 && stardict_dict_load_data (sd, &priv->load_error))
+	{
+		g_atomic_int_set (&priv->last_used, monotonic_seconds ());
+		g_atomic_int_set (&priv->loaded, TRUE);
+	}
+
+	gboolean ok = !priv->load_error;
+	if (!ok)
+		g_propagate_error (error, g_error_copy (priv->load_error));
+	g_mutex_unlock (&priv->load_lock);
+	return ok;
+}
+
+/// Return whether the dictionary's data are currently loaded.
+gboolean
+stardict_dict_is_loaded (StardictDict *sd)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), FALSE);
+	return g_atomic_int_get (&sd->priv->loaded);
+}
+
+/// Release the dictionary's data, unless they're being used, such as through
+/// iterators or search sessions.  They will be loaded again when needed.
+/// @return Whether the data have been released
+gboolean
+stardict_dict_unload (StardictDict *sd)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), FALSE);
+
+	StardictDictPrivate *priv = sd->priv;
+	gboolean unloaded = FALSE;
+	g_mutex_lock (&priv->load_lock);
+	if (g_atomic_int_get (&priv->loaded))
+	{
+		// Users announce themselves before checking the flag, and we check
+		// for users after resetting it, so one of us will notice the other
+		g_atomic_int_set (&priv->loaded, FALSE);
+		if (g_atomic_int_get (&priv->users))
+			g_atomic_int_set (&priv->loaded, TRUE);
+		else
+		{
+			stardict_dict_free_data (sd);
+			unloaded = TRUE;
+		}
+	}
+	g_mutex_unlock (&priv->load_lock);
+	return unloaded;
+}
+
+/// Return the monotonic time of when the dictionary's data were last used.
+gint64
+stardict_dict_get_last_used (StardictDict *sd)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), 0);
+	return (gint64) g_atomic_int_get (&sd->priv->last_used) * G_USEC_PER_SEC;
+}
+
+/// Estimate the amount of memory taken by the dictionary's data,
+/// including mapped files.
+gsize
+stardict_dict_get_memory_size (StardictDict *sd)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), 0);
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->load_lock);
+	gsize size = 0;
+	if (priv->idx_data)
+		size += g_bytes_get_size (priv->idx_data);
+	if (priv->syn_data)
+		size += g_bytes_get_size (priv->syn_data);
+	if (priv->tables)
+		size += g_bytes_get_size (priv->tables);
+	if (priv->search_prefixes)
+		size += ((gsize) priv->index_length + 1)
+			* (sizeof *priv->search_prefixes + sizeof *priv->search_positions);
+	if (!priv->dict_stream)
+		size += priv->dict_length;
+
+	g_mutex_lock (&priv->fuzzy_lock);
+	if (priv->fuzzy)
+		size += fuzzy_index_size (priv->fuzzy);
+	g_mutex_unlock (&priv->fuzzy_lock);
+	g_mutex_lock (&priv->fulltext_lock);
+	if (priv->fulltext)
+		size += g_bytes_get_size (priv->fulltext);
+	g_mutex_unlock (&priv->fulltext_lock);
+	g_mutex_lock (&priv->entry_cache_lock);
+	size += priv->entry_cache_size;
+	g_mutex_unlock (&priv->entry_cache_lock);
+
+	g_mutex_unlock (&priv->load_lock);
+	return size;
+}
+
+/// Mark the dictionary's data as being used, loading them if necessary.
+/// Each call has to be paired with stardict_dict_release().
+/// @return FALSE if the data couldn't be loaded, the dictionary looks empty
+static gboolean
+stardict_dict_acquire (StardictDict *sd, GError **error)
+{
+	StardictDictPrivate *priv = sd->priv;
+	g_atomic_int_inc (&priv->users);
+	if G_LIKELY (g_atomic_int_get (&priv->loaded))
+		return TRUE;
+
+	GError *e = NULL;
+	if (stardict_dict_load (sd, &e))
+		return TRUE;
+
+	// Nobody would learn about the failure otherwise, but once is enough
+	if (error)
+		g_propagate_error (error, e);
+	else
+	{
+		if (g_atomic_int_compare_and_exchange (&priv->load_warned, 0, 1))
+			g_warning ("%s", e->message);
+		g_error_free (e);
+	}
+	return FALSE;
+}
+
+static void
+stardict_dict_release (StardictDict *sd)
+{
+	StardictDictPrivate *priv = sd->priv;
+	g_atomic_int_set (&priv->last_used, monotonic_seconds ());
+	(void) g_atomic_int_dec_and_test (&priv->users);
+}
+
+static gint
+stardict_dict_cmp_synonym (StardictDict *sd,
+	const gchar *word, const GByteArray *key, gint i)
+{
+	if (key)
+		return strcmp ((const gchar *) key->data,
+			stardict_dict_synonym_sort_key (sd, i));
+
+	const gchar *target = stardict_dict_synonym_word (sd, i);
+	if (sd->priv->collator)
+		return stardict_dict_strcoll (word, target, sd);
+	return g_ascii_strcasecmp (word, target);
+}
+
+static gchar **
+stardict_dict_get_synonyms_loaded (StardictDict *sd, const gchar *word)
+{
+	GByteArray *key = stardict_dict_make_lookup_key (sd, word);
+
+	BINARY_SEARCH_BEGIN ((gint) sd->priv->synonyms_length - 1,
+		stardict_dict_cmp_synonym (sd, word, key, imid))
+
+	// Back off to the first matching entry
+	while (imid > 0 && !stardict_dict_cmp_synonym (sd, word, key, imid - 1))
+		imid--;
+
+	GPtrArray *array = g_ptr_array_new ();
+
+	// And add all matching entries from that position on to the array
+	do
+	{
+		const gchar *synonym = stardict_dict_synonym_word (sd, imid);
+		guint32 i = read_be32 (synonym + strlen (synonym) + 1);
+
+		// When we use a collator, the index has been reordered
+		if (i >= sd->priv->index_length)
+			continue;
+		if (sd->priv->index_reverse)
+			i = sd->priv->index_reverse[i];
+
+		g_ptr_array_add (array, g_strdup (stardict_dict_index_word (sd, i)));
+	}
+	while ((guint) ++imid < sd->priv->synonyms_length
+		&& !stardict_dict_cmp_synonym (sd, word, key, imid));
+
+	if (key)
+		g_byte_array_free (key, TRUE);
+	g_ptr_array_add (array, NULL);
+	return (gchar **) g_ptr_array_free (array, FALSE);
+
+	BINARY_SEARCH_END
+
+	if (key)
+		g_byte_array_free (key, TRUE);
+	return NULL;
+}
+
+/// Return words of which the argument is a synonym or NULL
+/// if there are no such words.
+gchar **
+stardict_dict_get_synonyms (StardictDict *sd, const gchar *word)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), NULL);
+
+	gchar **words = NULL;
+	if (stardict_dict_acquire (sd, NULL))
+		words = stardict_dict_get_synonyms_loaded (sd, word);
+	stardict_dict_release (sd);
+	return words;
+}
+
+static gint
+stardict_dict_cmp_index (StardictDict *sd,
+	const gchar *word, const GByteArray *key, gint i)
+{
+	if (key)
+		return strcmp ((const gchar *) key->data,
+			stardict_dict_index_sort_key (sd, i));
+
+	const gchar *target = stardict_dict_index_word (sd, i);
+	if (sd->priv->collator)
+		return stardict_dict_strcoll (word, target, sd);
+	return g_ascii_strcasecmp (word, target);
+}
+
+/// Compare with an index entry, counting the comparisons in @a probes.
+static gint
+stardict_dict_probe_index (StardictDict *sd,
+	const gchar *word, const GByteArray *key, gint i, guint *probes)
+{
+	(*probes)++;
+	return stardict_dict_cmp_index (sd, word, key, i);
+}
+
+static size_t
+prefix (StardictDict *sd, const gchar *word, gint i, guint *probes)
+{
+	if ((guint) i >= sd->priv->index_length)
+		return 0;
+
+	(*probes)++;
+	return stardict_longest_common_collation_prefix
+		(sd, word, stardict_dict_index_word (sd, i));
+}
+
+/// Return the first index position with a word prefix not less than
+/// @a prefix, or the index length if there is none.
+static gint
+stardict_dict_prefix_bound (StardictDict *sd, guint64 prefix, guint *probes)
+{
+	StardictDictPrivate *priv = sd->priv;
+	const guint64 *prefixes = priv->search_prefixes;
+	gsize k = 1, n = priv->index_length;
+	while (k <= n)
+	{
+		(*probes)++;
+		k = 2 * k + (prefixes[k] < prefix);
+	}
+
+	// Undo the right turns at the end, and the left one before them
+	while (k & 1)
+		k >>= 1;
+	k >>= 1;
+	return k ? (gint) priv->search_positions[k] : (gint) n;
+}
+
+/// Search for a word within the index positions from @a lo to @a hi,
+/// the same way as stardict_dict_search_range() does, only using prefixes.
+static gint
+stardict_dict_search_prefixes (StardictDict *sd, const gchar *word,
+	gint lo, gint hi, gboolean *success, guint *probes)
+{
+	guint64 prefix = search_prefix (word);
+	gint first = stardict_dict_prefix_bound (sd, prefix, probes);
+	gint last = prefix == G_MAXUINT64 ? (gint) sd->priv->index_length
+		: stardict_dict_prefix_bound (sd, prefix + 1, probes);
+
+	// Only words with the same prefix need to be compared in full
+	gint imin = CLAMP (first, lo, hi + 1), imax = MIN (last, hi + 1);
+	while (imin < imax)
+	{
+		gint imid = imin + (imax - imin) / 2;
+		if (stardict_dict_probe_index (sd, word, NULL, imid, probes) > 0)
+			imin = imid + 1;
+		else
+			imax = imid;
+	}
+
+	*success = imin <= hi
+		&& !stardict_dict_probe_index (sd, word, NULL, imin, probes);
+	return imin;
+}
+
+/// Search for a word within the index positions from @a lo to @a hi.
+/// @return The first matching position, or where the word would be
+static gint
+stardict_dict_search_range (StardictDict *sd, const gchar *word,
+	const GByteArray *key, gint lo, gint hi, gboolean *success, guint *probes)
+{
+	if (sd->priv->search_prefixes)
+		return stardict_dict_search_prefixes
+			(sd, word, lo, hi, success, probes);
+
+	BINARY_SEARCH_RANGE_BEGIN (lo, hi,
+		stardict_dict_probe_index (sd, word, key, imid, probes))
 
 	// Back off to the first matching entry
-	while (imid > 0 && !stardict_dict_cmp_synonym (sd, word, imid - 1))
+	while (imid > lo
+		&& !stardict_dict_probe_index (sd, word, key, imid - 1, probes))
 		imid--;
 
-	GPtrArray *array = g_ptr_array_new ();
+	*success = TRUE;
+	return imid;
+
+	BINARY_SEARCH_END
+
+	*success = FALSE;
+	return imin;
+}
+
+/// Try to find a longer common prefix with a preceding entry.
+static gint
+stardict_dict_back_off (StardictDict *sd, const gchar *word, gint i,
+	guint *probes)
+{
+	// We need to take care not to step through the entire dictionary
+	// if not a single character matches, because it can be quite costly.
+	size_t probe, best = prefix (sd, word, i, probes);
+	while (best && i > 0
+		&& (probe = prefix (sd, word, i - 1, probes)) >= best)
+	{
+		// TODO: take more care to not screw up exact matches,
+		//   use several "best"s according to quality
+		//   (the most severe issue here is ignored diacritics)
+		if (!strcmp (word, stardict_dict_index_word (sd, i)))
+			break;
+
+		best = probe;
+		i--;
+	}
+	return i;
+}
+
+/// Account for a search that has started at @a start.
+static void
+stardict_dict_record_search (StardictDict *sd, gint64 start, guint probes)
+{
+	gint64 elapsed = g_get_monotonic_time () - start;
+	guint bucket = 0;
+	while (bucket + 1 < STARDICT_SEARCH_LATENCY_BUCKETS
+		&& elapsed >= (G_GINT64_CONSTANT (1) << bucket))
+		bucket++;
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->stats_lock);
+	priv->stats.searches++;
+	priv->stats.search_time += elapsed;
+	priv->stats.search_comparisons += probes;
+	priv->stats.search_latency[bucket]++;
+	g_mutex_unlock (&priv->stats_lock);
+}
+
+/// Compare two words in the order that the dictionary's index follows.
+gint
+stardict_dict_compare_words (StardictDict *sd,
+	const gchar *w1, const gchar *w2)
+{
+	// The collation only becomes known once the dictionary has been loaded
+	(void) stardict_dict_acquire (sd, NULL);
+	gint result = sd->priv->collator
+		? stardict_dict_strcoll (w1, w2, sd)
+		: stardict_strcmp (w1, w2);
+	stardict_dict_release (sd);
+	return result;
+}
+
+/// Search for a word.  The search is ASCII-case-insensitive.
+/// @param[in] word  The word in utf-8 encoding
+/// @param[out] success  TRUE if found
+/// @return An iterator object pointing to the word, or where it would be
+StardictIterator *
+stardict_dict_search (StardictDict *sd, const gchar *word, gboolean *success)
+{
+	gint64 start = g_get_monotonic_time ();
+	guint probes = 0;
+	(void) stardict_dict_acquire (sd, NULL);
+
+	GByteArray *key = stardict_dict_make_lookup_key (sd, word);
+	gboolean found = FALSE;
+	gint i = stardict_dict_search_range (sd, word, key,
+		0, (gint) sd->priv->index_length - 1, &found, &probes);
+	if (key)
+		g_byte_array_free (key, TRUE);
+
+	if (!found)
+		i = stardict_dict_back_off (sd, word, i, &probes);
+	if (success)
+		*success = found;
+
+	stardict_dict_record_search (sd, start, probes);
+	StardictIterator *iterator = stardict_iterator_new (sd, i);
+	stardict_dict_release (sd);
+	return iterator;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// When a search query is being typed in, each new query tends to extend
+// the previous one, and its position has to lie within the range of entries
+// that begin with it.  Searches only probe the boundaries of that range
+// to make sure that it still applies, and otherwise stay within it.
+
+struct stardict_search
+{
+	StardictDict  * dict;               ///< The dictionary being searched
+	gchar         * word;               ///< The last query, or NULL
+	gint            lo;                 ///< The first entry beginning with it
+	gint            hi;                 ///< Past the last such entry
+};
+
+/// Start a series of searches within a dictionary.
+/// The dictionary's data stay loaded for as long as the session exists.
+StardictSearch *
+stardict_search_new (StardictDict *sd)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), NULL);
+
+	StardictSearch *self = g_slice_new0 (StardictSearch);
+	self->dict = g_object_ref (sd);
+	(void) stardict_dict_acquire (sd, NULL);
+	return self;
+}
+
+void
+stardict_search_free (StardictSearch *self)
+{
+	stardict_dict_release (self->dict);
+	g_object_unref (self->dict);
+	g_free (self->word);
+	g_slice_free (StardictSearch, self);
+}
+
+/// Return the dictionary that is being searched.
+StardictDict *
+stardict_search_get_dict (StardictSearch *self)
+{
+	return self->dict;
+}
+
+static gboolean
+word_has_prefix (const gchar *word, const gchar *prefix, gsize prefix_len)
+{
+	return !g_ascii_strncasecmp (word, prefix, prefix_len);
+}
+
+/// Find the end of the run of entries starting at @a lo that begin
+/// with the given prefix, assuming that they are contiguous.
+static gint
+stardict_search_find_end (StardictSearch *self, const gchar *prefix, gint lo)
+{
+	StardictDict *sd = self->dict;
+	gint n = sd->priv->index_length;
+	gsize prefix_len = strlen (prefix);
+	if (lo >= n || !word_has_prefix
+		(stardict_dict_index_word (sd, lo), prefix, prefix_len))
+		return lo;
+
+	// Gallop forwards, then bisect between the last hit and the first miss
+	gint good = lo, bad = n;
+	for (gint step = 1; good + step < n; step *= 2)
+	{
+		if (!word_has_prefix (stardict_dict_index_word (sd, good + step),
+			prefix, prefix_len))
+		{
+			bad = good + step;
+			break;
+		}
+		good += step;
+	}
+	while (bad - good > 1)
+	{
+		gint mid = good + (bad - good) / 2;
+		if (word_has_prefix (stardict_dict_index_word (sd, mid),
+			prefix, prefix_len))
+			good = mid;
+		else
+			bad = mid;
+	}
+	return bad;
+}
+
+/// Search for a word, the same way as stardict_dict_search() would,
+/// narrowing the search down if it extends the previous query.
+StardictIterator *
+stardict_search_update (StardictSearch *self,
+	const gchar *word, gboolean *success)
+{
+	gint64 start = g_get_monotonic_time ();
+	guint probes = 0;
+
+	StardictDict *sd = self->dict;
+	GByteArray *key = stardict_dict_make_lookup_key (sd, word);
+	gint n = sd->priv->index_length, lo = 0, hi = n;
+
+	// The result is only the same as with a full search if every entry
+	// outside of the range compares differently to the new query
+	if (self->word && *self->word && g_str_has_prefix (word, self->word)
+	 && (self->lo == 0 || stardict_dict_probe_index
+		(sd, word, key, self->lo - 1, &probes) > 0)
+	 && (self->hi == n || stardict_dict_probe_index
+		(sd, word, key, self->hi, &probes) < 0))
+	{
+		lo = self->lo;
+		hi = self->hi;
+	}
+
+	gboolean found = FALSE;
+	gint i = stardict_dict_search_range (sd, word, key,
+		lo, hi - 1, &found, &probes);
+	if (key)
+		g_byte_array_free (key, TRUE);
+
+	// Entries that begin with this query can only follow this position
+	g_free (self->word);
+	self->word = g_strdup (word);
+	self->lo = i;
+	self->hi = stardict_search_find_end (self, word, i);
+
+	// Backing off isn't limited by the range, a preceding entry may well
+	// share a longer prefix with the query than any entry within it
+	if (!found)
+		i = stardict_dict_back_off (sd, word, i, &probes);
+	if (success)
+		*success = found;
+
+	stardict_dict_record_search (sd, start, probes);
+	return stardict_iterator_new (sd, i);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Finding common prefixes is done in loops, with the same first argument,
+// so each thread keeps converted strings and break iterators around.
+
+typedef struct prefix_scratch           PrefixScratch;
+
+struct prefix_scratch
+{
+	gchar           * query;            ///< The last first string, or NULL
+	GArray          * uc1;              ///< @a query in UTF-16
+	GArray          * uc2;              ///< The last second string in UTF-16
+	UBreakIterator  * it1;              ///< Iterates over @a uc1
+	UBreakIterator  * it2;              ///< Iterates over @a uc2
+};
+
+static void
+prefix_scratch_free (PrefixScratch *self)
+{
+	g_free (self->query);
+	g_array_free (self->uc1, TRUE);
+	g_array_free (self->uc2, TRUE);
+	if (self->it1)
+		ubrk_close (self->it1);
+	if (self->it2)
+		ubrk_close (self->it2);
+	g_slice_free (PrefixScratch, self);
+}
+
+static GPrivate prefix_scratch_key =
+	G_PRIVATE_INIT ((GDestroyNotify) prefix_scratch_free);
+
+static PrefixScratch *
+prefix_scratch_get (void)
+{
+	PrefixScratch *self = g_private_get (&prefix_scratch_key);
+	if (self)
+		return self;
+
+	self = g_slice_new0 (PrefixScratch);
+	self->uc1 = g_array_new (FALSE, FALSE, sizeof (UChar));
+	self->uc2 = g_array_new (FALSE, FALSE, sizeof (UChar));
+
+	// Locale shouldn't matter much with graphemes, let's use the default
+	UErrorCode error = U_ZERO_ERROR;
+	self->it1 = ubrk_open (UBRK_CHARACTER, NULL, NULL, 0, &error);
+	self->it2 = ubrk_open (UBRK_CHARACTER, NULL, NULL, 0, &error);
+	g_private_set (&prefix_scratch_key, self);
+	return self;
+}
+
+/// Convert valid UTF-8 to UTF-16, and point a break iterator at the result.
+static gboolean
+prefix_scratch_convert (GArray *out, UBreakIterator *it, const gchar *s)
+{
+	// UTF-16 never takes more code units than UTF-8 does
+	int32_t len = 0;
+	UErrorCode error = U_ZERO_ERROR;
+	g_array_set_size (out, strlen (s) + 1);
+	u_strFromUTF8 ((UChar *) out->data, out->len, &len, s, -1, &error);
+	g_array_set_size (out, U_SUCCESS (error) ? len : 0);
+	if (!out->len)
+		return FALSE;
+
+	ubrk_setText (it, (const UChar *) out->data, out->len, &error);
+	return U_SUCCESS (error);
+}
+
+/// Find the longest common prefix of two strings, ignoring ASCII case,
+/// without splitting any UTF-8 sequences.  This matches the ordering
+/// of uncollated indexes.
+static size_t
+ascii_common_prefix (const gchar *s1, const gchar *s2)
+{
+	size_t len = 0;
+	while (s1[len] && g_ascii_tolower (s1[len]) == g_ascii_tolower (s2[len]))
+		len++;
+	while (len && ((guchar) s1[len] & 0xC0) == 0x80)
+		len--;
+	return len;
+}
+
+static size_t
+stardict_dict_common_prefix_loaded (StardictDict *sd,
+	const gchar *s1, const gchar *s2)
+{
+	if (!sd->priv->collator)
+		return ascii_common_prefix (s1, s2);
+
+	UCollator *collator = sd->priv->collator_primary;
+	PrefixScratch *scratch = prefix_scratch_get ();
+	if (!collator || !scratch->it1 || !scratch->it2)
+		return 0;
+
+	// Both inputs need to be valid UTF-8 because of all the iteration mess
+	if (!scratch->query || strcmp (scratch->query, s1))
+	{
+		g_free (scratch->query);
+		scratch->query = NULL;
+		if (!prefix_scratch_convert (scratch->uc1, scratch->it1, s1))
+			return 0;
+		scratch->query = g_strdup (s1);
+	}
+	if (!prefix_scratch_convert (scratch->uc2, scratch->it2, s2))
+		return 0;
+
+	// ucol_getSortKey() can't be used for these purposes, so the only
+	// reasonable thing remaining is iterating by full graphemes.  It doesn't
+	// work entirely correctly (e.g. Czech "ch" should be regarded as a single
+	// unit).  It's just good enough for most purposes.
+	const UChar *uc1 = (const UChar *) scratch->uc1->data;
+	const UChar *uc2 = (const UChar *) scratch->uc2->data;
+	(void) ubrk_first (scratch->it1);
+	(void) ubrk_first (scratch->it2);
+
+	int32_t longest = 0;
+	int32_t pos1, pos2;
+	while ((pos1 = ubrk_next (scratch->it1)) != UBRK_DONE
+		&& (pos2 = ubrk_next (scratch->it2)) != UBRK_DONE)
+	{
+		if (!ucol_strcoll (collator, uc1, pos1, uc2, pos2))
+			longest = pos1;
+	}
+
+	// Map the UTF-16 length back onto the original, already validated string
+	const gchar *p = s1;
+	for (int32_t units = 0; units < longest; p = g_utf8_next_char (p))
+		units += g_utf8_get_char (p) > 0xFFFF ? 2 : 1;
+	return p - s1;
+}
+
+/// Return the longest sequence of bytes from @a s1 that form a common prefix
+/// with @a s2 wrt. collation rules for this dictionary.
+/// This may be called from multiple threads at once.
+size_t
+stardict_longest_common_collation_prefix (StardictDict *sd,
+	const gchar *s1, const gchar *s2)
+{
+	size_t longest = 0;
+	if (stardict_dict_acquire (sd, NULL))
+		longest = stardict_dict_common_prefix_loaded (sd, s1, s2);
+	stardict_dict_release (sd);
+	return longest;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Misspelled words are looked up through trigrams of their folded forms,
+// as any word within a small edit distance has to share most of them.
+// The candidates are then verified by computing the actual distance.
+// The index refers to the original order of index entries, but it's still
+// tied to the collation that it was built with, so that any change of order
+// invalidates it, rather than sending lookups to the wrong words.
+
+#define FUZZY_INDEX_SUFFIX       ".fuzzy"
+#define FUZZY_INDEX_MAGIC        "TDVFUZZ"
+#define FUZZY_INDEX_VERSION      2
+
+/// How many of the most promising candidates get verified, approximately
+#define FUZZY_MAX_CANDIDATES     4096
+
+typedef struct fuzzy_index_header       FuzzyIndexHeader;
+
+/// The fixed part of a fuzzy index file.  It is followed by sorted trigram
+/// keys as guint64, the offsets of their postings as guint32 and one more
+/// marking the end, the postings as guint32 original positions in the index,
+/// and finally by folded lengths of all words as saturated guint8.
+struct fuzzy_index_header
+{
+	gchar           magic[8];           ///< FUZZY_INDEX_MAGIC
+	guint32         version;            ///< FUZZY_INDEX_VERSION
+	guint32         index_length;       ///< Number of index entries
+	CollationIdentity collation;        ///< Order of the index
+	guint64         idx_size;           ///< Size of the index file
+	gint64          idx_mtime;          ///< Last modification of the index
+
+	// These fields aren't known before the index has been loaded
+	guint32         n_keys;             ///< Number of distinct trigrams
+	guint32         n_postings;         ///< Number of all postings
+};
+
+struct fuzzy_index
+{
+	GBytes        * data;               //!< The index in the file format
+	const guint64 * keys;               //!< Sorted trigram keys
+	const guint32 * offsets;            //!< Postings of each key
+	const guint32 * postings;           //!< Original index positions
+	const guint8  * lengths;            //!< Lengths of folded words
+	guint32         n_keys;             //!< Number of trigram keys
+	guint32         n_words;            //!< Number of index entries
+};
+
+static gsize
+fuzzy_index_length (const FuzzyIndexHeader *header)
+{
+	return sizeof *header + sizeof (guint64) * header->n_keys
+		+ sizeof (guint32) * ((gsize) header->n_keys + 1 + header->n_postings)
+		+ header->index_length;
+}
+
+/// Wrap fuzzy index data that have already been validated.
+static FuzzyIndex *
+fuzzy_index_new (GBytes *data)
+{
+	const gchar *p = g_bytes_get_data (data, NULL);
+	const FuzzyIndexHeader *header = (const FuzzyIndexHeader *) p;
+
+	FuzzyIndex *self = g_slice_new0 (FuzzyIndex);
+	self->data = data;
+	self->keys = (const guint64 *) (p + sizeof *header);
+	self->offsets = (const guint32 *) (self->keys + header->n_keys);
+	self->postings = self->offsets + header->n_keys + 1;
+	self->lengths = (const guint8 *) (self->postings + header->n_postings);
+	self->n_keys = header->n_keys;
+	self->n_words = header->index_length;
+	return self;
+}
+
+static void
+fuzzy_index_free (FuzzyIndex *self)
+{
+	g_bytes_unref (self->data);
+	g_slice_free (FuzzyIndex, self);
+}
+
+static gsize
+fuzzy_index_size (const FuzzyIndex *self)
+{
+	return g_bytes_get_size (self->data);
+}
+
+/// Describe the file that the fuzzy index is derived from.
+static gboolean
+fuzzy_index_header_init (FuzzyIndexHeader *header, StardictDict *sd)
+{
+	StardictDictPrivate *priv = sd->priv;
+	memset (header, 0, sizeof *header);
+	memcpy (header->magic, FUZZY_INDEX_MAGIC, sizeof header->magic);
+	header->version = FUZZY_INDEX_VERSION;
+	header->index_length = priv->index_length;
+	collation_identity_init (&header->collation, sd);
+
+	GStatBuf sb;
+	if (g_stat (priv->idx_path, &sb))
+		return FALSE;
+	header->idx_size = sb.st_size;
+	header->idx_mtime = sb.st_mtime;
+	return TRUE;
+}
+
+/// Make sure that a fuzzy index file belongs to the index, and that reading
+/// it can't go out of bounds.
+static gboolean
+fuzzy_index_is_valid (GBytes *data, const FuzzyIndexHeader *expected)
+{
+	gsize length = 0;
+	const gchar *p = g_bytes_get_data (data, &length);
+	const FuzzyIndexHeader *header = (const FuzzyIndexHeader *) p;
+	if (length < sizeof *header
+	 || memcmp (header, expected, offsetof (FuzzyIndexHeader, n_keys))
+	 || length != fuzzy_index_length (header))
+		return FALSE;
+
+	const guint64 *keys = (const guint64 *) (p + sizeof *header);
+	const guint32 *offsets = (const guint32 *) (keys + header->n_keys);
+	const guint32 *postings = offsets + header->n_keys + 1;
+	if (offsets[0] || offsets[header->n_keys] != header->n_postings)
+		return FALSE;
+	for (guint32 i = 0; i < header->n_keys; i++)
+		if (offsets[i] > offsets[i + 1] || (i && keys[i - 1] >= keys[i]))
+			return FALSE;
+	for (guint32 i = 0; i < header->n_postings; i++)
+		if (postings[i] >= header->index_length)
+			return FALSE;
+	return TRUE;
+}
+
+/// Fold a word for fuzzy matching, ignoring case and diacritics.
+static gunichar *
+fuzzy_fold (const gchar *word, glong *len)
+{
+	if (!g_utf8_validate (word, -1, NULL))
+		return NULL;
+
+	gchar *folded = g_utf8_casefold (word, -1);
+	gchar *decomposed = g_utf8_normalize (folded, -1, G_NORMALIZE_NFD);
+	g_free (folded);
+	if (!decomposed)
+		return NULL;
+
+	glong n = 0;
+	gunichar *chars = g_utf8_to_ucs4_fast (decomposed, -1, &n);
+	g_free (decomposed);
+
+	glong out = 0;
+	for (glong i = 0; i < n; i++)
+		if (g_unichar_type (chars[i]) != G_UNICODE_NON_SPACING_MARK)
+			chars[out++] = chars[i];
+	chars[out] = 0;
+	*len = out;
+	return chars;
+}
+
+/// Return the trigram ending at position @a i.  With two characters of padding
+/// at the front and one at the back, a word of length N has N + 1 trigrams.
+static inline guint64
+fuzzy_trigram (const gunichar *chars, glong len, glong i)
+{
+	guint64 key = 0;
+	for (glong k = i - 2; k <= i; k++)
+		key = key << 21 | (k >= 0 && k < len ? chars[k] : 0);
+	return key;
+}
+
+static gint
+fuzzy_key_cmp (gconstpointer a, gconstpointer b)
+{
+	guint64 ka = *(const guint64 *) a, kb = *(const guint64 *) b;
+	return (ka > kb) - (ka < kb);
+}
+
+typedef struct fuzzy_posting            FuzzyPosting;
+
+struct fuzzy_posting
+{
+	guint64         key;                //!< Trigram key
+	guint32         id;                 //!< Original index position
+};
+
+static gint
+fuzzy_posting_cmp (gconstpointer a, gconstpointer b)
+{
+	const FuzzyPosting *pa = a, *pb = b;
+	if (pa->key != pb->key)
+		return pa->key < pb->key ? -1 : 1;
+	return (pa->id > pb->id) - (pa->id < pb->id);
+}
+
+/// Build a fuzzy index of the whole dictionary in the file format.
+static GBytes *
+fuzzy_index_build (StardictDict *sd, const FuzzyIndexHeader *expected)
+{
+	StardictDictPrivate *priv = sd->priv;
+	guint32 n = priv->index_length;
+	guint8 *lengths = g_malloc0 (n + 1);
+	GArray *pairs = g_array_new (FALSE, FALSE, sizeof (FuzzyPosting));
+	for (guint32 i = 0; i < n; i++)
+	{
+		guint32 position = priv->index_reverse ? priv->index_reverse[i] : i;
+		glong len = 0;
+		gunichar *chars =
+			fuzzy_fold (stardict_dict_index_word (sd, position), &len);
+		if (!chars)
+			continue;
+
+		lengths[i] = MIN (len, G_MAXUINT8);
+		for (glong k = 0; len && k <= len; k++)
+		{
+			FuzzyPosting posting = { fuzzy_trigram (chars, len, k), i };
+			g_array_append_val (pairs, posting);
+		}
+		g_free (chars);
+	}
+	g_array_sort (pairs, fuzzy_posting_cmp);
+
+	// Repeated trigrams within a word collapse into a single posting
+	FuzzyIndexHeader header = *expected;
+	const FuzzyPosting *p = (const FuzzyPosting *) pairs->data;
+	for (guint i = 0; i < pairs->len; i++)
+	{
+		if (!i || p[i].key != p[i - 1].key)
+			header.n_keys++;
+		if (!i || p[i].key != p[i - 1].key || p[i].id != p[i - 1].id)
+			header.n_postings++;
+	}
+
+	gsize length = fuzzy_index_length (&header);
+	gchar *data = g_malloc (length);
+	memcpy (data, &header, sizeof header);
+
+	guint64 *keys = (guint64 *) (data + sizeof header);
+	guint32 *offsets = (guint32 *) (keys + header.n_keys);
+	guint32 *postings = offsets + header.n_keys + 1;
+	guint32 n_keys = 0, n_postings = 0;
+	for (guint i = 0; i < pairs->len; i++)
+	{
+		if (!i || p[i].key != p[i - 1].key)
+		{
+			keys[n_keys] = p[i].key;
+			offsets[n_keys++] = n_postings;
+		}
+		else if (p[i].id == p[i - 1].id)
+			continue;
+		postings[n_postings++] = p[i].id;
+	}
+	offsets[n_keys] = n_postings;
+	memcpy (postings + n_postings, lengths, n);
+
+	g_array_free (pairs, TRUE);
+	g_free (lengths);
+	return g_bytes_new_take (data, length);
+}
 
-	// And add all matching entries from that position on to the array
-	do
-	{
-		guint32 i = sd->priv->collator
-			? g_array_index (synonyms, StardictSynonymEntry,
-				g_array_index (collated, guint32, imid)).original_word
-			: g_array_index (synonyms, StardictSynonymEntry,
-				imid).original_word;
+/// Load the fuzzy index from its file, or build it and try to store it there.
+static gpointer
+stardict_dict_fuzzy_index_thread (gpointer data)
+{
+	StardictDict *sd = data;
+	StardictDictPrivate *priv = sd->priv;
 
-		// When we use a collator this will point to the original entry,
-		// otherwise it points to itself and this changes nothing
-		i = g_array_index (sd->priv->index, StardictIndexEntry,
-			i).reverse_index;
+	FuzzyIndexHeader header;
+	gchar *path = g_strconcat (priv->idx_path, FUZZY_INDEX_SUFFIX, NULL);
+	gboolean cacheable = fuzzy_index_header_init (&header, sd);
 
-		g_ptr_array_add (array,
-			g_strdup (g_array_index (index, StardictIndexEntry, i).name));
+	GBytes *bytes = NULL;
+	GMappedFile *mf = NULL;
+	if (cacheable && (mf = g_mapped_file_new (path, FALSE, NULL)))
+	{
+		bytes = g_mapped_file_get_bytes (mf);
+		g_mapped_file_unref (mf);
+		if (!fuzzy_index_is_valid (bytes, &header))
+		{
+			g_bytes_unref (bytes);
+			bytes = NULL;
+		}
 	}
-	while ((guint) ++imid < synonyms->len
-		&& !stardict_dict_cmp_synonym (sd, word, imid));
+	if (!bytes)
+	{
+		bytes = fuzzy_index_build (sd, &header);
 
-	g_ptr_array_add (array, NULL);
-	return (gchar **) g_ptr_array_free (array, FALSE);
+		// The dictionary may easily be installed in a read-only location
+		gsize length = 0;
+		gconstpointer contents = g_bytes_get_data (bytes, &length);
+		GError *error = NULL;
+		if (cacheable && !g_file_set_contents (path, contents, length, &error))
+		{
+			g_debug ("%s: %s", path, error->message);
+			g_error_free (error);
+		}
+	}
+	g_free (path);
 
-	BINARY_SEARCH_END
+	FuzzyIndex *fuzzy = fuzzy_index_new (bytes);
+	g_mutex_lock (&priv->fuzzy_lock);
+	priv->fuzzy = fuzzy;
+	priv->fuzzy_building = FALSE;
+	g_cond_broadcast (&priv->fuzzy_cond);
+	g_mutex_unlock (&priv->fuzzy_lock);
+
+	stardict_dict_release (sd);
+	g_object_unref (sd);
 	return NULL;
 }
 
+/// Start preparing the index for stardict_dict_fuzzy_search() in a background
+/// thread, unless it's already available.  It's stored next to the index.
+/// @param[in] wait  Whether to wait for the index to become available
+void
+stardict_dict_build_fuzzy_index (StardictDict *sd, gboolean wait)
+{
+	g_return_if_fail (STARDICT_IS_DICT (sd));
+
+	StardictDictPrivate *priv = sd->priv;
+	if (!stardict_dict_acquire (sd, NULL))
+		goto out;
+
+	g_mutex_lock (&priv->fuzzy_lock);
+	if (!priv->fuzzy && !priv->fuzzy_building)
+	{
+		// The thread keeps the data loaded until it finishes
+		priv->fuzzy_building = TRUE;
+		(void) stardict_dict_acquire (sd, NULL);
+		g_thread_unref (g_thread_new ("fuzzy-index",
+			stardict_dict_fuzzy_index_thread, g_object_ref (sd)));
+	}
+	while (wait && priv->fuzzy_building)
+		g_cond_wait (&priv->fuzzy_cond, &priv->fuzzy_lock);
+	g_mutex_unlock (&priv->fuzzy_lock);
+out:
+	stardict_dict_release (sd);
+}
+
+/// Compute the optimal string alignment distance between two strings,
+/// that is Levenshtein distance with transpositions, up to @a limit + 1.
+static guint
+fuzzy_distance (const gunichar *a, glong la, const gunichar *b, glong lb,
+	guint limit)
+{
+	if ((guint) ABS (la - lb) > limit)
+		return limit + 1;
+
+	// Transpositions need to look two rows back
+	guint *rows = g_new (guint, 3 * (lb + 1));
+	guint *prev2 = rows, *prev = prev2 + lb + 1, *cur = prev + lb + 1;
+	for (glong j = 0; j <= lb; j++)
+		prev[j] = j;
+
+	guint result = limit + 1;
+	for (glong i = 1; i <= la; i++)
+	{
+		guint row_min = cur[0] = i;
+		for (glong j = 1; j <= lb; j++)
+		{
+			guint d = MIN (prev[j], cur[j - 1]) + 1;
+			d = MIN (d, prev[j - 1] + (a[i - 1] != b[j - 1]));
+			if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+				d = MIN (d, prev2[j - 2] + 1);
+			row_min = MIN (row_min, d);
+			cur[j] = d;
+		}
+
+		// The minimum of a row never decreases with further rows
+		if (row_min > limit)
+			goto out;
+
+		guint *tmp = prev2;
+		prev2 = prev;
+		prev = cur;
+		cur = tmp;
+	}
+	result = MIN (prev[lb], limit + 1);
+out:
+	g_free (rows);
+	return result;
+}
+
+typedef struct fuzzy_match              FuzzyMatch;
+
+struct fuzzy_match
+{
+	guint32         position;           //!< Position within the index
+	guint           distance;           //!< Edit distance from the query
+	guint           shared;             //!< Number of shared trigrams
+};
+
 static gint
-stardict_dict_cmp_index (StardictDict *sd, const gchar *word, gint i)
+fuzzy_match_cmp (gconstpointer a, gconstpointer b)
 {
-	const gchar *target =
-		g_array_index (sd->priv->index, StardictIndexEntry, i).name;
-	if (sd->priv->collator)
-		return stardict_dict_strcoll (word, target, sd);
-	return g_ascii_strcasecmp (word, target);
+	const FuzzyMatch *ma = a, *mb = b;
+	if (ma->distance != mb->distance)
+		return ma->distance < mb->distance ? -1 : 1;
+	if (ma->shared != mb->shared)
+		return ma->shared > mb->shared ? -1 : 1;
+	return (ma->position > mb->position) - (ma->position < mb->position);
 }
 
-static size_t
-prefix (StardictDict *sd, const gchar *word, gint i)
+static gint
+fuzzy_index_find (const FuzzyIndex *self, guint64 key)
 {
-	GArray *index = sd->priv->index;
-	return (guint) i >= index->len ? 0 :
-		stardict_longest_common_collation_prefix
-			(sd, word, g_array_index (index, StardictIndexEntry, i).name);
+	BINARY_SEARCH_BEGIN ((gint) self->n_keys - 1,
+		(key > self->keys[imid]) - (key < self->keys[imid]))
+		return imid;
+	BINARY_SEARCH_END
+	return -1;
 }
 
-/// Search for a word.  The search is ASCII-case-insensitive.
-/// @param[in] word  The word in utf-8 encoding
-/// @param[out] success  TRUE if found
-/// @return An iterator object pointing to the word, or where it would be
-StardictIterator *
-stardict_dict_search (StardictDict *sd, const gchar *word, gboolean *success)
+/// Collect words that share trigrams with the query into @a touched,
+/// counting them into @a shared.
+/// @return The number of distinct trigrams within the query
+static guint
+fuzzy_index_count (const FuzzyIndex *self, const gunichar *query, glong len,
+	guint8 *shared, GArray *touched)
 {
-	GArray *index = sd->priv->index;
+	guint64 *keys = g_new (guint64, len + 1);
+	for (glong i = 0; i <= len; i++)
+		keys[i] = fuzzy_trigram (query, len, i);
+	qsort (keys, len + 1, sizeof *keys, fuzzy_key_cmp);
 
-	BINARY_SEARCH_BEGIN (index->len - 1,
-		stardict_dict_cmp_index (sd, word, imid))
+	guint distinct = 0;
+	for (glong i = 0; i <= len; i++)
+	{
+		if (i && keys[i] == keys[i - 1])
+			continue;
 
-	// Back off to the first matching entry
-	while (imid > 0 && !stardict_dict_cmp_index (sd, word, imid - 1))
-		imid--;
+		distinct++;
+		gint k = fuzzy_index_find (self, keys[i]);
+		if (k < 0)
+			continue;
 
-	if (success) *success = TRUE;
-	return stardict_iterator_new (sd, imid);
+		for (guint32 j = self->offsets[k]; j < self->offsets[k + 1]; j++)
+		{
+			guint32 id = self->postings[j];
+			if (!shared[id])
+				g_array_append_val (touched, id);
+			if (shared[id] < G_MAXUINT8)
+				shared[id]++;
+		}
+	}
+	g_free (keys);
+	return distinct;
+}
 
-	BINARY_SEARCH_END
+static GArray *
+stardict_dict_fuzzy_search_loaded (StardictDict *sd,
+	const gchar *word, guint limit)
+{
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->fuzzy_lock);
+	const FuzzyIndex *fuzzy = priv->fuzzy;
+	g_mutex_unlock (&priv->fuzzy_lock);
+	if (!fuzzy)
+	{
+		stardict_dict_build_fuzzy_index (sd, FALSE);
+		return NULL;
+	}
 
-	// Try to find a longer common prefix with a preceding entry.
-	// We need to take care not to step through the entire dictionary
-	// if not a single character matches, because it can be quite costly.
-	size_t probe, best = prefix (sd, word, imin);
-	while (best && imin > 0 && (probe = prefix (sd, word, imin - 1)) >= best)
+	GArray *result = g_array_new (FALSE, FALSE, sizeof (guint32));
+	glong len = 0;
+	gunichar *query = fuzzy_fold (word, &len);
+	if (!query || !len || !limit)
 	{
-		// TODO: take more care to not screw up exact matches,
-		//   use several "best"s according to quality
-		//   (the most severe issue here is ignored diacritics)
-		if (!strcmp (word, g_array_index
-			(index, StardictIndexEntry, imin).name))
+		g_free (query);
+		return result;
+	}
+
+	// Short words would be similar to too many others
+	guint max_distance = len <= 4 ? 1 : 2;
+
+	guint8 *shared = g_malloc0 (fuzzy->n_words + 1);
+	GArray *touched = g_array_new (FALSE, FALSE, sizeof (guint32));
+	guint distinct = fuzzy_index_count (fuzzy, query, len, shared, touched);
+
+	// Any edit breaks at most three trigrams, and a transposition four
+	gint needed = MAX (1, (gint) distinct - 4 * (gint) max_distance);
+
+	// Only verify the words that share the most trigrams with the query
+	guint histogram[G_MAXUINT8 + 1] = { 0 };
+	const guint32 *ids = (const guint32 *) touched->data;
+	for (guint i = 0; i < touched->len; i++)
+	{
+		guint length = fuzzy->lengths[ids[i]];
+		if (shared[ids[i]] >= needed && (length == G_MAXUINT8
+			|| (guint) ABS ((glong) length - len) <= max_distance))
+			histogram[shared[ids[i]]]++;
+		else
+			shared[ids[i]] = 0;
+	}
+
+	gint cutoff = G_MAXUINT8 + 1;
+	for (guint total = 0; cutoff > needed && (!total
+		|| total + histogram[cutoff - 1] <= FUZZY_MAX_CANDIDATES); )
+		total += histogram[--cutoff];
+
+	GArray *matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
+	for (guint i = 0; i < touched->len; i++)
+	{
+		guint32 id = ids[i];
+		if (shared[id] < cutoff)
+			continue;
+
+		FuzzyMatch match = { id, 0, shared[id] };
+		if (priv->index_reverse)
+			match.position = priv->index_reverse[id];
+
+		glong candidate_len = 0;
+		gunichar *candidate = fuzzy_fold
+			(stardict_dict_index_word (sd, match.position), &candidate_len);
+		if (!candidate)
+			continue;
+
+		match.distance = fuzzy_distance
+			(query, len, candidate, candidate_len, max_distance);
+		if (match.distance <= max_distance)
+			g_array_append_val (matches, match);
+		g_free (candidate);
+	}
+	g_array_sort (matches, fuzzy_match_cmp);
+
+	for (guint i = 0; i < matches->len && i < limit; i++)
+		g_array_append_val (result,
+			g_array_index (matches, FuzzyMatch, i).position);
+
+	g_array_free (matches, TRUE);
+	g_array_free (touched, TRUE);
+	g_free (shared);
+	g_free (query);
+	return result;
+}
+
+/// Find words similar to @a word, such as when it's been misspelled.
+/// Unless the index isn't available yet, in which case this function starts
+/// building it and returns NULL, an array is returned of at most @a limit
+/// index positions as guint32, the closest matches first.
+/// This may be called from multiple threads at once.
+GArray *
+stardict_dict_fuzzy_search (StardictDict *sd, const gchar *word, guint limit)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), NULL);
+	g_return_val_if_fail (word != NULL, NULL);
+
+	GArray *result = NULL;
+	if (stardict_dict_acquire (sd, NULL))
+		result = stardict_dict_fuzzy_search_loaded (sd, word, limit);
+	stardict_dict_release (sd);
+	return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Definitions are searched through an inverted index of folded words, mapping
+// each of them to a sorted list of entries that mention it.  Just like
+// the fuzzy index, it refers to the original order of index entries,
+// and it's tied to the collation that it was built with.
+// Building it takes a while, so it's only done on request, e.g. by tdv-index.
+
+#define FULLTEXT_INDEX_SUFFIX    ".fts"
+#define FULLTEXT_INDEX_MAGIC     "TDVFTS"
+#define FULLTEXT_INDEX_VERSION   2
+
+/// Words longer than this in bytes are most likely not words at all
+#define FULLTEXT_MAX_WORD        64
+
+/// The number of entries that are tokenized at once by a single thread
+#define FULLTEXT_CHUNK_SIZE      1024
+
+typedef struct fulltext_index_header    FulltextIndexHeader;
+
+/// The fixed part of a full-text index file.  It is followed by the offsets
+/// of posting lists as guint64, the offsets of words as guint32, both with
+/// one more entry marking the end, then by the NUL-terminated words in strcmp()
+/// order, and finally by the posting lists.  Each of them is a sequence
+/// of differences between ascending original positions in the index,
+/// encoded as variable-length integers, in groups of 7 bits, LSB first.
+struct fulltext_index_header
+{
+	gchar           magic[8];           ///< FULLTEXT_INDEX_MAGIC
+	guint32         version;            ///< FULLTEXT_INDEX_VERSION
+	guint32         index_length;       ///< Number of index entries
+	CollationIdentity collation;        ///< Order of the index
+	guint64         idx_size;           ///< Size of the index file
+	gint64          idx_mtime;          ///< Last modification of the index
+
+	// These fields aren't known before the index has been loaded
+	guint32         n_words;            ///< Number of distinct words
+	guint32         reserved;           ///< Always zero
+	guint64         words_length;       ///< Length of all words
+	guint64         postings_length;    ///< Length of all posting lists
+};
+
+typedef struct fulltext_index           FulltextIndex;
+
+/// Pointers into a loaded full-text index
+struct fulltext_index
+{
+	const guint64 * posting_offsets;    //!< Offsets into @a postings
+	const guint32 * word_offsets;       //!< Offsets into @a words
+	const gchar   * words;              //!< NUL-terminated words
+	const guint8  * postings;           //!< Encoded posting lists
+	guint32         n_words;            //!< Number of words
+	guint32         index_length;       //!< Number of index entries
+};
+
+static gsize
+fulltext_index_length (const FulltextIndexHeader *header)
+{
+	return sizeof *header
+		+ (sizeof (guint64) + sizeof (guint32)) * ((gsize) header->n_words + 1)
+		+ header->words_length + header->postings_length;
+}
+
+static void
+fulltext_index_init (FulltextIndex *self, GBytes *data)
+{
+	const gchar *p = g_bytes_get_data (data, NULL);
+	const FulltextIndexHeader *header = (const FulltextIndexHeader *) p;
+	self->posting_offsets = (const guint64 *) (p + sizeof *header);
+	self->word_offsets =
+		(const guint32 *) (self->posting_offsets + header->n_words + 1);
+	self->words = (const gchar *) (self->word_offsets + header->n_words + 1);
+	self->postings = (const guint8 *) (self->words + header->words_length);
+	self->n_words = header->n_words;
+	self->index_length = header->index_length;
+}
+
+/// Describe the file that the full-text index is derived from.
+static gboolean
+fulltext_index_header_init (FulltextIndexHeader *header, StardictDict *sd)
+{
+	StardictDictPrivate *priv = sd->priv;
+	memset (header, 0, sizeof *header);
+	memcpy (header->magic, FULLTEXT_INDEX_MAGIC, sizeof header->magic);
+	header->version = FULLTEXT_INDEX_VERSION;
+	header->index_length = priv->index_length;
+	collation_identity_init (&header->collation, sd);
+
+	GStatBuf sb;
+	if (g_stat (priv->idx_path, &sb))
+		return FALSE;
+	header->idx_size = sb.st_size;
+	header->idx_mtime = sb.st_mtime;
+	return TRUE;
+}
+
+/// Make sure that a full-text index file belongs to the index, and that
+/// reading it can't go out of bounds.  Posting lists are checked lazily.
+static gboolean
+fulltext_index_is_valid (GBytes *data, const FulltextIndexHeader *expected)
+{
+	gsize length = 0;
+	const gchar *p = g_bytes_get_data (data, &length);
+	const FulltextIndexHeader *header = (const FulltextIndexHeader *) p;
+	if (length < sizeof *header
+	 || memcmp (header, expected, offsetof (FulltextIndexHeader, n_words))
+	 || length != fulltext_index_length (header))
+		return FALSE;
+
+	FulltextIndex fi;
+	fulltext_index_init (&fi, data);
+
+	guint32 n = header->n_words;
+	if (fi.posting_offsets[0] || fi.posting_offsets[n] != header->postings_length
+	 || fi.word_offsets[0] || fi.word_offsets[n] != header->words_length)
+		return FALSE;
+	for (guint32 i = 0; i < n; i++)
+		if (fi.posting_offsets[i] > fi.posting_offsets[i + 1]
+		 || fi.word_offsets[i] >= fi.word_offsets[i + 1]
+		 || fi.words[fi.word_offsets[i + 1] - 1])
+			return FALSE;
+	return TRUE;
+}
+
+/// Fold a word for full-text search, ignoring case and diacritics.
+static gchar *
+fulltext_fold (const gchar *word, gssize len)
+{
+	gchar *folded = g_utf8_casefold (word, len);
+	gchar *decomposed = g_utf8_normalize (folded, -1, G_NORMALIZE_ALL);
+	g_free (folded);
+	if (!decomposed)
+		return NULL;
+
+	// Marks never take fewer bytes than nothing, so this can be done in place
+	gchar *out = decomposed;
+	for (const gchar *p = decomposed; *p; p = g_utf8_next_char (p))
+	{
+		gunichar c = g_utf8_get_char (p);
+		if (!g_unichar_ismark (c))
+			out += g_unichar_to_utf8 (c, out);
+	}
+	*out = 0;
+	return decomposed;
+}
+
+/// Split text into folded words, and append them to @a words.
+/// With @a markup, tags and entities are skipped over.
+static void
+fulltext_tokenize (const gchar *text, gsize length, gboolean markup,
+	GPtrArray *words)
+{
+	const gchar *end = text + length, *word = NULL, *p = text;
+	while (TRUE)
+	{
+		gunichar c = p < end ? g_utf8_get_char_validated (p, end - p) : 0;
+		gboolean valid = c < (gunichar) -2;
+		if (valid && (g_unichar_isalnum (c) || g_unichar_ismark (c)))
+		{
+			if (!word)
+				word = p;
+			p = g_utf8_next_char (p);
+			continue;
+		}
+
+		gchar *folded = NULL;
+		if (word && p - word <= FULLTEXT_MAX_WORD
+		 && (folded = fulltext_fold (word, p - word)))
+			g_ptr_array_add (words, folded);
+		word = NULL;
+
+		const gchar *skip = NULL;
+		if (p >= end)
 			break;
+		if (markup && *p == '<')
+			p = (skip = memchr (p, '>', end - p)) ? skip + 1 : end;
+		else if (markup && *p == '&'
+			&& (skip = memchr (p, ';', MIN (end - p, FULLTEXT_MAX_WORD))))
+			p = skip + 1;
+		else
+			p = valid ? g_utf8_next_char (p) : p + 1;
+	}
+}
 
-		best = probe;
-		imin--;
+/// Tokenize the fields of an entry that contain some kind of text.
+static void
+fulltext_tokenize_fields (GArray *fields, GPtrArray *words)
+{
+	for (guint i = 0; i < fields->len; i++)
+	{
+		const StardictEntryField *field =
+			&g_array_index (fields, StardictEntryField, i);
+		switch (field->type)
+		{
+		case STARDICT_FIELD_MEANING:
+		case STARDICT_FIELD_LOCALE:
+			fulltext_tokenize (field->data, field->data_size, FALSE, words);
+			break;
+		case STARDICT_FIELD_PANGO:
+		case STARDICT_FIELD_XDXF:
+		case STARDICT_FIELD_HTML:
+			fulltext_tokenize (field->data, field->data_size, TRUE, words);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void
+fulltext_append_varint (GByteArray *out, guint32 value)
+{
+	guint8 byte;
+	for (; value >= 0x80; value >>= 7)
+	{
+		byte = (value & 0x7f) | 0x80;
+		g_byte_array_append (out, &byte, 1);
+	}
+	byte = value;
+	g_byte_array_append (out, &byte, 1);
+}
+
+typedef struct fulltext_chunk           FulltextChunk;
+
+/// A range of original index positions to be tokenized by a single thread
+struct fulltext_chunk
+{
+	guint32         begin;              //!< The first position
+	guint32         end;                //!< Past the last position
+	GHashTable    * words;              //!< Word -> GArray<guint32>
+	gboolean        done;               //!< The chunk has been processed
+};
+
+typedef struct fulltext_build           FulltextBuild;
+
+struct fulltext_build
+{
+	StardictDict  * sd;                 //!< The dictionary being indexed
+	GMutex          lock;               //!< Guards chunk completion
+	GCond           cond;               //!< Signals chunk completion
+};
+
+static GHashTable *
+fulltext_words_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) g_array_unref);
+}
+
+static void
+fulltext_build_chunk (gpointer data, gpointer user_data)
+{
+	FulltextChunk *chunk = data;
+	FulltextBuild *build = user_data;
+	StardictDictPrivate *priv = build->sd->priv;
+
+	GHashTable *words = fulltext_words_new ();
+	GPtrArray *tokens = g_ptr_array_new_with_free_func (g_free);
+	StardictEntryView view;
+	stardict_entry_view_init (&view);
+
+	StardictIterator *iterator = stardict_iterator_new (build->sd, 0);
+	for (guint32 id = chunk->begin; id < chunk->end; id++)
+	{
+		guint32 position = priv->index_reverse ? priv->index_reverse[id] : id;
+		stardict_iterator_set_offset (iterator, position, FALSE);
+		if (!stardict_iterator_get_entry_view (iterator, &view))
+			continue;
+
+		fulltext_tokenize_fields (view.fields, tokens);
+		for (guint i = 0; i < tokens->len; i++)
+		{
+			gchar *token = g_ptr_array_index (tokens, i);
+			GArray *postings = g_hash_table_lookup (words, token);
+			if (!postings)
+			{
+				postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+				g_hash_table_insert (words, token, postings);
+				g_ptr_array_index (tokens, i) = NULL;
+			}
+			if (!postings->len
+			 || g_array_index (postings, guint32, postings->len - 1) != id)
+				g_array_append_val (postings, id);
+		}
+		g_ptr_array_set_size (tokens, 0);
+	}
+	g_object_unref (iterator);
+	stardict_entry_view_clear (&view);
+	g_ptr_array_free (tokens, TRUE);
+
+	g_mutex_lock (&build->lock);
+	chunk->words = words;
+	chunk->done = TRUE;
+	g_cond_broadcast (&build->cond);
+	g_mutex_unlock (&build->lock);
+}
+
+/// Collect the words of all entries, by chunks that are tokenized in parallel,
+/// and merged in order, so that posting lists stay sorted.
+static GHashTable *
+fulltext_collect (StardictDict *sd)
+{
+	guint32 n = sd->priv->index_length;
+	guint n_chunks = (n + FULLTEXT_CHUNK_SIZE - 1) / FULLTEXT_CHUNK_SIZE;
+	FulltextChunk *chunks = g_new0 (FulltextChunk, n_chunks);
+
+	FulltextBuild build = { .sd = sd };
+	g_mutex_init (&build.lock);
+	g_cond_init (&build.cond);
+
+	// Non-exclusive thread pools cannot fail to be created
+	GThreadPool *pool = g_thread_pool_new (fulltext_build_chunk, &build,
+		g_get_num_processors (), FALSE, NULL);
+	for (guint i = 0; i < n_chunks; i++)
+	{
+		chunks[i].begin = i * FULLTEXT_CHUNK_SIZE;
+		chunks[i].end = MIN (n, chunks[i].begin + FULLTEXT_CHUNK_SIZE);
+		g_thread_pool_push (pool, &chunks[i], NULL);
+	}
+
+	GHashTable *words = fulltext_words_new ();
+	for (guint i = 0; i < n_chunks; i++)
+	{
+		g_mutex_lock (&build.lock);
+		while (!chunks[i].done)
+			g_cond_wait (&build.cond, &build.lock);
+		g_mutex_unlock (&build.lock);
+
+		GHashTableIter iter;
+		gpointer word = NULL, postings = NULL;
+		g_hash_table_iter_init (&iter, chunks[i].words);
+		while (g_hash_table_iter_next (&iter, &word, &postings))
+		{
+			g_hash_table_iter_steal (&iter);
+
+			GArray *merged = g_hash_table_lookup (words, word);
+			if (!merged)
+			{
+				g_hash_table_insert (words, word, postings);
+				continue;
+			}
+			g_array_append_vals (merged,
+				((GArray *) postings)->data, ((GArray *) postings)->len);
+			g_array_unref (postings);
+			g_free (word);
+		}
+		g_hash_table_destroy (chunks[i].words);
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_mutex_clear (&build.lock);
+	g_cond_clear (&build.cond);
+	g_free (chunks);
+	return words;
+}
+
+static gint
+fulltext_word_cmp (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gboolean
+write_all_to (GOutputStream *os, gconstpointer data, gsize length,
+	GError **error)
+{
+	return g_output_stream_write_all (os, data, length, NULL, NULL, error);
+}
+
+static gboolean
+stardict_dict_build_fulltext_index_loaded (StardictDict *sd, GError **error)
+{
+	StardictDictPrivate *priv = sd->priv;
+	FulltextIndexHeader header;
+	if (!fulltext_index_header_init (&header, sd))
+	{
+		g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND,
+			"%s: %s", priv->idx_path, g_strerror (errno));
+		return FALSE;
+	}
+
+	GHashTable *words = fulltext_collect (sd);
+	GPtrArray *sorted = g_ptr_array_sized_new (g_hash_table_size (words));
+	GHashTableIter iter;
+	gpointer key = NULL;
+	g_hash_table_iter_init (&iter, words);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_ptr_array_add (sorted, key);
+	g_ptr_array_sort (sorted, fulltext_word_cmp);
+
+	guint32 n = header.n_words = sorted->len;
+	guint64 *posting_offsets = g_new (guint64, n + 1);
+	guint32 *word_offsets = g_new (guint32, n + 1);
+	GString *word_data = g_string_new (NULL);
+	GByteArray *postings = g_byte_array_new ();
+	for (guint32 i = 0; i < n; i++)
+	{
+		const gchar *word = g_ptr_array_index (sorted, i);
+		word_offsets[i] = word_data->len;
+		g_string_append_len (word_data, word, strlen (word) + 1);
+
+		GArray *ids = g_hash_table_lookup (words, word);
+		posting_offsets[i] = postings->len;
+		for (guint k = 0; k < ids->len; k++)
+			fulltext_append_varint (postings, g_array_index (ids, guint32, k)
+				- (k ? g_array_index (ids, guint32, k - 1) : 0));
+	}
+	word_offsets[n] = header.words_length = word_data->len;
+	posting_offsets[n] = header.postings_length = postings->len;
+	g_ptr_array_free (sorted, TRUE);
+	g_hash_table_destroy (words);
+
+	gchar *path = g_strconcat (priv->idx_path, FULLTEXT_INDEX_SUFFIX, NULL);
+	GFile *file = g_file_new_for_path (path);
+	g_free (path);
+
+	GOutputStream *os = G_OUTPUT_STREAM (g_file_replace (file,
+		NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL, error));
+	gboolean ok = os
+		&& write_all_to (os, &header, sizeof header, error)
+		&& write_all_to (os, posting_offsets, sizeof (guint64) * (n + 1), error)
+		&& write_all_to (os, word_offsets, sizeof (guint32) * (n + 1), error)
+		&& write_all_to (os, word_data->str, word_data->len, error)
+		&& write_all_to (os, postings->data, postings->len, error)
+		&& g_output_stream_close (os, NULL, error);
+	if (os)
+		g_object_unref (os);
+	g_object_unref (file);
+
+	g_free (posting_offsets);
+	g_free (word_offsets);
+	g_string_free (word_data, TRUE);
+	g_byte_array_free (postings, TRUE);
+
+	// Make sure a stale index doesn't stay around
+	if (ok)
+	{
+		g_mutex_lock (&priv->fulltext_lock);
+		if (priv->fulltext)
+			g_bytes_unref (priv->fulltext);
+		priv->fulltext = NULL;
+		g_mutex_unlock (&priv->fulltext_lock);
+	}
+	return ok;
+}
+
+/// Build an index for stardict_dict_search_fulltext(), and store it next to
+/// the dictionary's index.  Entries are processed on all available processors.
+gboolean
+stardict_dict_build_fulltext_index (StardictDict *sd, GError **error)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), FALSE);
+
+	gboolean ok = stardict_dict_acquire (sd, error)
+		&& stardict_dict_build_fulltext_index_loaded (sd, error);
+	stardict_dict_release (sd);
+	return ok;
+}
+
+/// Map the full-text index file into memory.
+static GBytes *
+fulltext_index_load (StardictDict *sd, GError **error)
+{
+	FulltextIndexHeader header;
+	gchar *path = g_strconcat (sd->priv->idx_path, FULLTEXT_INDEX_SUFFIX, NULL);
+	GMappedFile *mf = NULL;
+	GBytes *data = NULL;
+	if (!fulltext_index_header_init (&header, sd)
+	 || !(mf = g_mapped_file_new (path, FALSE, NULL)))
+	{
+		g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND,
+			"%s: %s", path, _("cannot find the full-text index"));
+		goto out;
+	}
+
+	data = g_mapped_file_get_bytes (mf);
+	g_mapped_file_unref (mf);
+	if (!fulltext_index_is_valid (data, &header))
+	{
+		g_set_error (error, STARDICT_ERROR, STARDICT_ERROR_INVALID_DATA,
+			"%s: %s", path, _("the full-text index is outdated or invalid"));
+		g_bytes_unref (data);
+		data = NULL;
 	}
 
-	if (success) *success = FALSE;
-	return stardict_iterator_new (sd, imin);
+out:
+	g_free (path);
+	return data;
+}
+
+/// Return the full-text index, loading it first if necessary.
+static GBytes *
+stardict_dict_get_fulltext (StardictDict *sd, GError **error)
+{
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->fulltext_lock);
+	if (!priv->fulltext)
+		priv->fulltext = fulltext_index_load (sd, error);
+	GBytes *data = priv->fulltext ? g_bytes_ref (priv->fulltext) : NULL;
+	g_mutex_unlock (&priv->fulltext_lock);
+	return data;
 }
 
-/// Return the longest sequence of bytes from @a s1 that form a common prefix
-/// with @a s2 wrt. collation rules for this dictionary.
-size_t
-stardict_longest_common_collation_prefix (StardictDict *sd,
-	const gchar *s1, const gchar *s2)
+static gint
+fulltext_index_find (const FulltextIndex *self, const gchar *word)
 {
-	UErrorCode error;
-	int32_t uc1_len = 0;
-	int32_t uc2_len = 0;
+	BINARY_SEARCH_BEGIN ((gint) self->n_words - 1,
+		strcmp (word, self->words + self->word_offsets[imid]))
+		return imid;
+	BINARY_SEARCH_END
+	return -1;
+}
 
-	// It sets the error to overflow each time, even during pre-flight
-	error = U_ZERO_ERROR;
-	u_strFromUTF8 (NULL, 0, &uc1_len, s1, -1, &error);
-	error = U_ZERO_ERROR;
-	u_strFromUTF8 (NULL, 0, &uc2_len, s2, -1, &error);
-	error = U_ZERO_ERROR;
+/// Decode the posting list of the @a i-th word.
+static GArray *
+fulltext_index_decode (const FulltextIndex *self, guint32 i)
+{
+	const guint8 *p = self->postings + self->posting_offsets[i];
+	const guint8 *end = self->postings + self->posting_offsets[i + 1];
 
-	// Prevent undefined behaviour with VLAs.
-	if (!uc1_len || !uc2_len)
-		return 0;
+	GArray *ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+	guint64 id = 0;
+	while (p < end)
+	{
+		guint64 delta = 0;
+		for (guint shift = 0; p < end && shift < 35; shift += 7)
+		{
+			delta |= (guint64) (*p & 0x7f) << shift;
+			if (!(*p++ & 0x80))
+				break;
+		}
 
-	UChar uc1[uc1_len];
-	UChar uc2[uc2_len];
-	u_strFromUTF8 (uc1, uc1_len, NULL, s1, -1, &error);
-	u_strFromUTF8 (uc2, uc2_len, NULL, s2, -1, &error);
+		// Don't trust the file any more than necessary
+		if ((id += delta) >= self->index_length)
+			break;
 
-	// Both inputs need to be valid UTF-8 because of all the iteration mess
-	if (U_FAILURE (error))
-		return 0;
+		guint32 value = id;
+		g_array_append_val (ids, value);
+	}
+	return ids;
+}
 
-	UCollator *collator = sd->priv->collator;
-	if (!collator && !(collator = sd->priv->collator_root))
-		return 0;
+/// Keep only those positions in @a ids that are also present in @a other.
+static void
+fulltext_intersect (GArray *ids, const GArray *other)
+{
+	const guint32 *a = (const guint32 *) ids->data;
+	const guint32 *b = (const guint32 *) other->data;
+	guint i = 0, k = 0, out = 0;
+	while (i < ids->len && k < other->len)
+	{
+		if (a[i] < b[k])
+			i++;
+		else if (a[i] > b[k])
+			k++;
+		else
+		{
+			g_array_index (ids, guint32, out++) = a[i++];
+			k++;
+		}
+	}
+	g_array_set_size (ids, out);
+}
 
-	// ucol_getSortKey() can't be used for these purposes, so the only
-	// reasonable thing remaining is iterating by full graphemes.  It doesn't
-	// work entirely correctly (e.g. Czech "ch" should be regarded as a single
-	// unit).  It's just good enough for most purposes.
-	//
-	// Locale shouldn't matter much with graphemes, let's use the default.
-	UBreakIterator *it1 =
-		ubrk_open (UBRK_CHARACTER, NULL, uc1, uc1_len, &error);
-	UBreakIterator *it2 =
-		ubrk_open (UBRK_CHARACTER, NULL, uc2, uc2_len, &error);
+static gint
+guint32_cmp (gconstpointer a, gconstpointer b)
+{
+	guint32 ia = *(const guint32 *) a, ib = *(const guint32 *) b;
+	return (ia > ib) - (ia < ib);
+}
 
-	UCollationStrength prev_strength = ucol_getStrength (collator);
-	ucol_setStrength (collator, UCOL_PRIMARY);
+/// Find entries that mention all words of @a query in their definitions,
+/// using an index made by stardict_dict_build_fulltext_index().
+/// This may be called from multiple threads at once.
+/// @return Index positions as guint32 in ascending order, or NULL on error
+GArray *
+stardict_dict_search_fulltext (StardictDict *sd, const gchar *query,
+	GError **error)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), NULL);
+	g_return_val_if_fail (query != NULL, NULL);
 
-	int32_t longest = 0;
-	int32_t pos1, pos2;
-	while ((pos1 = ubrk_next (it1)) != UBRK_DONE
-		&& (pos2 = ubrk_next (it2)) != UBRK_DONE)
+	GBytes *data = NULL;
+	if (!stardict_dict_acquire (sd, error)
+	 || !(data = stardict_dict_get_fulltext (sd, error)))
 	{
-		if (!ucol_strcoll (collator, uc1, pos1, uc2, pos2))
-			longest = pos1;
+		stardict_dict_release (sd);
+		return NULL;
 	}
-	ubrk_close (it1);
-	ubrk_close (it2);
 
-	ucol_setStrength (collator, prev_strength);
-	if (!longest)
-		return 0;
+	FulltextIndex fi;
+	fulltext_index_init (&fi, data);
 
-	int32_t common_len = 0;
-	u_strToUTF8 (NULL, 0, &common_len, uc1, longest, &error);
+	GPtrArray *words = g_ptr_array_new_with_free_func (g_free);
+	fulltext_tokenize (query, strlen (query), FALSE, words);
 
-	// Since this heavily depends on UTF-16 <-> UTF-8 not modifying the chars
-	// (surrogate pairs interference?), let's add some paranoia here
-	char common[common_len];
-	error = U_ZERO_ERROR;
-	u_strToUTF8 (common, common_len, NULL, uc1, longest, &error);
-	g_return_val_if_fail (!memcmp (s1, common, common_len), 0);
+	GArray *ids = NULL;
+	for (guint i = 0; i < words->len; i++)
+	{
+		gint found = fulltext_index_find (&fi, g_ptr_array_index (words, i));
+		GArray *postings = found < 0
+			? g_array_new (FALSE, FALSE, sizeof (guint32))
+			: fulltext_index_decode (&fi, found);
+		if (!ids)
+		{
+			ids = postings;
+			continue;
+		}
 
-	return (size_t) common_len;
+		fulltext_intersect (ids, postings);
+		g_array_free (postings, TRUE);
+	}
+	if (!ids)
+		ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+	g_ptr_array_free (words, TRUE);
+	g_bytes_unref (data);
+
+	const guint32 *reverse = sd->priv->index_reverse;
+	if (reverse)
+	{
+		for (guint i = 0; i < ids->len; i++)
+			g_array_index (ids, guint32, i) =
+				reverse[g_array_index (ids, guint32, i)];
+		g_array_sort (ids, guint32_cmp);
+	}
+	stardict_dict_release (sd);
+	return ids;
 }
 
 static void
@@ -1099,27 +3702,23 @@ read_entry (gchar type, const gchar **entry_iterator,
 	const gchar *entry = *entry_iterator;
 	if (g_ascii_islower (type))
 	{
-		GString *data = g_string_new (NULL);
-
+		gsize length = end - entry;
 		if (is_final)
-		{
-			g_string_append_len (data, entry, end - entry);
-			entry += end - entry;
-		}
+			entry = end;
 		else
 		{
-			gint c = EOF;
-			while (entry < end && (c = *entry++))
-				g_string_append_c (data, c);
+			const gchar *nul = memchr (entry, '\0', length);
+			if (!nul)
+				return NULL;
 
-			if (c != '\0')
-				return (gpointer) g_string_free (data, TRUE);
+			length = nul - entry;
+			entry = nul + 1;
 		}
 
 		StardictEntryField *sef = g_slice_alloc (sizeof *sef);
 		sef->type = type;
-		sef->data_size = data->len + 1;
-		sef->data = g_string_free (data, FALSE);
+		sef->data_size = length + 1;
+		sef->data = g_strndup (*entry_iterator, length);
 		*entry_iterator = entry;
 		return sef;
 	}
@@ -1196,24 +3795,82 @@ error:
 	return NULL;
 }
 
-/// Read entry data from GInputStream.
-static gchar *
-read_entry_data_from_stream
-	(GInputStream *stream, guint32 offset, StardictIndexEntry *sie)
+/// Locate a field in entry data without copying anything.  Textual fields
+/// end up without their terminating NUL, which they might be missing anyway.
+static gboolean
+view_entry_field (gchar type, const gchar **entry_iterator,
+	const gchar *end, gboolean is_final, StardictEntryField *sef)
 {
-	GError *error = NULL;
-	if (!g_seekable_seek (G_SEEKABLE (stream), sie->data_offset,
-		G_SEEK_SET, NULL, &error))
+	const gchar *entry = *entry_iterator;
+	gsize length = end - entry;
+	if (is_final)
+		*entry_iterator = end;
+	else if (g_ascii_islower (type))
 	{
-		g_debug ("problem seeking to entry #%"
-			G_GUINT32_FORMAT ": %s", offset, error->message);
-		g_error_free (error);
-		return NULL;
+		const gchar *nul = memchr (entry, '\0', length);
+		if (!nul)
+			return FALSE;
+
+		length = nul - entry;
+		*entry_iterator = nul + 1;
+	}
+	else
+	{
+		if (entry + sizeof (guint32) > end)
+			return FALSE;
+
+		length = GUINT32_FROM_BE (*(guint32 *) entry);
+		entry += sizeof (guint32);
+
+		if (entry + length > end)
+			return FALSE;
+
+		*entry_iterator = entry + length;
+	}
+
+	sef->type = type;
+	sef->data = (gpointer) entry;
+	sef->data_size = length;
+	return TRUE;
+}
+
+/// Fill the field array of a view with borrowed fields from entry data.
+static gboolean
+view_entry_fields (const gchar *entry, gsize entry_size,
+	const gchar *sts, GArray *fields)
+{
+	const gchar *end = entry + entry_size;
+	StardictEntryField sef;
+	if (sts)
+	{
+		while (*sts)
+		{
+			gchar type = *sts++;
+			if (!view_entry_field (type, &entry, end, !*sts, &sef))
+				return FALSE;
+			g_array_append_val (fields, sef);
+		}
 	}
+	else while (entry < end)
+	{
+		gchar type = *entry++;
+		if (!view_entry_field (type, &entry, end, FALSE, &sef))
+			return FALSE;
+		g_array_append_val (fields, sef);
+	}
+	return TRUE;
+}
 
+/// Read entry data from a dictzip stream.
+static gchar *
+read_entry_data_from_stream
+	(DictzipInputStream *stream, guint32 offset, StardictIndexEntry *sie)
+{
+	// Positional reads don't disturb the stream, so no locking is needed
+	GError *error = NULL;
 	gchar *data = g_malloc (sie->data_size);
-	gssize read = g_input_stream_read (stream,
-		data, sie->data_size, NULL, &error);
+	gssize read = dictzip_input_stream_read_at (stream,
+		data, sie->data_size, sie->data_offset, &error);
 	if (read < sie->data_size)
 	{
 		if (error)
@@ -1232,39 +3889,64 @@ read_entry_data_from_stream
 	return data;
 }
 
-/// Return the data for the specified offset in the index.  Unsafe.
-static StardictEntry *
-stardict_dict_get_entry (StardictDict *sd, guint32 offset)
+/// Return raw data for the specified offset in the index.  Unsafe.
+/// The result needs to be freed if and only if the dictionary uses a stream.
+/// The decoded index entry is stored in @a sie.
+static gchar *
+stardict_dict_get_entry_data (StardictDict *sd, guint32 offset,
+	StardictIndexEntry *sie)
 {
-	// TODO maybe cache the entries, maybe don't hide the errors (also above)
 	StardictDictPrivate *priv = sd->priv;
-	StardictIndexEntry *sie = &g_array_index (priv->index,
-		StardictIndexEntry, offset);
-	GError *error = NULL;
-
-	gchar *data;
+	stardict_dict_index_entry (sd, offset, sie);
 	if (priv->dict_stream)
+		return read_entry_data_from_stream
+			(DICTZIP_INPUT_STREAM (priv->dict_stream), offset, sie);
+
+	if (sie->data_offset + sie->data_size > priv->dict_length)
 	{
-		data = read_entry_data_from_stream (priv->dict_stream, offset, sie);
-		if (!data)
-			return NULL;
-	}
-	else
-	{
-		if (sie->data_offset + sie->data_size > priv->dict_length)
-		{
-			g_debug ("overflowing entry #%" G_GUINT32_FORMAT, offset);
-			return NULL;
-		}
-		data = priv->dict + sie->data_offset;
+		g_debug ("overflowing entry #%" G_GUINT32_FORMAT, offset);
+		return NULL;
 	}
+	return (gchar *) priv->dict + sie->data_offset;
+}
+
+/// Account for reading an entry, which has started at @a start,
+/// and the data of which has been retrieved at @a read.
+static void
+stardict_dict_record_entry (StardictDict *sd, gint64 start, gint64 read)
+{
+	gint64 now = g_get_monotonic_time ();
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->stats_lock);
+	priv->stats.entries_read++;
+	priv->stats.entry_read_time += read - start;
+	priv->stats.entry_parse_time += now - read;
+	g_mutex_unlock (&priv->stats_lock);
+}
+
+/// Read and decode the data for the specified offset in the index.  Unsafe.
+static StardictEntry *
+stardict_dict_decode_entry (StardictDict *sd, guint32 offset)
+{
+	// TODO maybe don't hide the errors (also above)
+	StardictDictPrivate *priv = sd->priv;
+	GError *error = NULL;
+
+	gint64 start = g_get_monotonic_time ();
+	StardictIndexEntry sie;
+	gchar *data = stardict_dict_get_entry_data (sd, offset, &sie);
+	if (!data)
+		return NULL;
 
+	gint64 read = g_get_monotonic_time ();
 	GList *entries;
 	if (priv->info->same_type_sequence)
-		entries = read_entries_sts (data, sie->data_size,
+		entries = read_entries_sts (data, sie.data_size,
 			priv->info->same_type_sequence, &error);
 	else
-		entries = read_entries (data, sie->data_size, &error);
+		entries = read_entries (data, sie.data_size, &error);
+	stardict_dict_record_entry (sd, start, read);
 
 	if (error)
 	{
@@ -1282,6 +3964,143 @@ stardict_dict_get_entry (StardictDict *sd, guint32 offset)
 	return se;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static gsize
+entry_cache_item_size (StardictEntry *entry)
+{
+	gsize size = sizeof (EntryCacheItem) + sizeof *entry;
+	for (const GList *iter = entry->fields; iter; iter = iter->next)
+	{
+		const StardictEntryField *field = iter->data;
+		size += sizeof *iter + sizeof *field + field->data_size;
+	}
+	return size;
+}
+
+static void
+stardict_dict_entry_cache_trim_locked (StardictDict *sd)
+{
+	StardictDictPrivate *priv = sd->priv;
+	while (priv->entry_cache_size > priv->entry_cache_limit)
+	{
+		EntryCacheItem *item = priv->entry_cache_lru.tail->data;
+		g_queue_unlink (&priv->entry_cache_lru, &item->link);
+		priv->entry_cache_size -= item->size;
+		priv->entry_cache_evictions++;
+		g_hash_table_remove (priv->entry_cache, GUINT_TO_POINTER (item->offset));
+	}
+}
+
+/// Return the entry for the specified offset in the index.  Unsafe.
+/// This only reads shared state, so it may be called from multiple threads.
+/// Entries may be shared with other callers, and must not be modified.
+static StardictEntry *
+stardict_dict_get_entry (StardictDict *sd, guint32 offset)
+{
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->entry_cache_lock);
+	EntryCacheItem *item =
+		g_hash_table_lookup (priv->entry_cache, GUINT_TO_POINTER (offset));
+	if (item)
+	{
+		g_queue_unlink (&priv->entry_cache_lru, &item->link);
+		g_queue_push_head_link (&priv->entry_cache_lru, &item->link);
+		priv->entry_cache_hits++;
+
+		StardictEntry *entry = g_object_ref (item->entry);
+		g_mutex_unlock (&priv->entry_cache_lock);
+		return entry;
+	}
+	priv->entry_cache_misses++;
+	g_mutex_unlock (&priv->entry_cache_lock);
+
+	// Decoding may take a while, so don't block other readers meanwhile
+	StardictEntry *entry = stardict_dict_decode_entry (sd, offset);
+	if (!entry)
+		return NULL;
+
+	gsize size = entry_cache_item_size (entry);
+	g_mutex_lock (&priv->entry_cache_lock);
+	if (size <= priv->entry_cache_limit && !g_hash_table_contains
+		(priv->entry_cache, GUINT_TO_POINTER (offset)))
+	{
+		item = g_slice_new0 (EntryCacheItem);
+		item->link.data = item;
+		item->offset = offset;
+		item->entry = g_object_ref (entry);
+		item->size = size;
+
+		g_hash_table_insert (priv->entry_cache,
+			GUINT_TO_POINTER (offset), item);
+		g_queue_push_head_link (&priv->entry_cache_lru, &item->link);
+		priv->entry_cache_size += size;
+		stardict_dict_entry_cache_trim_locked (sd);
+	}
+	g_mutex_unlock (&priv->entry_cache_lock);
+	return entry;
+}
+
+/// Limit the total size of decoded entries kept by the dictionary.
+/// Zero disables the cache, which is useful for sequential processing.
+void
+stardict_dict_set_entry_cache_limit (StardictDict *sd, gsize limit)
+{
+	g_return_if_fail (STARDICT_IS_DICT (sd));
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->entry_cache_lock);
+	priv->entry_cache_limit = limit;
+	stardict_dict_entry_cache_trim_locked (sd);
+	g_mutex_unlock (&priv->entry_cache_lock);
+}
+
+/// Retrieve statistics about the dictionary's entry cache.
+void
+stardict_dict_get_entry_cache_stats (StardictDict *sd,
+	StardictEntryCacheStats *stats)
+{
+	g_return_if_fail (STARDICT_IS_DICT (sd));
+	g_return_if_fail (stats != NULL);
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->entry_cache_lock);
+	stats->hits      = priv->entry_cache_hits;
+	stats->misses    = priv->entry_cache_misses;
+	stats->evictions = priv->entry_cache_evictions;
+	stats->n_entries = g_hash_table_size (priv->entry_cache);
+	stats->size      = priv->entry_cache_size;
+	stats->limit     = priv->entry_cache_limit;
+	g_mutex_unlock (&priv->entry_cache_lock);
+}
+
+/// Retrieve statistics about the dictionary's operation so far.
+/// Load times are only measured once, when the dictionary is being opened.
+void
+stardict_dict_get_stats (StardictDict *sd, StardictDictStats *stats)
+{
+	g_return_if_fail (STARDICT_IS_DICT (sd));
+	g_return_if_fail (stats != NULL);
+
+	StardictDictPrivate *priv = sd->priv;
+	g_mutex_lock (&priv->stats_lock);
+	*stats = priv->stats;
+	g_mutex_unlock (&priv->stats_lock);
+
+	g_mutex_lock (&priv->load_lock);
+	if (priv->dict_stream)
+	{
+		DictzipInputStreamStats dzs;
+		dictzip_input_stream_get_stats
+			(DICTZIP_INPUT_STREAM (priv->dict_stream), &dzs);
+		stats->chunk_hits     = dzs.hits;
+		stats->chunk_misses   = dzs.misses;
+		stats->chunk_inflated = dzs.inflated;
+	}
+	g_mutex_unlock (&priv->load_lock);
+	stardict_dict_get_entry_cache_stats (sd, &stats->entry_cache);
+}
+
 // --- StardictEntry -----------------------------------------------------------
 
 G_DEFINE_TYPE (StardictEntry, stardict_entry, G_TYPE_OBJECT)
@@ -1307,6 +4126,25 @@ stardict_entry_init (G_GNUC_UNUSED StardictEntry *sde)
 {
 }
 
+/// Prepare a view for use with stardict_iterator_get_entry_view().
+void
+stardict_entry_view_init (StardictEntryView *view)
+{
+	view->fields = g_array_new (FALSE, FALSE, sizeof (StardictEntryField));
+	view->borrowed = TRUE;
+	view->buffer = NULL;
+}
+
+/// Release all resources held by a view.
+void
+stardict_entry_view_clear (StardictEntryView *view)
+{
+	g_array_free (view->fields, TRUE);
+	view->fields = NULL;
+	g_free (view->buffer);
+	view->buffer = NULL;
+}
+
 /// Return the entries present within the entry.
 /// @return GList<StardictEntryField *>
 const GList *
@@ -1325,6 +4163,7 @@ stardict_iterator_finalize (GObject *self)
 {
 	StardictIterator *si = STARDICT_ITERATOR (self);
 
+	stardict_dict_release (si->owner);
 	g_object_unref (si->owner);
 
 	G_OBJECT_CLASS (stardict_iterator_parent_class)->finalize (self);
@@ -1342,6 +4181,7 @@ stardict_iterator_init (G_GNUC_UNUSED StardictIterator *sd)
 }
 
 /// Create a new iterator for the dictionary with offset @a offset.
+/// The dictionary's data stay loaded for as long as the iterator exists.
 StardictIterator *
 stardict_iterator_new (StardictDict *sd, guint32 offset)
 {
@@ -1349,6 +4189,7 @@ stardict_iterator_new (StardictDict *sd, guint32 offset)
 
 	StardictIterator *si = g_object_new (STARDICT_TYPE_ITERATOR, NULL);
 	si->owner = g_object_ref (sd);
+	(void) stardict_dict_acquire (sd, NULL);
 	si->offset = offset;
 	return si;
 }
@@ -1360,8 +4201,7 @@ stardict_iterator_get_word (StardictIterator *sdi)
 	g_return_val_if_fail (STARDICT_IS_ITERATOR (sdi), NULL);
 	if (!stardict_iterator_is_valid (sdi))
 		return NULL;
-	return g_array_index (sdi->owner->priv->index,
-		StardictIndexEntry, sdi->offset).name;
+	return stardict_dict_index_word (sdi->owner, sdi->offset);
 }
 
 /// Return the dictionary entry that the iterator points at, or NULL.
@@ -1374,12 +4214,58 @@ stardict_iterator_get_entry (StardictIterator *sdi)
 	return stardict_dict_get_entry (sdi->owner, sdi->offset);
 }
 
+/// Fill a view with the fields of the current entry, avoiding copies.
+/// Unless the dictionary has to be read through a stream, the fields point
+/// directly into dictionary memory, and remain valid for as long as
+/// the dictionary exists.  Otherwise they point into the view's own buffer,
+/// and are only valid until the view is reused or cleared.
+///
+/// Contrary to StardictEntry, textual fields are not NUL-terminated,
+/// and their length doesn't include the terminator.  The entry cache is
+/// bypassed, making this suitable for processing whole dictionaries.
+gboolean
+stardict_iterator_get_entry_view (StardictIterator *sdi,
+	StardictEntryView *view)
+{
+	g_return_val_if_fail (STARDICT_IS_ITERATOR (sdi), FALSE);
+	g_return_val_if_fail (view != NULL && view->fields != NULL, FALSE);
+
+	g_array_set_size (view->fields, 0);
+	g_free (view->buffer);
+	view->buffer = NULL;
+	if (!stardict_iterator_is_valid (sdi))
+		return FALSE;
+
+	StardictDictPrivate *priv = sdi->owner->priv;
+	StardictIndexEntry sie;
+	gint64 start = g_get_monotonic_time ();
+	gchar *data = stardict_dict_get_entry_data (sdi->owner, sdi->offset, &sie);
+	if (!data)
+		return FALSE;
+
+	view->borrowed = priv->dict_stream == NULL;
+	if (!view->borrowed)
+		view->buffer = data;
+
+	gint64 read = g_get_monotonic_time ();
+	gboolean ok = view_entry_fields (data, sie.data_size,
+		priv->info->same_type_sequence, view->fields);
+	stardict_dict_record_entry (sdi->owner, start, read);
+	if (ok)
+		return TRUE;
+
+	g_debug ("problem processing entry #%" G_GINT64_FORMAT ": %s",
+		sdi->offset, _("invalid data entry"));
+	g_array_set_size (view->fields, 0);
+	return FALSE;
+}
+
 /// Return whether the iterator points to a valid index entry.
 gboolean
 stardict_iterator_is_valid (StardictIterator *sdi)
 {
 	g_return_val_if_fail (STARDICT_IS_ITERATOR (sdi), FALSE);
-	return sdi->offset >= 0 && sdi->offset < sdi->owner->priv->index->len;
+	return sdi->offset >= 0 && sdi->offset < sdi->owner->priv->index_length;
 }
 
 /// Return the offset of the iterator within the dictionary index.
@@ -1398,3 +4284,138 @@ stardict_iterator_set_offset
 	g_return_if_fail (STARDICT_IS_ITERATOR (sdi));
 	sdi->offset = relative ? sdi->offset + offset : offset;
 }
+
+// --- StardictScan ------------------------------------------------------------
+
+// Going through entries in index order means jumping around the dictionary
+// file, as soon as the index has been collated.  Callers which don't need
+// that order may rather go in the order of data, and either way, upcoming
+// dictzip chunks are inflated in the background, ahead of the consumer.
+
+/// How much entry data to keep prefetched ahead of the current entry
+#define STARDICT_SCAN_READ_AHEAD  (1 << 20)
+
+struct stardict_scan
+{
+	StardictIterator * iterator;        ///< Points to the current entry
+	guint32          * order;           ///< Index positions in data order
+	guint32            begin;           ///< The first entry to go through
+	guint32            end;             ///< Past the last entry
+	guint32            next;            ///< The next entry, relative
+	guint32            prefetched;      ///< Past the last prefetched entry
+	guint64            read_ahead;      ///< Amount of data prefetched ahead
+};
+
+typedef struct scan_item ScanItem;
+
+struct scan_item
+{
+	guint64            data_offset;     ///< Offset of the definition
+	guint32            position;        ///< Index position of the entry
+};
+
+static gint
+scan_item_cmp (gconstpointer a, gconstpointer b)
+{
+	const ScanItem *ia = a, *ib = b;
+	if (ia->data_offset != ib->data_offset)
+		return ia->data_offset < ib->data_offset ? -1 : 1;
+	return (ia->position > ib->position) - (ia->position < ib->position);
+}
+
+/// Start going through index entries from @a begin up to @a end,
+/// either in index order, or in the order of their data in the dictionary.
+/// The latter is preferable for passes over all entries.
+/// The range is clipped to the index, and may end up empty.
+StardictScan *
+stardict_scan_new (StardictDict *sd, guint32 begin, guint32 end,
+	gboolean data_order)
+{
+	g_return_val_if_fail (STARDICT_IS_DICT (sd), NULL);
+	g_return_val_if_fail (begin <= end, NULL);
+
+	StardictScan *self = g_slice_new0 (StardictScan);
+	self->end = MIN (end, sd->priv->index_length);
+	self->begin = MIN (begin, self->end);
+	self->iterator = stardict_iterator_new (sd, self->begin);
+	if (!data_order || self->begin >= self->end)
+		return self;
+
+	guint32 n = self->end - self->begin;
+	ScanItem *items = g_new (ScanItem, n);
+	for (guint32 i = 0; i < n; i++)
+	{
+		StardictIndexEntry sie;
+		stardict_dict_index_entry (sd, self->begin + i, &sie);
+		items[i].data_offset = sie.data_offset;
+		items[i].position = self->begin + i;
+	}
+	qsort (items, n, sizeof *items, scan_item_cmp);
+
+	self->order = g_new (guint32, n);
+	for (guint32 i = 0; i < n; i++)
+		self->order[i] = items[i].position;
+	g_free (items);
+	return self;
+}
+
+void
+stardict_scan_free (StardictScan *self)
+{
+	g_object_unref (self->iterator);
+	g_free (self->order);
+	g_slice_free (StardictScan, self);
+}
+
+static guint32
+stardict_scan_position (StardictScan *self, guint32 i)
+{
+	return self->order ? self->order[i] : self->begin + i;
+}
+
+/// Make sure that data of upcoming entries are being inflated.
+static void
+stardict_scan_prefetch (StardictScan *self, DictzipInputStream *dzis)
+{
+	StardictDict *sd = self->iterator->owner;
+	guint32 n = self->end - self->begin;
+	while (self->prefetched < n
+		&& self->read_ahead < STARDICT_SCAN_READ_AHEAD)
+	{
+		StardictIndexEntry sie;
+		stardict_dict_index_entry (sd,
+			stardict_scan_position (self, self->prefetched++), &sie);
+		dictzip_input_stream_prefetch (dzis, sie.data_offset, sie.data_size);
+		self->read_ahead += sie.data_size;
+	}
+}
+
+/// Move on to the next entry.  Returns an iterator pointing to it, owned by
+/// the scan, or NULL once all entries have been gone through.
+StardictIterator *
+stardict_scan_next (StardictScan *self)
+{
+	StardictDict *sd = self->iterator->owner;
+	if (self->next >= self->end - self->begin)
+		return NULL;
+
+	guint32 position = stardict_scan_position (self, self->next++);
+	stardict_iterator_set_offset (self->iterator, position, FALSE);
+
+	GInputStream *stream = sd->priv->dict_stream;
+	if (stream && DICTZIP_IS_INPUT_STREAM (stream))
+	{
+		// The current entry is being consumed, so it no longer counts
+		if (self->next <= self->prefetched)
+		{
+			StardictIndexEntry sie;
+			stardict_dict_index_entry (sd, position, &sie);
+			self->read_ahead -= MIN (self->read_ahead, sie.data_size);
+		}
+		else
+			self->prefetched = self->next;
+
+		stardict_scan_prefetch (self, DICTZIP_INPUT_STREAM (stream));
+	}
+	return self->iterator;
+}
@@ -39,9 +39,18 @@ typedef struct stardict_iterator_class  StardictIteratorClass;
 typedef struct stardict_entry           StardictEntry;
 typedef struct stardict_entry_class     StardictEntryClass;
 
+/// Keeps state between successive searches for type-ahead.
+typedef struct stardict_search          StardictSearch;
+
+/// Goes through many entries at once, reading ahead.
+typedef struct stardict_scan            StardictScan;
+
 /// A single field of a word definition.
 typedef struct stardict_entry_field     StardictEntryField;
 
+/// Fields of a word definition, borrowed from the dictionary.
+typedef struct stardict_entry_view      StardictEntryView;
+
 // GObject boilerplate.
 #define STARDICT_TYPE_DICT  (stardict_dict_get_type ())
 #define STARDICT_DICT(obj) \
@@ -129,17 +138,89 @@ struct stardict_dict_class
 	GObjectClass           parent_class;
 };
 
+/// Statistics of a dictionary's cache of decoded entries
+typedef struct stardict_entry_cache_stats StardictEntryCacheStats;
+
+struct stardict_entry_cache_stats
+{
+	guint64         hits;               ///< Entries found within the cache
+	guint64         misses;             ///< Entries that had to be decoded
+	guint64         evictions;          ///< Entries dropped to fit the limit
+	guint           n_entries;          ///< Number of cached entries
+	gsize           size;               ///< Current size of all entries
+	gsize           limit;              ///< Maximum size of all entries
+};
+
+/// The number of buckets in the search latency histogram.  Bucket i counts
+/// searches that took less than 2^i microseconds, and the last one also
+/// counts all slower searches.
+#define STARDICT_SEARCH_LATENCY_BUCKETS  16
+
+/// Statistics of a dictionary's operation, all times are in microseconds
+typedef struct stardict_dict_stats        StardictDictStats;
+
+struct stardict_dict_stats
+{
+	gint64          load_idx_time;      ///< Loading the index
+	gint64          load_dict_time;     ///< Opening dictionary data
+	gint64          load_syn_time;      ///< Loading synonyms
+	gint64          load_collation_time;    ///< Preparing index tables
+
+	guint64         searches;           ///< Searches made
+	guint64         search_time;        ///< Time spent searching
+	guint64         search_comparisons; ///< Index comparisons in searches
+	guint64         search_latency[STARDICT_SEARCH_LATENCY_BUCKETS];
+	                                    ///< Histogram of search times
+
+	guint64         entries_read;       ///< Entries read from the data
+	guint64         entry_read_time;    ///< Time spent reading entry data
+	guint64         entry_parse_time;   ///< Time spent parsing entry data
+
+	guint64         chunk_hits;         ///< Dictzip chunks found cached
+	guint64         chunk_misses;       ///< Dictzip chunks to be inflated
+	guint64         chunk_inflated;     ///< Bytes inflated, with read-ahead
+
+	StardictEntryCacheStats entry_cache;    ///< Cache of decoded entries
+};
+
 GType stardict_dict_get_type (void);
 StardictDict *stardict_dict_new (const gchar *filename, GError **error);
 StardictDict *stardict_dict_new_from_info (StardictInfo *sdi, GError **error);
+StardictDict *stardict_dict_new_deferred (StardictInfo *sdi);
 StardictInfo *stardict_dict_get_info (StardictDict *sd);
+gboolean stardict_dict_load (StardictDict *sd, GError **error);
+gboolean stardict_dict_is_loaded (StardictDict *sd);
+gboolean stardict_dict_unload (StardictDict *sd);
+gint64 stardict_dict_get_last_used (StardictDict *sd);
+gsize stardict_dict_get_memory_size (StardictDict *sd);
 gchar **stardict_dict_get_synonyms (StardictDict *sd, const gchar *word);
+gint stardict_dict_compare_words
+	(StardictDict *sd, const gchar *w1, const gchar *w2);
 StardictIterator *stardict_dict_search
 	(StardictDict *sd, const gchar *word, gboolean *success);
 
+void stardict_dict_set_entry_cache_limit (StardictDict *sd, gsize limit);
+void stardict_dict_get_entry_cache_stats
+	(StardictDict *sd, StardictEntryCacheStats *stats);
+void stardict_dict_get_stats (StardictDict *sd, StardictDictStats *stats);
+
+StardictSearch *stardict_search_new (StardictDict *sd);
+void stardict_search_free (StardictSearch *self);
+StardictDict *stardict_search_get_dict (StardictSearch *self);
+StardictIterator *stardict_search_update
+	(StardictSearch *self, const gchar *word, gboolean *success);
+
 size_t stardict_longest_common_collation_prefix
 	(StardictDict *sd, const gchar *w1, const gchar *w2);
 
+void stardict_dict_build_fuzzy_index (StardictDict *sd, gboolean wait);
+GArray *stardict_dict_fuzzy_search
+	(StardictDict *sd, const gchar *word, guint limit);
+
+gboolean stardict_dict_build_fulltext_index (StardictDict *sd, GError **error);
+GArray *stardict_dict_search_fulltext
+	(StardictDict *sd, const gchar *query, GError **error);
+
 // --- Dictionary iterators ----------------------------------------------------
 
 struct stardict_iterator
@@ -158,6 +239,8 @@ GType stardict_iterator_get_type (void);
 StardictIterator *stardict_iterator_new (StardictDict *sd, guint32 index);
 const gchar *stardict_iterator_get_word (StardictIterator *sdi) G_GNUC_PURE;
 StardictEntry *stardict_iterator_get_entry (StardictIterator *sdi);
+gboolean stardict_iterator_get_entry_view
+	(StardictIterator *sdi, StardictEntryView *view);
 gboolean stardict_iterator_is_valid (StardictIterator *sdi) G_GNUC_PURE;
 gint64 stardict_iterator_get_offset (StardictIterator *sdi) G_GNUC_PURE;
 void stardict_iterator_set_offset
@@ -171,6 +254,13 @@ void stardict_iterator_set_offset
 #define stardict_iterator_prev(sdi) \
 	(stardict_iterator_set_offset (sdi, -1, TRUE))
 
+// --- Sequential scans --------------------------------------------------------
+
+StardictScan *stardict_scan_new (StardictDict *sd,
+	guint32 begin, guint32 end, gboolean data_order);
+void stardict_scan_free (StardictScan *self);
+StardictIterator *stardict_scan_next (StardictScan *self);
+
 // --- Dictionary entries ------------------------------------------------------
 
 typedef enum {
@@ -210,4 +300,15 @@ struct stardict_entry_class
 GType stardict_entry_get_type (void);
 const GList *stardict_entry_get_fields (StardictEntry *sde) G_GNUC_PURE;
 
+/// Borrowed fields of an entry, see stardict_iterator_get_entry_view()
+struct stardict_entry_view
+{
+	GArray        * fields;             ///< Array of StardictEntryField-s
+	gboolean        borrowed;           ///< Fields point into the dictionary
+	gchar         * buffer;             ///< Entry data owned by the view
+};
+
+void stardict_entry_view_init (StardictEntryView *view);
+void stardict_entry_view_clear (StardictEntryView *view);
+
 #endif  // ! STARDICT_H
@@ -24,7 +24,10 @@
 #include <string.h>
 #include <errno.h>
 
+#include <unistd.h>
+
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 
 #include "stardict.h"
@@ -35,45 +38,191 @@
 
 // --- Pronunciation generator -------------------------------------------------
 
-typedef struct worker_data WorkerData;
+// Entries go through a pipeline: they are read ahead of time by a producer
+// thread, pronounced in batches by a number of workers, each running its own
+// eSpeak processes, and written out in their original order by the main thread.
+// Only a limited number of batches may exist at any time, so that the whole
+// dictionary never ends up in memory.
+
+/// eSpeak splits the output on certain characters.
+#define LINE_SPLITTING_CHARS            ".,:;?!"
+
+/// We don't want to include brackets either.
+#define OTHER_STOP_CHARS                "([{<"
+
+/// A void word used to make a unique "no pronunciation available" mark.
+#define VOID_ENTRY                      "not present in any dictionary"
+
+/// The number of entries pronounced by a single eSpeak process.
+#define BATCH_SIZE                      1024
+
+/// How many batches may be in the pipeline per worker.
+#define BATCHES_PER_WORKER              3
+
+typedef struct batch Batch;
+
+/// A contiguous sequence of entries to be pronounced.
+struct batch
+{
+	guint32 sequence;                   ///< Position of the batch
+	GPtrArray *words;                   ///< Words of the entries
+	GPtrArray *entries;                 ///< StardictEntry objects or NULL
+	GPtrArray *pronunciations;          ///< Results, in the same order
+};
+
+/// Tells workers that there is nothing more to do.
+static Batch end_of_input;
+
+static void
+entry_free (gpointer entry)
+{
+	if (entry)
+		g_object_unref (entry);
+}
+
+static Batch *
+batch_new (guint32 sequence)
+{
+	Batch *self = g_slice_new (Batch);
+	self->sequence = sequence;
+	self->words = g_ptr_array_new_with_free_func (g_free);
+	self->entries = g_ptr_array_new_with_free_func (entry_free);
+	self->pronunciations = g_ptr_array_new_with_free_func (g_free);
+	return self;
+}
+
+static void
+batch_free (Batch *self)
+{
+	g_ptr_array_free (self->words, TRUE);
+	g_ptr_array_free (self->entries, TRUE);
+	g_ptr_array_free (self->pronunciations, TRUE);
+	g_slice_free (Batch, self);
+}
+
+typedef struct pipeline Pipeline;
 
-struct worker_data
+struct pipeline
 {
+	StardictDict *dict;                 ///< The dictionary object
+	guint n_workers;                    ///< Number of worker threads
+
 	gchar **cmdline;                    ///< eSpeak command line
 	guint ignore_acronyms : 1;          ///< Don't spell out acronyms
 	GRegex *re_stop;                    ///< Regex for stop sequences
 	GRegex *re_acronym;                 ///< Regex for ACRONYMS
 
-	guint32 start_entry;                ///< The first entry to be processed
-	guint32 end_entry;                  ///< Past the last entry to be processed
+	FILE *journal;                      ///< Pronunciations from before or NULL
+	GMutex journal_mutex;               ///< Locks @a known and @a known_end
+	guint32 known;                      ///< How many entries the journal has
+	off_t known_end;                    ///< Where they end within the journal
 
-	// Reader, writer
-	GMutex *dict_mutex;                 ///< Locks the dictionary object
+	GAsyncQueue *todo;                  ///< Batches to be pronounced
+	GAsyncQueue *done;                  ///< Batches to be written out
 
-	// Reader
-	GThread *main_thread;               ///< A handle to the reader thread
-	StardictDict *dict;                 ///< The dictionary object
-	gpointer output;                    ///< Linked-list of pronunciation data
+	GMutex slots_mutex;                 ///< Locks @a slots
+	GCond slots_cond;                   ///< Signals a freed slot
+	guint slots;                        ///< How many batches may be created
+};
 
-	GMutex *remaining_mutex;            ///< Locks the progress stats
-	GCond *remaining_cond;              ///< Signals a change in progress
-	guint32 remaining;                  ///< How many entries remain
-	guint32 total;                      ///< Total number of entries
+static void
+pipeline_acquire_slot (Pipeline *self)
+{
+	g_mutex_lock (&self->slots_mutex);
+	while (!self->slots)
+		g_cond_wait (&self->slots_cond, &self->slots_mutex);
+	self->slots--;
+	g_mutex_unlock (&self->slots_mutex);
+}
 
-	// Writer
-	StardictIterator *iterator;         ///< Iterates over the dictionary
-	FILE *child_stdin;                  ///< Standard input of eSpeak
-};
+static void
+pipeline_release_slot (Pipeline *self)
+{
+	g_mutex_lock (&self->slots_mutex);
+	self->slots++;
+	g_cond_signal (&self->slots_cond);
+	g_mutex_unlock (&self->slots_mutex);
+}
 
-/// eSpeak splits the output on certain characters.
-#define LINE_SPLITTING_CHARS            ".,:;?!"
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-/// We don't want to include brackets either.
-#define OTHER_STOP_CHARS                "([{<"
+/// Reads pronunciations of a batch from the journal, which follow
+/// those of the @a preceding number of entries.
+static gboolean
+producer_read_journal (Pipeline *self, Batch *batch, guint32 preceding)
+{
+	off_t start = ftello (self->journal);
+	gchar *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	while (batch->pronunciations->len < batch->words->len
+		&& (len = getline (&line, &size, self->journal)) > 0
+		&& line[len - 1] == '\n')
+	{
+		line[len - 1] = 0;
+		g_ptr_array_add (batch->pronunciations, g_strdup (line));
+	}
+	free (line);
+	if (batch->pronunciations->len == batch->words->len)
+		return TRUE;
+
+	// It has been checked before, so this shouldn't really happen.
+	// The writer will cut the journal off here, to append to it afresh.
+	g_printerr ("Warning: the journal is unreadable, ignoring the rest\n");
+	g_ptr_array_set_size (batch->pronunciations, 0);
+
+	g_mutex_lock (&self->journal_mutex);
+	self->known = preceding;
+	self->known_end = start;
+	g_mutex_unlock (&self->journal_mutex);
+	return FALSE;
+}
 
-/// A void word used to make a unique "no pronunciation available" mark.
-#define VOID_ENTRY                      "not present in any dictionary"
+/// Reads entries from the dictionary ahead of the workers.
+static gpointer
+producer (Pipeline *self)
+{
+	StardictScan *scan = stardict_scan_new (self->dict, 0, G_MAXUINT32, FALSE);
+	StardictIterator *iterator = stardict_scan_next (scan);
 
+	guint32 sequence = 0, position = 0;
+	while (iterator)
+	{
+		pipeline_acquire_slot (self);
+
+		Batch *batch = batch_new (sequence++);
+		for (; iterator && batch->words->len < BATCH_SIZE;
+			iterator = stardict_scan_next (scan))
+		{
+			g_ptr_array_add (batch->words,
+				g_strdup (stardict_iterator_get_word (iterator)));
+			g_ptr_array_add (batch->entries,
+				stardict_iterator_get_entry (iterator));
+		}
+
+		guint32 preceding = position;
+		position += batch->words->len;
+
+		g_mutex_lock (&self->journal_mutex);
+		gboolean known = position <= self->known;
+		g_mutex_unlock (&self->journal_mutex);
+
+		if (known && producer_read_journal (self, batch, preceding))
+			g_async_queue_push (self->done, batch);
+		else
+			g_async_queue_push (self->todo, batch);
+	}
+	stardict_scan_free (scan);
+
+	for (guint i = 0; i < self->n_workers; i++)
+		g_async_queue_push (self->todo, &end_of_input);
+
+	// An empty batch tells the writer how many batches there are
+	g_async_queue_push (self->done, batch_new (sequence));
+	return NULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 /// Adds dots between characters.
 static gboolean
@@ -98,65 +247,133 @@ writer_acronym_cb (const GMatchInfo *info, GString *res,
 	return FALSE;
 }
 
-/// Writes to espeak's stdin.
-static gpointer
-worker_writer (WorkerData *data)
+/// Turns a word into something that eSpeak pronounces reasonably.
+static gchar *
+worker_prepare_word (Pipeline *self, const gchar *word)
 {
 	GError *error = NULL;
 	GMatchInfo *match_info;
-	while (stardict_iterator_get_offset (data->iterator) != data->end_entry)
+
+	word += strspn (word, LINE_SPLITTING_CHARS " \t");
+	gchar *x = g_strdup (word);
+
+	// Cut the word if needed be
+	if (g_regex_match_full (self->re_stop,
+		x, -1, 0, 0, &match_info, &error))
 	{
-		g_mutex_lock (data->dict_mutex);
-		const gchar *word = stardict_iterator_get_word (data->iterator);
-		g_mutex_unlock (data->dict_mutex);
+		gint start_pos;
+		g_match_info_fetch_pos (match_info, 0, &start_pos, NULL);
+		x[start_pos] = 0;
+	}
+	g_match_info_free (match_info);
 
-		word += strspn (word, LINE_SPLITTING_CHARS " \t");
-		gchar *x = g_strdup (word);
+	// Change acronyms so that they're not pronounced as words
+	if (!error && !self->ignore_acronyms)
+	{
+		char *tmp = g_regex_replace_eval (self->re_acronym,
+			x, -1, 0, 0, writer_acronym_cb, NULL, &error);
+		g_free (x);
+		x = tmp;
+	}
 
-		// Cut the word if needed be
-		error = NULL;
-		if (g_regex_match_full (data->re_stop,
-			x, -1, 0, 0, &match_info, &error))
-		{
-			gint start_pos;
-			g_match_info_fetch_pos (match_info, 0, &start_pos, NULL);
-			x[start_pos] = 0;
-		}
-		g_match_info_free (match_info);
+	if (error)
+	{
+		g_printerr ("Notice: error processing '%s': %s\n",
+			word, error->message);
+		g_clear_error (&error);
+		*x = 0;
+	}
 
-		// Change acronyms so that they're not pronounced as words
-		if (!error && !data->ignore_acronyms)
-		{
-			char *tmp = g_regex_replace_eval (data->re_acronym,
-				x, -1, 0, 0, writer_acronym_cb, NULL, &error);
-			g_free (x);
-			x = tmp;
-		}
+	// We might have accidentally cut off everything
+	if (!*x)
+	{
+		g_free (x);
+		x = g_strdup (VOID_ENTRY);
+	}
+	return x;
+}
 
-		if (error)
-		{
-			g_printerr ("Notice: error processing '%s': %s\n",
-				word, error->message);
-			g_clear_error (&error);
-			*x = 0;
-		}
+typedef struct feed Feed;
 
-		// We might have accidentally cut off everything
-		if (!*x)
-		{
-			g_free (x);
-			x = g_strdup (VOID_ENTRY);
-		}
+struct feed
+{
+	FILE *child_stdin;                  ///< Standard input of eSpeak
+	GString *input;                     ///< All the words to pronounce
+};
 
-		stardict_iterator_next (data->iterator);
-		if (fprintf (data->child_stdin, "%s\n", x) < 0)
-			fatal ("write to eSpeak failed: %s\n", g_strerror (errno));
+/// Writes to espeak's stdin.
+static gpointer
+worker_feed (Feed *feed)
+{
+	if (fwrite (feed->input->str, 1, feed->input->len, feed->child_stdin)
+			!= feed->input->len
+	 || fclose (feed->child_stdin))
+		fatal ("write to eSpeak failed: %s\n", g_strerror (errno));
+	return NULL;
+}
 
+/// Retrieves pronunciation for all words in the batch from a new eSpeak
+/// process.  It only needs to be fed and read from concurrently, as we can't
+/// rely on it flushing its output for each line.
+static void
+worker_pronounce (Pipeline *self, Batch *batch)
+{
+	Feed feed = { .input = g_string_new (NULL) };
+	for (guint i = 0; i < batch->words->len; i++)
+	{
+		gchar *x = worker_prepare_word (self,
+			g_ptr_array_index (batch->words, i));
+		g_string_append (feed.input, x);
+		g_string_append_c (feed.input, '\n');
 		g_free (x);
 	}
 
-	g_object_unref (data->iterator);
-	return GINT_TO_POINTER (fclose (data->child_stdin));
+	GError *error = NULL;
+	gint child_in, child_out;
+	if (!g_spawn_async_with_pipes (NULL, self->cmdline, NULL,
+		G_SPAWN_SEARCH_PATH, NULL, NULL,
+		NULL, &child_in, &child_out, NULL, &error))
+		fatal ("g_spawn: %s\n", error->message);
+
+	if (!(feed.child_stdin = fdopen (child_in, "wb")))
+		fatal ("fdopen: %s\n", g_strerror (errno));
+
+	FILE *child_stdout = fdopen (child_out, "rb");
+	if (!child_stdout)
+		fatal ("fdopen: %s\n", g_strerror (errno));
+
+	GThread *feeder = g_thread_new ("feeder", (GThreadFunc) worker_feed, &feed);
+
+	gchar *line = NULL;
+	size_t size = 0;
+	while (batch->pronunciations->len < batch->words->len)
+	{
+		if (getline (&line, &size, child_stdout) < 0)
+			fatal ("eSpeak process died too soon\n");
+		g_ptr_array_add (batch->pronunciations, g_strdup (g_strstrip (line)));
+	}
+	free (line);
+
+	if (fgetc (child_stdout) != EOF)
+		fatal ("Error: eSpeak has written more lines than it should. "
+			"The output would be corrupt, aborting.\n");
+
+	fclose (child_stdout);
+	g_thread_join (feeder);
+	g_string_free (feed.input, TRUE);
+}
+
+/// Pronounces batches until there are none left.
+static gpointer
+worker (Pipeline *self)
+{
+	Batch *batch;
+	while ((batch = g_async_queue_pop (self->todo)) != &end_of_input)
+	{
+		worker_pronounce (self, batch);
+		g_async_queue_push (self->done, batch);
+	}
+	return NULL;
 }
 
 /// Get the void entry (and test if espeak works).
@@ -178,77 +395,198 @@ get_void_entry (gchar *cmdline[])
 	return output;
 }
 
-/// Reads from espeak's stdout.
-static gpointer
-worker (WorkerData *data)
-{
-	// Spawn eSpeak
-	GError *error = NULL;
-	gint child_in, child_out;
-	if (!g_spawn_async_with_pipes (NULL, data->cmdline, NULL,
-		G_SPAWN_SEARCH_PATH, NULL, NULL,
-		NULL, &child_in, &child_out, NULL, &error))
-		fatal ("g_spawn: %s\n", error->message);
+// --- Journal -----------------------------------------------------------------
 
-	data->child_stdin = fdopen (child_in, "wb");
-	if (!data->child_stdin)
-		perror ("fdopen");
+// Retrieved pronunciations are appended to a journal file, one per line,
+// in whole batches, so that an interrupted run can pick up where it left off.
+// Its first line identifies the input and the settings that the pronunciations
+// depend on.
 
-	FILE *child_stdout = fdopen (child_out, "rb");
-	if (!child_stdout)
-		perror ("fdopen");
+/// Identifies a file of the input dictionary by its size and modification time.
+static void
+journal_describe_file (GString *header, const gchar *base, const gchar *suffix)
+{
+	gchar *path = g_strconcat (base, suffix, NULL);
+	GStatBuf st;
+	if (g_stat (path, &st))
+		g_string_append (header, "\t-");
+	else
+		g_string_append_printf (header, "\t%" G_GUINT64_FORMAT
+			":%" G_GINT64_FORMAT, (guint64) st.st_size, (gint64) st.st_mtime);
+	g_free (path);
+}
 
-	// Spawn a writer thread
-	g_mutex_lock (data->dict_mutex);
-	data->iterator = stardict_iterator_new (data->dict, data->start_entry);
-	g_mutex_unlock (data->dict_mutex);
+/// Makes the journal's header line for the given input and settings.
+static gchar *
+journal_make_header (const gchar *ifo_path, StardictDict *dict,
+	const gchar *voice, gboolean ignore_acronyms)
+{
+	gchar *escaped = g_strescape (ifo_path, NULL);
+	GString *header = g_string_new (NULL);
+	g_string_printf (header, "%s\t%lu\t%s\t%s", escaped,
+		(gulong) stardict_info_get_word_count (stardict_dict_get_info (dict)),
+		voice ? voice : "", ignore_acronyms ? "ignore-acronyms" : "");
+	g_free (escaped);
+
+	// The same way the library looks for them
+	const gchar *dot = strrchr (ifo_path, '.');
+	gchar *base = dot ? g_strndup (ifo_path, dot - ifo_path)
+		: g_strdup (ifo_path);
+	static const gchar *suffixes[] = { ".idx", ".idx.gz", ".dict", ".dict.dz" };
+	for (gsize i = 0; i < G_N_ELEMENTS (suffixes); i++)
+		journal_describe_file (header, base, suffixes[i]);
+	g_free (base);
+
+	g_string_append_c (header, '\n');
+	return g_string_free (header, FALSE);
+}
 
-	GThread *writer = g_thread_new ("write worker",
-		(GThreadFunc) worker_writer, data);
+/// Opens the journal for appending, and another handle for reading it
+/// from the start, if it has anything to offer.  Returns the number of
+/// entries that it covers, and where they end.
+static guint32
+journal_open (const gchar *path, const gchar *header,
+	FILE **reader, FILE **writer, off_t *known_end)
+{
+	FILE *fp = fopen (path, "r+b");
+	if (!fp && !(fp = fopen (path, "w+b")))
+		fatal ("%s: %s\n", path, g_strerror (errno));
+
+	gchar *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	guint32 lines = 0, known = 0;
+	off_t end = 0;
+	if (getline (&line, &size, fp) >= 0 && !strcmp (line, header))
+	{
+		end = ftello (fp);
+		while ((len = getline (&line, &size, fp)) > 0 && line[len - 1] == '\n')
+			if (++lines % BATCH_SIZE == 0)
+			{
+				known = lines;
+				end = ftello (fp);
+			}
+	}
+	free (line);
+
+	// Cut off anything incomplete or foreign
+	if (fseeko (fp, end, SEEK_SET) || ftruncate (fileno (fp), end)
+	 || (!end && fputs (header, fp) < 0) || fflush (fp))
+		fatal ("%s: %s\n", path, g_strerror (errno));
+
+	*writer = fp;
+	*reader = NULL;
+	*known_end = end;
+	if (!known)
+		return 0;
+
+	if (!(*reader = fopen (path, "rb")))
+		fatal ("%s: %s\n", path, g_strerror (errno));
+
+	// Skip the header
+	gint c;
+	while ((c = fgetc (*reader)) != EOF && c != '\n')
+		;
+	return known;
+}
 
-	// Read the output
-	g_mutex_lock (data->remaining_mutex);
-	guint32 remaining = data->remaining;
-	g_mutex_unlock (data->remaining_mutex);
+// --- Main --------------------------------------------------------------------
 
-	data->output = NULL;
-	gpointer *output_end = &data->output;
-	while (remaining)
+/// Writes a single batch to the new dictionary.
+static void
+write_batch (Batch *batch, Generator *generator,
+	const gchar *void_entry, FILE *journal)
+{
+	for (guint i = 0; i < batch->words->len; i++)
 	{
-		static gchar next[sizeof (gpointer)];
-		GString *s = g_string_new (NULL);
-		g_string_append_len (s, next, sizeof next);
-
-		gint c;
-		while ((c = fgetc (child_stdout)) != EOF && c != '\n')
-			g_string_append_c (s, c);
-		if (c == EOF)
-			fatal ("eSpeak process died too soon\n");
+		gchar *pronunciation = g_ptr_array_index (batch->pronunciations, i);
+		if (journal && fprintf (journal, "%s\n", pronunciation) < 0)
+			fatal ("Error: journal write failed: %s\n", g_strerror (errno));
+		if (!strcmp (pronunciation, void_entry))
+			*pronunciation = 0;
+
+		// For the sake of simplicity we fake a new start;
+		// write_fields() only iterates the list in one direction.
+		StardictEntry *entry = g_ptr_array_index (batch->entries, i);
+		StardictEntryField field;
+		field.type = 't';
+		field.data = pronunciation;
+
+		GList start_link;
+		start_link.next = entry ? entry->fields : NULL;
+		start_link.data = &field;
+
+		GError *error = NULL;
+		generator_begin_entry (generator);
+		if (!generator_write_fields (generator, &start_link, &error)
+		 || !generator_finish_entry (generator,
+				g_ptr_array_index (batch->words, i), &error))
+			fatal ("Error: write failed: %s\n", error->message);
+	}
+
+	// Only ever let the journal contain whole batches
+	if (journal && fflush (journal))
+		fatal ("Error: journal write failed: %s\n", g_strerror (errno));
+}
 
-		gchar *translation = g_string_free (s, FALSE);
-		*output_end = translation;
-		output_end = (gpointer *) translation;
+/// Writes out batches in their original order, as they come.
+static void
+write_batches (Pipeline *self, Generator *generator,
+	const gchar *void_entry, FILE *journal)
+{
+	gsize n_words = stardict_info_get_word_count
+		(stardict_dict_get_info (self->dict));
 
-		// We limit progress reporting so that
-		// the mutex doesn't spin like crazy
-		if ((--remaining & 255) != 0)
+	GHashTable *pending = g_hash_table_new (NULL, NULL);
+	guint32 next = 0, total = G_MAXUINT32;
+	gsize written = 0;
+	gboolean appending = FALSE;
+	while (next != total)
+	{
+		Batch *batch = g_hash_table_lookup (pending, GUINT_TO_POINTER (next));
+		if (!batch)
+		{
+			batch = g_async_queue_pop (self->done);
+			if (batch->words->len)
+				g_hash_table_insert (pending,
+					GUINT_TO_POINTER (batch->sequence), batch);
+			else
+			{
+				total = batch->sequence;
+				batch_free (batch);
+			}
 			continue;
+		}
 
-		g_mutex_lock (data->remaining_mutex);
-		data->remaining = remaining;
-		g_cond_broadcast (data->remaining_cond);
-		g_mutex_unlock (data->remaining_mutex);
-	}
+		g_hash_table_remove (pending, GUINT_TO_POINTER (next++));
 
-	if (fgetc (child_stdout) != EOF)
-		fatal ("Error: eSpeak has written more lines than it should. "
-			"The output would be corrupt, aborting.\n");
+		g_mutex_lock (&self->journal_mutex);
+		guint32 known = self->known;
+		off_t known_end = self->known_end;
+		g_mutex_unlock (&self->journal_mutex);
 
-	fclose (child_stdout);
-	return g_thread_join (writer);
-}
+		// The producer may have given up on the journal's contents midway,
+		// then whatever follows the last batch read from it must go
+		if (!appending && written >= known)
+		{
+			if (fseeko (journal, known_end, SEEK_SET)
+			 || ftruncate (fileno (journal), known_end))
+				fatal ("Error: journal write failed: %s\n",
+					g_strerror (errno));
+			appending = TRUE;
+		}
 
-// --- Main --------------------------------------------------------------------
+		write_batch (batch, generator, void_entry, appending ? journal : NULL);
+		written += batch->words->len;
+		batch_free (batch);
+		pipeline_release_slot (self);
+
+		printf ("\rAdding pronunciation... %3lu%%",
+			(gulong) (written * 100 / MAX (n_words, 1)));
+		fflush (stdout);
+	}
+	g_hash_table_destroy (pending);
+}
 
 int
 main (int argc, char *argv[])
@@ -256,6 +594,7 @@ main (int argc, char *argv[])
 	gint n_processes = 1;
 	gchar *voice = NULL;
 	gboolean ignore_acronyms = FALSE;
+	gboolean uncompressed = FALSE;
 
 	GOptionEntry entries[] =
 	{
@@ -268,6 +607,9 @@ main (int argc, char *argv[])
 		{ "ignore-acronyms", 0, G_OPTION_FLAG_IN_MAIN,
 		  G_OPTION_ARG_NONE, &ignore_acronyms,
 		  "Don't spell out words composed of big letters only", NULL },
+		{ "uncompressed", 0, G_OPTION_FLAG_IN_MAIN,
+		  G_OPTION_ARG_NONE, &uncompressed,
+		  "Write a plain .dict file instead of .dict.dz", NULL },
 		{ NULL }
 	};
 
@@ -305,88 +647,11 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 	if (!dict)
 		fatal ("Error: opening the dictionary failed: %s\n", error->message);
 
-	gsize n_words = stardict_info_get_word_count
-		(stardict_dict_get_info (dict));
-
 	if (n_processes <= 0)
 		fatal ("Error: there must be at least one process\n");
 
-	if ((gsize) n_processes > n_words * 1024)
-	{
-		n_processes = n_words / 1024;
-		if (!n_processes)
-			n_processes = 1;
-		g_printerr ("Warning: too many processes, reducing to %d\n",
-			n_processes);
-	}
-
-	// Spawn worker threads to generate pronunciation data
-	static GMutex dict_mutex;
-
-	static GMutex remaining_mutex;
-	static GCond remaining_cond;
-
-	WorkerData *data = g_alloca (sizeof *data * n_processes);
-
-	GRegex *re_stop = g_regex_new ("[" LINE_SPLITTING_CHARS "][ ?]"
-		"|\\.\\.\\.|[" OTHER_STOP_CHARS "]", G_REGEX_OPTIMIZE, 0, &error);
-	g_assert (re_stop != NULL);
-
-	GRegex *re_acronym = g_regex_new ("(^|\\pZ)(\\p{Lu}+)(?=\\pZ|$)",
-		G_REGEX_OPTIMIZE, 0, &error);
-	g_assert (re_acronym != NULL);
-
-	gint i;
-	for (i = 0; i < n_processes; i++)
-	{
-		data[i].start_entry = n_words *  i      / n_processes;
-		data[i].end_entry   = n_words * (i + 1) / n_processes;
-
-		data[i].total = data[i].remaining =
-			data[i].end_entry - data[i].start_entry;
-		data[i].remaining_mutex = &remaining_mutex;
-		data[i].remaining_cond = &remaining_cond;
-
-		data[i].dict = dict;
-		data[i].dict_mutex = &dict_mutex;
-
-		data[i].re_stop = re_stop;
-		data[i].re_acronym = re_acronym;
-
-		data[i].cmdline = cmdline;
-		data[i].ignore_acronyms = ignore_acronyms;
-		data[i].main_thread =
-			g_thread_new ("worker", (GThreadFunc) worker, &data[i]);
-	}
-
-	// Loop while the threads still have some work to do and report status
-	g_mutex_lock (&remaining_mutex);
-	for (;;)
-	{
-		gboolean all_finished = TRUE;
-		printf ("\rRetrieving pronunciation... ");
-		for (i = 0; i < n_processes; i++)
-		{
-			printf ("%3u%% ", 100 - data[i].remaining * 100 / data[i].total);
-			if (data[i].remaining)
-				all_finished = FALSE;
-		}
-
-		if (all_finished)
-			break;
-		g_cond_wait (&remaining_cond, &remaining_mutex);
-	}
-	g_mutex_unlock (&remaining_mutex);
-
-	putchar ('\n');
-	for (i = 0; i < n_processes; i++)
-		g_thread_join (data[i].main_thread);
-
-	g_regex_unref (re_stop);
-	g_regex_unref (re_acronym);
-
 	// Put extended entries into a new dictionary
-	Generator *generator = generator_new (argv[2], &error);
+	Generator *generator = generator_new (argv[2], !uncompressed, &error);
 	if (!generator)
 		fatal ("Error: failed to create the output dictionary: %s\n",
 			error->message);
@@ -404,64 +669,75 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 		info->same_type_sequence = new_sts;
 	}
 
-	// Write out all the entries together with the pronunciation
-	for (i = 0; i < n_processes; i++)
+	Pipeline pipeline =
 	{
-		StardictIterator *iterator =
-			stardict_iterator_new (dict, data[i].start_entry);
-
-		gpointer *output = data[i].output;
-		while (stardict_iterator_get_offset (iterator) != data[i].end_entry)
-		{
-			printf ("\rCreating a new dictionary... %3lu%%",
-				(gulong) stardict_iterator_get_offset (iterator) * 100
-				/ stardict_dict_get_info (dict)->word_count);
-
-			g_assert (output != NULL);
-
-			gchar *pronunciation = g_strstrip ((gchar *) (output + 1));
-			StardictEntry *entry = stardict_iterator_get_entry (iterator);
-
-			generator_begin_entry (generator);
-
-			if (!strcmp (pronunciation, void_entry))
-				*pronunciation = 0;
-
-//			g_printerr ("%s /%s/\n",
-//				stardict_iterator_get_word (iterator), pronunciation);
-
-			// For the sake of simplicity we fake a new start;
-			// write_fields() only iterates the list in one direction.
-			StardictEntryField field;
-			field.type = 't';
-			field.data = pronunciation;
-
-			GList start_link;
-			start_link.next = entry->fields;
-			start_link.data = &field;
-
-			if (!generator_write_fields (generator, &start_link, &error)
-			 || !generator_finish_entry (generator,
-					stardict_iterator_get_word (iterator), &error))
-				fatal ("Error: write failed: %s\n", error->message);
-
-			g_object_unref (entry);
+		.dict = dict,
+		.n_workers = n_processes,
+		.cmdline = cmdline,
+		.ignore_acronyms = ignore_acronyms,
+		.slots = BATCHES_PER_WORKER * n_processes,
+	};
 
-			gpointer *tmp = output;
-			output = *output;
-			g_free (tmp);
+	// Pick up any work done by a previous, interrupted run
+	gchar *journal_path = g_strconcat (argv[2], ".journal", NULL);
+	gchar *journal_header =
+		journal_make_header (argv[1], dict, voice, ignore_acronyms);
+	FILE *journal = NULL;
+	pipeline.known = journal_open (journal_path, journal_header,
+		&pipeline.journal, &journal, &pipeline.known_end);
+	g_free (journal_header);
+	if (pipeline.known)
+		printf ("Resuming after %lu entries...\n", (gulong) pipeline.known);
+
+	pipeline.re_stop = g_regex_new ("[" LINE_SPLITTING_CHARS "][ ?]"
+		"|\\.\\.\\.|[" OTHER_STOP_CHARS "]", G_REGEX_OPTIMIZE, 0, &error);
+	g_assert (pipeline.re_stop != NULL);
 
-			stardict_iterator_next (iterator);
-		}
+	pipeline.re_acronym = g_regex_new ("(^|\\pZ)(\\p{Lu}+)(?=\\pZ|$)",
+		G_REGEX_OPTIMIZE, 0, &error);
+	g_assert (pipeline.re_acronym != NULL);
+
+	pipeline.todo = g_async_queue_new ();
+	pipeline.done = g_async_queue_new ();
+	g_mutex_init (&pipeline.slots_mutex);
+	g_cond_init (&pipeline.slots_cond);
+	g_mutex_init (&pipeline.journal_mutex);
+
+	// Spawn threads to read entries and generate pronunciation data,
+	// while we write them out in the original order
+	GThread *producer_thread =
+		g_thread_new ("producer", (GThreadFunc) producer, &pipeline);
+	GThread **workers = g_new (GThread *, n_processes);
+	for (gint i = 0; i < n_processes; i++)
+		workers[i] = g_thread_new ("worker", (GThreadFunc) worker, &pipeline);
+
+	write_batches (&pipeline, generator, void_entry, journal);
+	putchar ('\n');
 
-		g_assert (output == NULL);
-		g_object_unref (iterator);
-	}
+	g_thread_join (producer_thread);
+	for (gint i = 0; i < n_processes; i++)
+		g_thread_join (workers[i]);
+	g_free (workers);
+
+	g_async_queue_unref (pipeline.todo);
+	g_async_queue_unref (pipeline.done);
+	g_mutex_clear (&pipeline.slots_mutex);
+	g_cond_clear (&pipeline.slots_cond);
+	g_mutex_clear (&pipeline.journal_mutex);
+	g_regex_unref (pipeline.re_stop);
+	g_regex_unref (pipeline.re_acronym);
+	if (pipeline.journal)
+		fclose (pipeline.journal);
 
-	putchar ('\n');
 	if (!generator_finish (generator, &error))
 		fatal ("Error: failed to write the dictionary: %s\n", error->message);
 
+	// The journal is of no further use
+	fclose (journal);
+	if (g_unlink (journal_path))
+		g_printerr ("Warning: %s: %s\n", journal_path, g_strerror (errno));
+	g_free (journal_path);
+
 	generator_free (generator);
 	g_object_unref (dict);
 	g_free (void_entry);
@@ -41,6 +41,9 @@ static struct
 	gboolean      loading;           ///< Dictionaries are being loaded
 
 	gboolean      watch_selection;   ///< Following X11 PRIMARY?
+	gboolean      fulltext;          ///< Searching within definitions?
+	gboolean      merge_all;         ///< Searching all dictionaries at once?
+	MergedSearch *merged;            ///< The current merged search, or NULL
 }
 g;
 
@@ -104,6 +107,16 @@ load_from_config (GPtrArray *out, GError **error)
 	return result;
 }
 
+/// Entries taken from each dictionary in a merged search
+#define MERGED_LIMIT 100
+
+static void
+on_merged_results (MergedSearch *search, G_GNUC_UNUSED gpointer data)
+{
+	Dictionary *dict = g_ptr_array_index (g.dictionaries, g.dictionary);
+	stardict_view_set_merged (STARDICT_VIEW (g.view), dict->dict, search);
+}
+
 static void
 search (Dictionary *dict)
 {
@@ -112,6 +125,47 @@ search (Dictionary *dict)
 	if (!dict->dict)
 		return;
 
+	if (g.merged)
+	{
+		merged_search_free (g.merged);
+		g.merged = NULL;
+	}
+
+	gtk_entry_set_icon_from_icon_name (GTK_ENTRY (g.entry),
+		GTK_ENTRY_ICON_SECONDARY, NULL);
+	if (g.merge_all)
+	{
+		// Results are streamed in through on_merged_results()
+		g.merged = merged_search_new (g.dictionaries, input_utf8,
+			MERGED_LIMIT, on_merged_results, NULL);
+		stardict_view_set_merged (STARDICT_VIEW (g.view), dict->dict, g.merged);
+		stardict_view_set_matched (STARDICT_VIEW (g.view), input_utf8);
+		return;
+	}
+	if (g.fulltext)
+	{
+		GError *error = NULL;
+		GArray *positions =
+			stardict_dict_search_fulltext (dict->dict, input_utf8, &error);
+		if (!positions)
+		{
+			gtk_entry_set_icon_from_icon_name (GTK_ENTRY (g.entry),
+				GTK_ENTRY_ICON_SECONDARY, "dialog-warning");
+			gtk_entry_set_icon_tooltip_text (GTK_ENTRY (g.entry),
+				GTK_ENTRY_ICON_SECONDARY, error->message);
+			g_error_free (error);
+			positions = g_array_new (FALSE, FALSE, sizeof (guint32));
+		}
+
+		stardict_view_set_results (STARDICT_VIEW (g.view),
+			dict->dict, positions);
+		g_array_unref (positions);
+
+		// Highlighting the query words separately is not supported
+		stardict_view_set_matched (STARDICT_VIEW (g.view), NULL);
+		return;
+	}
+
 	StardictIterator *iterator =
 		stardict_dict_search (dict->dict, input_utf8, NULL);
 	stardict_view_set_position (STARDICT_VIEW (g.view),
@@ -166,13 +220,52 @@ on_selection_watch_toggle (GtkCheckMenuItem *item, G_GNUC_UNUSED gpointer data)
 	g.watch_selection = gtk_check_menu_item_get_active (item);
 }
 
+static void
+search_again (void)
+{
+	if (g.dictionaries && g.dictionary >= 0
+	 && (guint) g.dictionary < g.dictionaries->len)
+		search (g_ptr_array_index (g.dictionaries, g.dictionary));
+}
+
+// Like in the TUI, the two search modes are mutually exclusive,
+// and turning one of them on turns the other one, passed in @a data, off
+
+static void
+on_fulltext_toggle (GtkCheckMenuItem *item, gpointer data)
+{
+	if ((g.fulltext = gtk_check_menu_item_get_active (item)) && g.merge_all)
+		gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (data), FALSE);
+	else
+		search_again ();
+}
+
+static void
+on_merge_all_toggle (GtkCheckMenuItem *item, gpointer data)
+{
+	if ((g.merge_all = gtk_check_menu_item_get_active (item)) && g.fulltext)
+		gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (data), FALSE);
+	else
+		search_again ();
+}
+
+static void show_error_dialog (GError *error);
+
 static void
 on_switch_page (G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED GtkWidget *page,
 	guint page_num, G_GNUC_UNUSED gpointer data)
 {
 	g.last = g.dictionary;
 	g.dictionary = page_num;
-	search (g_ptr_array_index (g.dictionaries, g.dictionary));
+
+	// Only the first dictionary is loaded in advance, and this is where
+	// the others would otherwise fail quietly, looking empty
+	Dictionary *dict = g_ptr_array_index (g.dictionaries, g.dictionary);
+	GError *error = NULL;
+	gboolean loaded = stardict_dict_load (dict->dict, &error);
+	search (dict);
+	if (!loaded)
+		show_error_dialog (error);
 
 	// Hack: Make right-clicking notebook arrows also re-focus the entry.
 	GdkEvent *event = gtk_get_current_event ();
@@ -316,6 +409,11 @@ on_new_dictionaries_loaded (G_GNUC_UNUSED GObject* source_object,
 		gtk_notebook_remove_page (GTK_NOTEBOOK (g.notebook), -1);
 
 	g.dictionary = -1;
+	if (g.merged)
+	{
+		merged_search_free (g.merged);
+		g.merged = NULL;
+	}
 	if (g.dictionaries)
 		g_ptr_array_free (g.dictionaries, TRUE);
 
@@ -328,8 +426,13 @@ static void
 on_reload_dictionaries_task (GTask *task, G_GNUC_UNUSED gpointer source_object,
 	gpointer task_data, G_GNUC_UNUSED GCancellable *cancellable)
 {
+	// Only the first dictionary is needed right away, the rest can wait
+	// until they're used, and have their data released once they're idle
+	GPtrArray *dictionaries = task_data;
 	GError *error = NULL;
-	if (load_dictionaries (task_data, &error))
+	if (open_dictionaries (dictionaries, &error) && (!dictionaries->len
+	 || stardict_dict_load (((Dictionary *)
+		g_ptr_array_index (dictionaries, 0))->dict, &error)))
 	{
 		g_task_return_pointer (task,
 			g_ptr_array_ref (task_data), (GDestroyNotify) g_ptr_array_unref);
@@ -338,6 +441,14 @@ on_reload_dictionaries_task (GTask *task, G_GNUC_UNUSED gpointer source_object,
 		g_task_return_error (task, error);
 }
 
+static gboolean
+on_evict_timer (G_GNUC_UNUSED gpointer data)
+{
+	if (g.dictionaries)
+		evict_dictionaries (g.dictionaries, DICTIONARY_MEMORY_BUDGET);
+	return G_SOURCE_CONTINUE;
+}
+
 static gboolean
 reload_dictionaries (GPtrArray *new_dictionaries, GError **error)
 {
@@ -810,10 +921,21 @@ gui_main (char *argv[])
 	g_signal_connect (item_selection, "toggled",
 		G_CALLBACK (on_selection_watch_toggle), NULL);
 
+	GtkWidget *item_fulltext =
+		gtk_check_menu_item_new_with_mnemonic (_("Search _definitions"));
+	GtkWidget *item_merge_all =
+		gtk_check_menu_item_new_with_mnemonic (_("Search _all dictionaries"));
+	g_signal_connect (item_fulltext, "toggled",
+		G_CALLBACK (on_fulltext_toggle), item_merge_all);
+	g_signal_connect (item_merge_all, "toggled",
+		G_CALLBACK (on_merge_all_toggle), item_fulltext);
+
 	GtkWidget *menu = gtk_menu_new ();
 	gtk_widget_set_halign (menu, GTK_ALIGN_END);
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item_open);
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item_settings);
+	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item_fulltext);
+	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item_merge_all);
 #ifndef G_OS_WIN32
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item_selection);
 #endif  // ! G_OS_WIN32
@@ -869,6 +991,7 @@ gui_main (char *argv[])
 	if (!reload_dictionaries (new_dictionaries, &error))
 		die_with_dialog (error->message);
 
+	g_timeout_add_seconds (DICTIONARY_IDLE_TIMEOUT / 4, on_evict_timer, NULL);
 	gtk_widget_show_all (g.window);
 	gtk_main ();
 	return 0;
@@ -0,0 +1,92 @@
+/*
+ * A tool to build full-text indexes of dictionary definitions
+ *
+ * Copyright (c) 2026, Přemysl Eric Janouch <p@janouch.name>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "stardict.h"
+#include "utils.h"
+
+
+// --- Main --------------------------------------------------------------------
+
+static void
+print_matches (StardictDict *dict, const gchar *query)
+{
+	GError *error = NULL;
+	GArray *positions = stardict_dict_search_fulltext (dict, query, &error);
+	if (!positions)
+		fatal ("Error: search failed: %s\n", error->message);
+
+	for (guint i = 0; i < positions->len; i++)
+	{
+		StardictIterator *iterator = stardict_iterator_new
+			(dict, g_array_index (positions, guint32, i));
+		printf ("%s\n", stardict_iterator_get_word (iterator));
+		g_object_unref (iterator);
+	}
+	g_array_free (positions, TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+	// The GLib help includes an ellipsis character, for some reason
+	(void) setlocale (LC_ALL, "");
+
+	GError *error = NULL;
+	GOptionContext *ctx = g_option_context_new ("input.ifo");
+	g_option_context_set_summary (ctx,
+		"Build an index for searching within definitions.");
+
+	gchar *query = NULL;
+	GOptionEntry entries[] =
+	{
+		{ "search", 's', 0, G_OPTION_ARG_STRING, &query,
+		  "Only search the existing index for all words", "WORDS" },
+		{ }
+	};
+
+	g_option_context_add_main_entries (ctx, entries, NULL);
+	if (!g_option_context_parse (ctx, &argc, &argv, &error))
+		fatal ("Error: option parsing failed: %s\n", error->message);
+	if (argc != 2)
+		fatal ("%s", g_option_context_get_help (ctx, TRUE, NULL));
+	g_option_context_free (ctx);
+
+	StardictDict *dict = stardict_dict_new (argv[1], &error);
+	if (!dict)
+		fatal ("Error: opening the dictionary failed: %s\n", error->message);
+
+	if (query)
+		print_matches (dict, query);
+	else
+	{
+		printf ("Indexing entries...\n");
+		if (!stardict_dict_build_fulltext_index (dict, &error))
+			fatal ("Error: failed to write the index: %s\n", error->message);
+	}
+
+	g_free (query);
+	g_object_unref (dict);
+	return 0;
+}
@@ -6,6 +6,10 @@
  * finalised with an empty line.  Newlines are escaped with `\n',
  * backslashes with `\\'.
  *
+ * With --batch, all of standard input is processed in parallel, for speed.
+ * Results still come out in the order of queries.  With --listen, the same
+ * protocol is served on a Unix socket, and dictionaries reload on changes.
+ *
  * So far only the `m', `g`, and `x` fields are supported, as in tdv.
  *
  * Copyright (c) 2013 - 2021, Přemysl Eric Janouch <p@janouch.name>
@@ -28,8 +32,12 @@
 #include <string.h>
 #include <errno.h>
 
+#include <sys/stat.h>
+
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
 #include <pango/pango.h>
 
 #include "stardict.h"
@@ -40,63 +48,54 @@
 
 // --- Output formatting -------------------------------------------------------
 
-/// Transform Pango attributes to in-line formatting sequences (non-reentrant)
-typedef const gchar *(*FormatterFunc) (PangoAttrIterator *);
+/// Transform Pango attributes to in-line formatting sequences
+typedef void (*FormatterFunc) (PangoAttrIterator *, GString *);
 
-static const gchar *
-pango_attrs_ignore (G_GNUC_UNUSED PangoAttrIterator *iterator)
+static void
+pango_attrs_ignore (G_GNUC_UNUSED PangoAttrIterator *iterator,
+	G_GNUC_UNUSED GString *output)
 {
-	return "";
 }
 
-static const gchar *
-pango_attrs_to_irc (PangoAttrIterator *iterator)
+static void
+pango_attrs_to_irc (PangoAttrIterator *iterator, GString *output)
 {
-	static gchar buf[5];
-	gchar *p = buf;
-	*p++ = 0x0f;
-
+	g_string_append_c (output, 0x0f);
 	if (!iterator)
-		goto reset_formatting;
+		return;
 
 	PangoAttrInt *attr = NULL;
 	if ((attr = (PangoAttrInt *) pango_attr_iterator_get (iterator,
 			PANGO_ATTR_WEIGHT)) && attr->value >= PANGO_WEIGHT_BOLD)
-		*p++ = 0x02;
+		g_string_append_c (output, 0x02);
 	if ((attr = (PangoAttrInt *) pango_attr_iterator_get (iterator,
 			PANGO_ATTR_UNDERLINE)) && attr->value == PANGO_UNDERLINE_SINGLE)
-		*p++ = 0x1f;
+		g_string_append_c (output, 0x1f);
 	if ((attr = (PangoAttrInt *) pango_attr_iterator_get (iterator,
 			PANGO_ATTR_STYLE)) && attr->value == PANGO_STYLE_ITALIC)
-		*p++ = 0x1d;
-
-reset_formatting:
-	*p++ = 0;
-	return buf;
+		g_string_append_c (output, 0x1d);
 }
 
-static const gchar *
-pango_attrs_to_ansi (PangoAttrIterator *iterator)
+static void
+pango_attrs_to_ansi (PangoAttrIterator *iterator, GString *output)
 {
-	static gchar buf[16];
-	g_strlcpy (buf, "\x1b[0", sizeof buf);
+	g_string_append (output, "\x1b[0");
 	if (!iterator)
 		goto reset_formatting;
 
 	PangoAttrInt *attr = NULL;
 	if ((attr = (PangoAttrInt *) pango_attr_iterator_get (iterator,
 			PANGO_ATTR_WEIGHT)) && attr->value >= PANGO_WEIGHT_BOLD)
-		g_strlcat (buf, ";1", sizeof buf);
+		g_string_append (output, ";1");
 	if ((attr = (PangoAttrInt *) pango_attr_iterator_get (iterator,
 			PANGO_ATTR_UNDERLINE)) && attr->value == PANGO_UNDERLINE_SINGLE)
-		g_strlcat (buf, ";4", sizeof buf);
+		g_string_append (output, ";4");
 	if ((attr = (PangoAttrInt *) pango_attr_iterator_get (iterator,
 			PANGO_ATTR_STYLE)) && attr->value == PANGO_STYLE_ITALIC)
-		g_strlcat (buf, ";3", sizeof buf);
+		g_string_append (output, ";3");
 
 reset_formatting:
-	g_strlcat (buf, "m", sizeof buf);
-	return buf;
+	g_string_append_c (output, 'm');
 }
 
 static gchar *
@@ -117,11 +116,11 @@ pango_to_output_text (const gchar *markup, FormatterFunc formatter)
 		if (end == G_MAXINT)
 			end = strlen (text);
 
-		g_string_append (result, formatter (iterator));
+		formatter (iterator, result);
 		g_string_append_len (result, text + start, end - start);
 	}
 	while (pango_attr_iterator_next (iterator));
-	g_string_append (result, formatter (NULL));
+	formatter (NULL, result);
 
 	g_free (text);
 	pango_attr_iterator_destroy (iterator);
@@ -159,8 +158,27 @@ count_equal_chars (const gchar *a, const gchar *b)
 	return count;
 }
 
+/// Append text to the output, escaping backslashes and newlines.
+static void
+append_escaped (GString *output, const gchar *text)
+{
+	while (*text)
+	{
+		size_t len = strcspn (text, "\\\n");
+		g_string_append_len (output, text, len);
+		if (!*(text += len))
+			break;
+
+		g_string_append (output, *text++ == '\n' ? "\\n" : "\\\\");
+	}
+}
+
+/// Look up a word in a dictionary, appending any results to the output.
+/// This may be called from multiple threads at once, because searches
+/// don't modify any shared state, such as collator settings.
 static void
-do_dictionary (StardictDict *dict, const gchar *word, FormatterFunc formatter)
+do_dictionary (StardictDict *dict, const gchar *word,
+	FormatterFunc formatter, GString *output)
 {
 	gboolean found;
 	StardictIterator *iter = stardict_dict_search (dict, word, &found);
@@ -205,17 +223,10 @@ do_dictionary (StardictDict *dict, const gchar *word, FormatterFunc formatter)
 		if (!definitions)
 			continue;
 
-		printf ("%s\t", info->book_name);
-		for (const gchar *p = definitions; *p; p++)
-		{
-			if (*p == '\\')
-				printf ("\\\\");
-			else if (*p == '\n')
-				printf ("\\n");
-			else
-				putchar (*p);
-		}
-		putchar ('\n');
+		g_string_append (output, info->book_name);
+		g_string_append_c (output, '\t');
+		append_escaped (output, definitions);
+		g_string_append_c (output, '\n');
 		g_free (definitions);
 	}
 	g_object_unref (entry);
@@ -223,8 +234,431 @@ out:
 	g_object_unref (iter);
 }
 
+/// Drop all carriage returns from an input line of @a len bytes,
+/// so that files with any line endings result in the same lookups.
+/// Returns the new length of the line.
+static gsize
+strip_carriage_returns (gchar *line, gsize len)
+{
+	gsize out = 0;
+	for (gsize i = 0; i < len; i++)
+		if (line[i] != '\r')
+			line[out++] = line[i];
+	line[out] = '\0';
+	return out;
+}
+
+// --- Batch mode --------------------------------------------------------------
+
+// Scripts may feed us whole corpora, so rather than going word by word,
+// we read a number of queries, look them up in sorted order to keep index
+// and dictionary access mostly monotonic, and print results in input order.
+
+/// How many queries are read and processed at once
+#define BATCH_SIZE 4096
+
+typedef struct batch Batch;
+typedef struct batch_slice BatchSlice;
+
+struct batch
+{
+	StardictDict ** dicts;              ///< Dictionaries to look words up in
+	guint           n_dicts;            ///< Number of dictionaries
+	FormatterFunc   formatter;          ///< Output formatter
+
+	GPtrArray     * words;              ///< Queries in input order
+	GPtrArray     * outputs;            ///< GString results in input order
+	guint         * order;              ///< Indexes of queries, sorted
+
+	GMutex          lock;               ///< Guards @a pending
+	GCond           done;               ///< Signalled when nothing's pending
+	guint           pending;            ///< Slices yet to be processed
+};
+
+/// A contiguous part of the sorted queries, processed by a single thread
+struct batch_slice
+{
+	Batch         * batch;              ///< The batch this belongs to
+	guint           start;              ///< The first index into @a order
+	guint           end;                ///< Past the last index into @a order
+};
+
+static void
+string_free (gpointer string)
+{
+	g_string_free (string, TRUE);
+}
+
+/// Order queries the way the first dictionary's index is, which is where
+/// the lookups actually need to be monotonic.
+static gint
+batch_compare_words (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	Batch *batch = user_data;
+	return stardict_dict_compare_words (batch->dicts[0],
+		g_ptr_array_index (batch->words, *(const guint *) a),
+		g_ptr_array_index (batch->words, *(const guint *) b));
+}
+
+static void
+batch_process_slice (BatchSlice *slice, G_GNUC_UNUSED gpointer user_data)
+{
+	Batch *batch = slice->batch;
+	for (guint i = slice->start; i < slice->end; i++)
+	{
+		guint query = batch->order[i];
+		const gchar *word = g_ptr_array_index (batch->words, query);
+		GString *output = g_ptr_array_index (batch->outputs, query);
+		if (*word)
+			for (guint k = 0; k < batch->n_dicts; k++)
+				do_dictionary (batch->dicts[k], word, batch->formatter, output);
+		g_string_append_c (output, '\n');
+	}
+	g_slice_free (BatchSlice, slice);
+
+	g_mutex_lock (&batch->lock);
+	if (!--batch->pending)
+		g_cond_signal (&batch->done);
+	g_mutex_unlock (&batch->lock);
+}
+
+static void
+batch_run (Batch *batch, GThreadPool *pool, guint n_threads)
+{
+	guint n = batch->words->len;
+	batch->order = g_renew (guint, batch->order, n);
+	for (guint i = 0; i < n; i++)
+		batch->order[i] = i;
+	g_qsort_with_data (batch->order, n, sizeof *batch->order,
+		batch_compare_words, batch);
+
+	guint n_slices = MIN (n_threads, n);
+	batch->pending = n_slices;
+	for (guint i = 0; i < n_slices; i++)
+	{
+		BatchSlice *slice = g_slice_new (BatchSlice);
+		slice->batch = batch;
+		slice->start = (guint64) n *  i      / n_slices;
+		slice->end   = (guint64) n * (i + 1) / n_slices;
+		g_thread_pool_push (pool, slice, NULL);
+	}
+
+	g_mutex_lock (&batch->lock);
+	while (batch->pending)
+		g_cond_wait (&batch->done, &batch->lock);
+	g_mutex_unlock (&batch->lock);
+
+	for (guint i = 0; i < n; i++)
+	{
+		GString *output = g_ptr_array_index (batch->outputs, i);
+		fwrite (output->str, 1, output->len, stdout);
+	}
+	g_ptr_array_set_size (batch->words, 0);
+	g_ptr_array_set_size (batch->outputs, 0);
+}
+
+static void
+batch_mode (StardictDict **dicts, guint n_dicts, FormatterFunc formatter)
+{
+	Batch batch = { .dicts = dicts, .n_dicts = n_dicts,
+		.formatter = formatter };
+	batch.words = g_ptr_array_new_with_free_func (g_free);
+	batch.outputs = g_ptr_array_new_with_free_func (string_free);
+	g_mutex_init (&batch.lock);
+	g_cond_init (&batch.done);
+
+	guint n_threads = g_get_num_processors ();
+	GThreadPool *pool = g_thread_pool_new ((GFunc) batch_process_slice,
+		NULL, n_threads, TRUE, NULL);
+	g_assert (pool != NULL);
+
+	gchar *line = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	while ((len = getline (&line, &line_size, stdin)) != -1)
+	{
+		if (len && line[len - 1] == '\n')
+			len--;
+		len = strip_carriage_returns (line, len);
+
+		g_ptr_array_add (batch.words, g_strndup (line, len));
+		g_ptr_array_add (batch.outputs, g_string_new (NULL));
+		if (batch.words->len == BATCH_SIZE)
+			batch_run (&batch, pool, n_threads);
+	}
+	if (batch.words->len)
+		batch_run (&batch, pool, n_threads);
+	free (line);
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_mutex_clear (&batch.lock);
+	g_cond_clear (&batch.done);
+	g_ptr_array_free (batch.words, TRUE);
+	g_ptr_array_free (batch.outputs, TRUE);
+	g_free (batch.order);
+}
+
+// --- Server mode -------------------------------------------------------------
+
+// Loading dictionaries may take a long time, so they can be kept in memory,
+// serving clients over a Unix socket with the same protocol as on stdin.
+// Dictionaries get reloaded in the background whenever any of their files
+// changes.
+
+/// How many clients may be served at the same time
+#define SERVER_MAX_CLIENTS  32
+
+/// How long to wait for changes to settle before reloading, in seconds
+#define SERVER_RELOAD_DELAY  1
+
+typedef struct server Server;
+typedef struct server_dict ServerDict;
+
+struct server_dict
+{
+	Server        * server;             ///< The server this belongs to
+	Dictionary    * dictionary;         ///< The dict is guarded by the lock
+	GPtrArray     * monitors;           ///< Watch the files for changes
+	guint           reload_source;      ///< Pending reload timer, or 0
+	gboolean        reloading;          ///< A reload is in progress
+	gboolean        reload_again;       ///< Changed while reloading
+};
+
+struct server
+{
+	FormatterFunc   formatter;          ///< Output formatter
+	GMutex          lock;               ///< Guards the loaded dictionaries
+	ServerDict    * dicts;              ///< Dictionaries being served
+	guint           n_dicts;            ///< Number of dictionaries
+};
+
+/// Take references to all currently loaded dictionaries.
+static void
+server_ref_dicts (Server *self, StardictDict **dicts)
+{
+	g_mutex_lock (&self->lock);
+	for (guint i = 0; i < self->n_dicts; i++)
+		dicts[i] = g_object_ref (self->dicts[i].dictionary->dict);
+	g_mutex_unlock (&self->lock);
+}
+
+static gboolean
+server_on_run (G_GNUC_UNUSED GThreadedSocketService *service,
+	GSocketConnection *connection, G_GNUC_UNUSED GObject *source_object,
+	Server *self)
+{
+	GDataInputStream *dis = g_data_input_stream_new
+		(g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	g_data_input_stream_set_newline_type (dis, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+	GOutputStream *os =
+		g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+	StardictDict **dicts = g_alloca (sizeof *dicts * self->n_dicts);
+	GString *output = g_string_new (NULL);
+	GError *error = NULL;
+	gchar *line;
+	while ((line = g_data_input_stream_read_line (dis, NULL, NULL, &error)))
+	{
+		server_ref_dicts (self, dicts);
+		for (guint i = 0; i < self->n_dicts; i++)
+		{
+			if (*line)
+				do_dictionary (dicts[i], line, self->formatter, output);
+			g_object_unref (dicts[i]);
+		}
+		g_string_append_c (output, '\n');
+		g_free (line);
+
+		gboolean ok = g_output_stream_write_all
+			(os, output->str, output->len, NULL, NULL, &error);
+		g_string_truncate (output, 0);
+		if (!ok)
+			break;
+	}
+	if (error)
+	{
+		g_debug ("client connection: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_string_free (output, TRUE);
+	g_object_unref (dis);
+	return TRUE;
+}
+
+static void server_dict_schedule_reload (ServerDict *self);
+
+static void
+server_dict_reload_thread (GTask *task, G_GNUC_UNUSED gpointer source_object,
+	gpointer task_data, G_GNUC_UNUSED GCancellable *cancellable)
+{
+	GError *error = NULL;
+	StardictDict *dict = stardict_dict_new (task_data, &error);
+	if (dict)
+		g_task_return_pointer (task, dict, g_object_unref);
+	else
+		g_task_return_error (task, error);
+}
+
+static void
+server_dict_on_reloaded (G_GNUC_UNUSED GObject *source_object,
+	GAsyncResult *res, gpointer user_data)
+{
+	ServerDict *self = user_data;
+	GError *error = NULL;
+	StardictDict *dict = g_task_propagate_pointer (G_TASK (res), &error);
+	if (!dict)
+	{
+		g_printerr ("Warning: reloading `%s' failed: %s\n",
+			self->dictionary->filename, error->message);
+		g_error_free (error);
+	}
+	else
+	{
+		// Clients still hold their own references to the old dictionary
+		g_mutex_lock (&self->server->lock);
+		StardictDict *old = self->dictionary->dict;
+		self->dictionary->dict = dict;
+		g_mutex_unlock (&self->server->lock);
+		g_object_unref (old);
+	}
+
+	self->reloading = FALSE;
+	if (self->reload_again)
+		server_dict_schedule_reload (self);
+}
+
+static gboolean
+server_dict_on_reload_timeout (gpointer user_data)
+{
+	ServerDict *self = user_data;
+	self->reload_source = 0;
+	self->reload_again = FALSE;
+	self->reloading = TRUE;
+
+	GTask *task = g_task_new (NULL, NULL, server_dict_on_reloaded, self);
+	g_task_set_task_data (task, g_strdup (self->dictionary->filename), g_free);
+	g_task_run_in_thread (task, server_dict_reload_thread);
+	g_object_unref (task);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+server_dict_schedule_reload (ServerDict *self)
+{
+	if (self->reloading)
+	{
+		self->reload_again = TRUE;
+		return;
+	}
+	if (self->reload_source)
+		g_source_remove (self->reload_source);
+	self->reload_source = g_timeout_add_seconds (SERVER_RELOAD_DELAY,
+		server_dict_on_reload_timeout, self);
+}
+
+static void
+server_dict_on_changed (G_GNUC_UNUSED GFileMonitor *monitor,
+	G_GNUC_UNUSED GFile *file, G_GNUC_UNUSED GFile *other_file,
+	GFileMonitorEvent event_type, gpointer user_data)
+{
+	if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+	 || event_type == G_FILE_MONITOR_EVENT_CREATED)
+		server_dict_schedule_reload (user_data);
+}
+
+/// Watch all files that a dictionary may consist of, even those that
+/// don't exist yet, so that the dictionary is reloaded once they change.
+static void
+server_dict_watch (ServerDict *self)
+{
+	const gchar *filename = self->dictionary->filename;
+	const gchar *dot = strrchr (filename, '.');
+	gchar *base = dot ? g_strndup (filename, dot - filename)
+		: g_strdup (filename);
+
+	static const gchar *suffixes[] =
+		{ ".ifo", ".idx", ".idx.gz", ".dict", ".dict.dz", ".syn" };
+	self->monitors = g_ptr_array_new_with_free_func (g_object_unref);
+	for (gsize i = 0; i < G_N_ELEMENTS (suffixes); i++)
+	{
+		gchar *path = g_strconcat (base, suffixes[i], NULL);
+		GFile *file = g_file_new_for_path (path);
+		GError *error = NULL;
+		GFileMonitor *monitor =
+			g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
+		if (!monitor)
+		{
+			g_printerr ("Warning: cannot watch `%s': %s\n",
+				path, error->message);
+			g_error_free (error);
+		}
+		else
+		{
+			g_signal_connect (monitor, "changed",
+				G_CALLBACK (server_dict_on_changed), self);
+			g_ptr_array_add (self->monitors, monitor);
+		}
+		g_object_unref (file);
+		g_free (path);
+	}
+	g_free (base);
+}
+
+static void
+server_mode (GPtrArray *dictionaries, FormatterFunc formatter,
+	const gchar *socket_path)
+{
+	Server self = { .formatter = formatter, .n_dicts = dictionaries->len };
+	g_mutex_init (&self.lock);
+	self.dicts = g_new0 (ServerDict, self.n_dicts);
+	for (guint i = 0; i < self.n_dicts; i++)
+	{
+		ServerDict *sd = &self.dicts[i];
+		sd->server = &self;
+		sd->dictionary = g_ptr_array_index (dictionaries, i);
+		server_dict_watch (sd);
+	}
+
+	// Only replace stale sockets, never anything else
+	GStatBuf st;
+	if (!g_lstat (socket_path, &st) && S_ISSOCK (st.st_mode))
+		(void) g_unlink (socket_path);
+
+	GError *error = NULL;
+	GSocketService *service =
+		g_threaded_socket_service_new (SERVER_MAX_CLIENTS);
+	GSocketAddress *address = g_unix_socket_address_new (socket_path);
+	if (!g_socket_listener_add_address (G_SOCKET_LISTENER (service), address,
+		G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error))
+		fatal ("Error: cannot listen on `%s': %s\n",
+			socket_path, error->message);
+	g_object_unref (address);
+
+	g_signal_connect (service, "run", G_CALLBACK (server_on_run), &self);
+	g_socket_service_start (service);
+
+	// There is no way to stop the server other than killing it
+	GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+	g_main_loop_run (loop);
+	g_main_loop_unref (loop);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static void
+print_stats (Dictionary *dictionary)
+{
+	g_printerr ("%s:\n", dictionary->filename);
+	gchar **lines = format_dictionary_stats (dictionary->dict);
+	for (gchar **line = lines; *line; line++)
+		g_printerr ("  %s\n", *line);
+	g_strfreev (lines);
+}
+
 static FormatterFunc
-parse_options (int *argc, char ***argv)
+parse_options (int *argc, char ***argv,
+	gboolean *batch, gchar **socket_path, gboolean *stats)
 {
 	GError *error = NULL;
 	GOptionContext *ctx = g_option_context_new
@@ -238,6 +672,12 @@ parse_options (int *argc, char ***argv)
 		  "Format with ANSI sequences", NULL },
 		{ "irc", 'i', 0, G_OPTION_ARG_NONE, &format_with_irc,
 		  "Format with IRC codes", NULL },
+		{ "batch", 'b', 0, G_OPTION_ARG_NONE, batch,
+		  "Process all of standard input at once, in parallel", NULL },
+		{ "listen", 'l', 0, G_OPTION_ARG_FILENAME, socket_path,
+		  "Serve queries on a Unix socket instead of stdin", "PATH" },
+		{ "stats", 's', 0, G_OPTION_ARG_NONE, stats,
+		  "Print dictionary statistics to stderr when done", NULL },
 		{ }
 	};
 
@@ -270,44 +710,68 @@ G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 		g_type_init ();
 G_GNUC_END_IGNORE_DEPRECATIONS
 
-	FormatterFunc formatter = parse_options (&argc, &argv);
+	gboolean batch = FALSE, stats = FALSE;
+	gchar *socket_path = NULL;
+	FormatterFunc formatter =
+		parse_options (&argc, &argv, &batch, &socket_path, &stats);
 
-	guint n_dicts = argc - 1;
-	StardictDict **dicts = g_alloca (sizeof *dicts * n_dicts);
+	GPtrArray *dictionaries =
+		g_ptr_array_new_with_free_func ((GDestroyNotify) dictionary_destroy);
+	for (gint k = 1; k < argc; k++)
+	{
+		Dictionary *dict = g_malloc0 (sizeof *dict);
+		dict->filename = g_strdup (argv[k]);
+		g_ptr_array_add (dictionaries, dict);
+	}
 
-	guint i;
-	for (i = 1; i <= n_dicts; i++)
+	GError *error = NULL;
+	if (!load_dictionaries (dictionaries, &error))
 	{
-		GError *error = NULL;
-		dicts[i - 1] = stardict_dict_new (argv[i], &error);
-		if (error)
-		{
-			g_printerr ("Error: opening dictionary `%s' failed: %s\n",
-				argv[i], error->message);
-			exit (EXIT_FAILURE);
-		}
+		g_printerr ("Error: opening a dictionary failed: %s\n",
+			error->message);
+		exit (EXIT_FAILURE);
 	}
 
-	gint c;
-	do
+	guint n_dicts = dictionaries->len;
+	StardictDict **dicts = g_alloca (sizeof *dicts * n_dicts);
+
+	guint i;
+	for (i = 0; i < n_dicts; i++)
+		dicts[i] = ((Dictionary *) g_ptr_array_index (dictionaries, i))->dict;
+
+	if (socket_path)
+		server_mode (dictionaries, formatter, socket_path);
+	else if (batch)
+		batch_mode (dicts, n_dicts, formatter);
+	else
 	{
-		GString *s = g_string_new (NULL);
-		while ((c = getchar ()) != EOF && c != '\n')
-			if (c != '\r')
+		GString *output = g_string_new (NULL);
+		gint c;
+		do
+		{
+			GString *s = g_string_new (NULL);
+			while ((c = getchar ()) != EOF && c != '\n')
 				g_string_append_c (s, c);
+			g_string_truncate (s, strip_carriage_returns (s->str, s->len));
 
-		if (s->len)
-			for (i = 0; i < n_dicts; i++)
-				do_dictionary (dicts[i], s->str, formatter);
+			if (s->len)
+				for (i = 0; i < n_dicts; i++)
+					do_dictionary (dicts[i], s->str, formatter, output);
 
-		printf ("\n");
-		fflush (NULL);
-		g_string_free (s, TRUE);
+			g_string_append_c (output, '\n');
+			fwrite (output->str, 1, output->len, stdout);
+			fflush (NULL);
+			g_string_truncate (output, 0);
+			g_string_free (s, TRUE);
+		}
+		while (c != EOF);
+		g_string_free (output, TRUE);
 	}
-	while (c != EOF);
 
-	for (i = 0; i < n_dicts; i++)
-		g_object_unref (dicts[i]);
+	for (i = 0; stats && i < dictionaries->len; i++)
+		print_stats (g_ptr_array_index (dictionaries, i));
 
+	g_ptr_array_free (dictionaries, TRUE);
+	g_free (socket_path);
 	return 0;
 }
@@ -21,8 +21,10 @@
 #include <string.h>
 #include <errno.h>
 #include <locale.h>
+#include <unistd.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <pango/pango.h>
 
@@ -42,6 +44,14 @@ set_data_error (GError **error, const gchar *message)
 	return FALSE;
 }
 
+static gboolean
+set_errno_error (GError **error)
+{
+	g_set_error_literal (error, G_IO_ERROR,
+		g_io_error_from_errno (errno), g_strerror (errno));
+	return FALSE;
+}
+
 static const gchar escapes[256] = { ['n'] = '\n', ['t'] = '\t', ['\\'] = '\\' };
 
 static gboolean
@@ -69,12 +79,24 @@ inplace_unescape (gchar *line, GError **error)
 	return TRUE;
 }
 
+// --- Records -----------------------------------------------------------------
+
+typedef struct record                   Record;
+
+/// A single line of input, which is parsed into an entry in place
+struct record
+{
+	gchar         * word;               ///< The keyword, or the whole line
+	gchar         * definition;         ///< The definition, once parsed
+	gsize           length;             ///< Length of the line, until parsed
+	gsize           line;               ///< Line number within the input
+};
+
 static gboolean
-import_line (Generator *generator, gchar *line, gsize len, GError **error)
+record_parse (Record *self, gboolean pango, GError **error)
 {
-	if (!len)
-		return TRUE;
-	if (!g_utf8_validate_len (line, len, NULL))
+	gchar *line = self->word;
+	if (!g_utf8_validate_len (line, self->length, NULL))
 		return set_data_error (error, "not valid UTF-8");
 
 	gchar *separator = strchr (line, '\t');
@@ -94,41 +116,324 @@ import_line (Generator *generator, gchar *line, gsize len, GError **error)
 	 || !inplace_unescape (separator, error))
 		return FALSE;
 
-	if (generator->info->same_type_sequence
-	 && *generator->info->same_type_sequence == STARDICT_FIELD_PANGO
+	if (pango
 	 && !pango_parse_markup (separator, -1, 0, NULL, NULL, NULL, error))
 		return FALSE;
 
-	generator_begin_entry (generator);
-	return generator_write_string (generator, separator, TRUE, error)
-		&& generator_finish_entry (generator, line, error);
+	self->definition = separator;
+	return TRUE;
+}
+
+/// Implements stardict_strcmp(), falling back to input order, which makes
+/// sorting stable, even across runs.
+static gint
+record_compare (gconstpointer a, gconstpointer b,
+	G_GNUC_UNUSED gpointer user_data)
+{
+	const Record *ra = a, *rb = b;
+	gint result = g_ascii_strcasecmp (ra->word, rb->word);
+	if (!result)
+		result = strcmp (ra->word, rb->word);
+	if (!result)
+		result = (ra->line > rb->line) - (ra->line < rb->line);
+	return result;
 }
 
 static gboolean
-transform (FILE *fsorted, Generator *generator, GError **error)
+record_write (const Record *self, FILE *fp)
 {
-	gchar *line = NULL;
-	gsize size = 0, ln = 1;
-	for (ssize_t read; (read = getline (&line, &size, fsorted)) >= 0; ln++)
-		if (!import_line (generator, line, read, error))
+	guint64 line = self->line;
+	return fwrite (&line, sizeof line, 1, fp) == 1
+		&& fwrite (self->word, strlen (self->word) + 1, 1, fp) == 1
+		&& fwrite (self->definition, strlen (self->definition) + 1, 1, fp) == 1;
+}
+
+static gboolean
+record_import (const Record *self, Generator *generator, GError **error)
+{
+	generator_begin_entry (generator);
+	return generator_write_string (generator, self->definition, TRUE, error)
+		&& generator_finish_entry (generator, self->word, error);
+}
+
+// --- Runs --------------------------------------------------------------------
+
+// Input that doesn't fit in memory is sorted in runs, which are stored
+// in temporary files, and merged once everything has been read.
+
+typedef struct run                      Run;
+
+/// A sorted sequence of records, either in memory, or in a temporary file
+struct run
+{
+	FILE          * fp;                 ///< Spilled records, or NULL
+	const Record  * records;            ///< In-memory records
+	gsize           remaining;          ///< In-memory records left
+
+	gboolean        valid;              ///< Whether @a current is valid
+	Record          current;            ///< The current record
+	gchar         * word;               ///< Read buffer for the keyword
+	size_t          word_size;          ///< Size of @a word
+	gchar         * definition;         ///< Read buffer for the definition
+	size_t          definition_size;    ///< Size of @a definition
+};
+
+static void
+run_next (Run *self)
+{
+	self->valid = FALSE;
+	if (!self->fp)
+	{
+		if (self->remaining)
+		{
+			self->current = *self->records++;
+			self->remaining--;
+			self->valid = TRUE;
+		}
+		return;
+	}
+
+	guint64 line = 0;
+	if (fread (&line, sizeof line, 1, self->fp) != 1
+	 || getdelim (&self->word, &self->word_size, '\0', self->fp) < 0
+	 || getdelim (&self->definition, &self->definition_size, '\0',
+		self->fp) < 0)
+		return;
+
+	self->current = (Record)
+		{ .word = self->word, .definition = self->definition, .line = line };
+	self->valid = TRUE;
+}
+
+// --- Import ------------------------------------------------------------------
+
+/// Number of megabytes of input to sort in memory by default
+#define IMPORT_DEFAULT_MEMORY  256
+
+typedef struct import                   Import;
+typedef struct import_slice             ImportSlice;
+
+struct import
+{
+	gboolean        pango;              ///< Definitions use Pango markup
+	gsize           limit;              ///< Approximate memory limit for runs
+
+	GStringChunk  * lines;              ///< Storage for the current run
+	GArray        * records;            ///< Records of the current run
+	gsize           size;               ///< Memory taken by the current run
+	GPtrArray     * spilled;            ///< FILE * of sorted runs
+
+	GThreadPool   * pool;               ///< Parses records
+	guint           n_threads;          ///< Number of threads in @a pool
+	GMutex          lock;               ///< Guards @a pending
+	GCond           done;               ///< Signalled when nothing's pending
+	guint           pending;            ///< Slices yet to be processed
+};
+
+/// A contiguous part of the current run, parsed by a single thread
+struct import_slice
+{
+	Import        * import;             ///< The import this belongs to
+	guint           start;              ///< The first record
+	guint           end;                ///< Past the last record
+	GError        * error;              ///< The first error encountered
+};
+
+static void
+import_parse_slice (ImportSlice *slice, G_GNUC_UNUSED gpointer user_data)
+{
+	Import *self = slice->import;
+	for (guint i = slice->start; i < slice->end; i++)
+	{
+		Record *record = &g_array_index (self->records, Record, i);
+		if (!record_parse (record, self->pango, &slice->error))
+		{
+			g_prefix_error (&slice->error, "line %zu: ", record->line);
 			break;
+		}
+	}
 
-	free (line);
-	if (ferror (fsorted))
+	g_mutex_lock (&self->lock);
+	if (!--self->pending)
+		g_cond_signal (&self->done);
+	g_mutex_unlock (&self->lock);
+}
+
+static void
+import_init (Import *self, gboolean pango, gsize limit)
+{
+	memset (self, 0, sizeof *self);
+	self->pango = pango;
+	self->limit = limit;
+
+	self->lines = g_string_chunk_new (1 << 20);
+	self->records = g_array_new (FALSE, FALSE, sizeof (Record));
+	self->spilled = g_ptr_array_new_with_free_func ((GDestroyNotify) fclose);
+
+	self->n_threads = g_get_num_processors ();
+	self->pool = g_thread_pool_new ((GFunc) import_parse_slice,
+		NULL, self->n_threads, TRUE, NULL);
+	g_assert (self->pool != NULL);
+	g_mutex_init (&self->lock);
+	g_cond_init (&self->done);
+}
+
+static void
+import_free (Import *self)
+{
+	g_thread_pool_free (self->pool, FALSE, TRUE);
+	g_mutex_clear (&self->lock);
+	g_cond_clear (&self->done);
+
+	g_string_chunk_free (self->lines);
+	g_array_free (self->records, TRUE);
+	g_ptr_array_free (self->spilled, TRUE);
+}
+
+/// Parse all records of the current run in parallel, and sort them.
+static gboolean
+import_sort_run (Import *self, GError **error)
+{
+	guint n = self->records->len;
+	guint n_slices = MIN (self->n_threads, n);
+	ImportSlice *slices = g_new0 (ImportSlice, n_slices);
+
+	self->pending = n_slices;
+	for (guint i = 0; i < n_slices; i++)
 	{
-		g_set_error_literal (error, G_IO_ERROR,
-			g_io_error_from_errno (errno), g_strerror (errno));
+		slices[i].import = self;
+		slices[i].start = (guint64) n *  i      / n_slices;
+		slices[i].end   = (guint64) n * (i + 1) / n_slices;
+		g_thread_pool_push (self->pool, &slices[i], NULL);
+	}
+
+	g_mutex_lock (&self->lock);
+	while (self->pending)
+		g_cond_wait (&self->done, &self->lock);
+	g_mutex_unlock (&self->lock);
+
+	// Report the error that comes first in the input
+	GError *e = NULL;
+	for (guint i = 0; i < n_slices; i++)
+		if (!e)
+			e = slices[i].error;
+		else if (slices[i].error)
+			g_error_free (slices[i].error);
+	g_free (slices);
+
+	if (e)
+	{
+		g_propagate_error (error, e);
 		return FALSE;
 	}
-	if (!feof (fsorted))
+
+	g_qsort_with_data (self->records->data, n, sizeof (Record),
+		record_compare, NULL);
+	return TRUE;
+}
+
+/// Move the current, sorted run to a temporary file.
+static gboolean
+import_spill_run (Import *self, GError **error)
+{
+	gchar *path = NULL;
+	gint fd = g_file_open_tmp ("tdv-tabfile-XXXXXX", &path, error);
+	if (fd == -1)
+		return FALSE;
+
+	// Nobody else needs to see the file, it will disappear once closed
+	(void) g_unlink (path);
+	g_free (path);
+
+	FILE *fp = fdopen (fd, "w+b");
+	if (!fp)
 	{
-		// You'll only get good line number output with presorted input!
-		g_prefix_error (error, "line %zu: ", ln);
+		set_errno_error (error);
+		close (fd);
 		return FALSE;
 	}
+
+	g_ptr_array_add (self->spilled, fp);
+	for (guint i = 0; i < self->records->len; i++)
+		if (!record_write (&g_array_index (self->records, Record, i), fp))
+			return set_errno_error (error);
+	if (fflush (fp) || fseek (fp, 0, SEEK_SET))
+		return set_errno_error (error);
+
+	g_array_set_size (self->records, 0);
+	g_string_chunk_clear (self->lines);
+	self->size = 0;
 	return TRUE;
 }
 
+/// Read all input, spilling sorted runs whenever the memory limit is reached.
+/// The last run is kept in memory.
+static gboolean
+import_read (Import *self, FILE *input, GError **error)
+{
+	gchar *line = NULL;
+	gsize size = 0, ln = 1;
+	gboolean ok = TRUE;
+	for (ssize_t read; ok && (read = getline (&line, &size, input)) >= 0; ln++)
+	{
+		Record record = { .length = read, .line = ln };
+		record.word = g_string_chunk_insert_len (self->lines, line, read);
+		g_array_append_val (self->records, record);
+
+		self->size += read + 1 + sizeof record;
+		if (self->size >= self->limit)
+			ok = import_sort_run (self, error)
+				&& import_spill_run (self, error);
+	}
+
+	free (line);
+	if (ok && ferror (input))
+		return set_errno_error (error);
+	return ok && import_sort_run (self, error);
+}
+
+/// Merge all runs into the generator.
+static gboolean
+import_write (Import *self, Generator *generator, GError **error)
+{
+	guint n_runs = self->spilled->len + 1;
+	Run *runs = g_new0 (Run, n_runs);
+	for (guint i = 0; i < self->spilled->len; i++)
+		runs[i].fp = g_ptr_array_index (self->spilled, i);
+	runs[n_runs - 1].records = (const Record *) self->records->data;
+	runs[n_runs - 1].remaining = self->records->len;
+	for (guint i = 0; i < n_runs; i++)
+		run_next (&runs[i]);
+
+	// There tend to be few enough runs that a heap wouldn't pay off
+	gboolean ok = TRUE;
+	while (ok)
+	{
+		Run *best = NULL;
+		for (guint i = 0; i < n_runs; i++)
+			if (runs[i].valid && (!best
+			 || record_compare (&runs[i].current, &best->current, NULL) < 0))
+				best = &runs[i];
+		if (!best)
+			break;
+
+		ok = record_import (&best->current, generator, error);
+		run_next (best);
+	}
+
+	for (guint i = 0; i < n_runs; i++)
+	{
+		if (ok && runs[i].fp && ferror (runs[i].fp))
+			ok = set_errno_error (error);
+		free (runs[i].word);
+		free (runs[i].definition);
+	}
+	g_free (runs);
+	return ok;
+}
+
+// --- Main --------------------------------------------------------------------
+
 static void
 validate_collation_locale (const gchar *locale)
 {
@@ -151,12 +456,17 @@ main (int argc, char *argv[])
 	g_option_context_set_summary (ctx,
 		"Create a StarDict dictionary from plaintext.");
 
-	gboolean pango_markup = FALSE;
+	gboolean pango_markup = FALSE, uncompressed = FALSE;
+	gint memory_limit = IMPORT_DEFAULT_MEMORY;
 	StardictInfo template = {};
 	GOptionEntry entries[] =
 	{
 		{ "pango",       'p', 0, G_OPTION_ARG_NONE,   &pango_markup,
 		  "Entries use Pango markup", NULL },
+		{ "uncompressed", 0,  0, G_OPTION_ARG_NONE,   &uncompressed,
+		  "Write a plain .dict file instead of .dict.dz", NULL },
+		{ "memory",      'm', 0, G_OPTION_ARG_INT,    &memory_limit,
+		  "Sort up to this much input in memory (default: 256)", "MIB" },
 
 		{ "book-name",   'b', 0, G_OPTION_ARG_STRING, &template.book_name,
 		  "Set the book name field", "TEXT" },
@@ -180,6 +490,8 @@ main (int argc, char *argv[])
 		fatal ("Error: option parsing failed: %s\n", error->message);
 	if (argc != 2)
 		fatal ("%s", g_option_context_get_help (ctx, TRUE, NULL));
+	if (memory_limit <= 0)
+		fatal ("Error: the memory limit must be positive\n");
 	g_option_context_free (ctx);
 
 	template.version = SD_VERSION_3_0_0;
@@ -200,24 +512,33 @@ main (int argc, char *argv[])
 	if (template.collation)
 		validate_collation_locale (template.collation);
 
-	// This actually implements stardict_strcmp(), POSIX-compatibly.
-	// Your sort(1) is not expected to be stable by default, like bsdsort is.
-	FILE *fsorted = popen ("LC_ALL=C sort -t'\t' -k1f,1", "r");
-	if (!fsorted)
-		fatal ("%s: %s\n", "popen", g_strerror (errno));
+	// The input is sorted by ourselves, so that it may come in any order
+	Import import;
+	import_init (&import, pango_markup, (gsize) memory_limit << 20);
+	if (!import_read (&import, stdin, &error))
+		fatal ("Error: failed to read the input: %s\n", error->message);
 
-	Generator *generator = generator_new (argv[1], &error);
+	Generator *generator = generator_new (argv[1], !uncompressed, &error);
 	if (!generator)
 		fatal ("Error: failed to create the output dictionary: %s\n",
 			error->message);
 
 	StardictInfo *info = generator->info;
 	stardict_info_copy (info, &template);
-	if (!transform (fsorted, generator, &error)
+	if (!import_write (&import, generator, &error)
 	 || !generator_finish (generator, &error))
 		fatal ("Error: failed to write the dictionary: %s\n", error->message);
 
+	gchar *ifo_path = g_strdup (info->path);
 	generator_free (generator);
-	pclose (fsorted);
+	import_free (&import);
+
+	// Loading the dictionary creates its index cache, which would otherwise
+	// have to be done by the first program to open it
+	StardictDict *dict = stardict_dict_new (ifo_path, &error);
+	if (!dict)
+		fatal ("Error: failed to load the dictionary: %s\n", error->message);
+	g_object_unref (dict);
+	g_free (ifo_path);
 	return 0;
 }
@@ -5,6 +5,9 @@
  *
  * Example: tdv-transform input.ifo output -- perl -p0e s/bullshit/soykaf/g
  *
+ * With --jobs, the filter is run repeatedly over consecutive parts of the
+ * input, several processes at a time, so it must not rely on seeing everything.
+ *
  * Copyright (c) 2020, Přemysl Eric Janouch <p@janouch.name>
  *
  * Permission to use, copy, modify, and/or distribute this software for any
@@ -25,6 +28,7 @@
 #include <string.h>
 #include <errno.h>
 #include <locale.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -42,10 +46,9 @@ enum { PIPE_READ, PIPE_WRITE };
 // --- Main --------------------------------------------------------------------
 
 static inline void
-print_progress (gulong *last_percent, StardictIterator *iterator, gsize total)
+print_progress (gulong *last_percent, gsize done, gsize total)
 {
-	gulong percent =
-		(gulong) stardict_iterator_get_offset (iterator) * 100 / total;
+	gulong percent = (gulong) done * 100 / total;
 	if (percent != *last_percent)
 	{
 		printf ("\r  Writing entries... %3lu%%", percent);
@@ -54,90 +57,472 @@ print_progress (gulong *last_percent, StardictIterator *iterator, gsize total)
 }
 
 static gboolean
-write_to_filter (StardictDict *dict, gint fd, GError **error)
+write_all (gint fd, const gchar *data, gsize len, GError **error)
+{
+	while (len)
+	{
+		ssize_t written = write (fd, data, len);
+		if (written >= 0)
+		{
+			data += written;
+			len -= written;
+		}
+		else if (errno != EINTR)
+		{
+			g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+				"%s", g_strerror (errno));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/// Write out textual fields of all entries in the order of their data,
+/// storing the index of the first field of each entry in @a field_starts.
+static gboolean
+write_to_filter (StardictDict *dict, gint fd, guint32 *field_starts,
+	GError **error)
 {
 	StardictInfo *info = stardict_dict_get_info (dict);
 	gsize n_words = stardict_info_get_word_count (info);
 
-	StardictIterator *iterator = stardict_iterator_new (dict, 0);
+	// Fields are borrowed from the dictionary where possible,
+	// and the filter gets them in larger batches
+	StardictEntryView view;
+	stardict_entry_view_init (&view);
+	GString *buffer = g_string_sized_new (1 << 16);
+	gboolean ok = TRUE;
+
+	StardictScan *scan = stardict_scan_new (dict, 0, n_words, TRUE);
+	StardictIterator *iterator = NULL;
 	gulong last_percent = -1;
-	while (stardict_iterator_is_valid (iterator))
+	guint32 n_fields = 0;
+	for (gsize done = 0; ok && (iterator = stardict_scan_next (scan)); done++)
 	{
-		print_progress (&last_percent, iterator, n_words);
+		print_progress (&last_percent, done, n_words);
+		field_starts[stardict_iterator_get_offset (iterator)] = n_fields;
 
-		StardictEntry *entry = stardict_iterator_get_entry (iterator);
-		for (const GList *fields = stardict_entry_get_fields (entry);
-			fields; fields = fields->next)
+		(void) stardict_iterator_get_entry_view (iterator, &view);
+		for (guint i = 0; i < view.fields->len; i++)
 		{
-			StardictEntryField *field = fields->data;
+			StardictEntryField *field =
+				&g_array_index (view.fields, StardictEntryField, i);
 			if (!g_ascii_islower (field->type))
 				continue;
 
-			if (write (fd, field->data, field->data_size)
-				!= (ssize_t) field->data_size)
-			{
-				g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
-					"%s", g_strerror (errno));
-				return FALSE;
-			}
+			g_string_append_len (buffer, field->data, field->data_size);
+			g_string_append_c (buffer, '\0');
+			n_fields++;
 		}
+		if (buffer->len >= (1 << 16))
+		{
+			ok = write_all (fd, buffer->str, buffer->len, error);
+			g_string_truncate (buffer, 0);
+		}
+	}
+	if (ok)
+		ok = write_all (fd, buffer->str, buffer->len, error);
+	if (ok)
+		printf ("\n");
+
+	stardict_scan_free (scan);
+	g_string_free (buffer, TRUE);
+	stardict_entry_view_clear (&view);
+	return ok;
+}
 
-		g_object_unref (entry);
-		stardict_iterator_next (iterator);
+/// Write out an entry with its textual fields replaced by consecutive filter
+/// outputs, starting at index @a i, which is advanced past them.
+/// The entry itself is left alone, as it may be shared with the entry cache.
+static gboolean
+write_filtered_entry (Generator *generator, StardictEntry *entry,
+	const gchar *word, GPtrArray *outputs, guint32 *i, GError **error)
+{
+	GList *original = entry ? entry->fields : NULL;
+	StardictEntryField *copies =
+		g_new (StardictEntryField, g_list_length (original) + 1);
+
+	GList *fields = NULL;
+	gboolean ok = TRUE;
+	for (StardictEntryField *copy = copies; ok && original;
+		original = original->next, copy++)
+	{
+		*copy = *(StardictEntryField *) original->data;
+		fields = g_list_prepend (fields, copy);
+		if (!g_ascii_islower (copy->type))
+			continue;
+
+		if (*i >= outputs->len)
+		{
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+				"filter seems to have ended too early");
+			ok = FALSE;
+			break;
+		}
+
+		copy->data = g_ptr_array_index (outputs, (*i)++);
+		copy->data_size = strlen (copy->data) + 1;
 	}
-	printf ("\n");
-	return TRUE;
+
+	fields = g_list_reverse (fields);
+	generator_begin_entry (generator);
+	ok = ok && generator_write_fields (generator, fields, error)
+		&& generator_finish_entry (generator, word, error);
+
+	g_list_free (fields);
+	g_free (copies);
+	return ok;
 }
 
+/// Split filter output into NUL-terminated records, pointing into the data.
+/// Any trailing bytes without a terminator are left out.
+static GPtrArray *
+split_filter_output (gchar *filtered, const gchar *filtered_end)
+{
+	GPtrArray *outputs = g_ptr_array_new ();
+	for (gchar *end; (end = memchr (filtered, 0, filtered_end - filtered)); )
+	{
+		g_ptr_array_add (outputs, filtered);
+		filtered = end + 1;
+	}
+	return outputs;
+}
+
+/// Write out all entries in index order, with their textual fields replaced
+/// by the filter's output, which follows the order of write_to_filter().
 static gboolean
 update_from_filter (StardictDict *dict, Generator *generator,
-	GMappedFile *filtered_file, GError **error)
+	GMappedFile *filtered_file, const guint32 *field_starts, GError **error)
 {
 	gchar *filtered = g_mapped_file_get_contents (filtered_file);
 	gchar *filtered_end = filtered + g_mapped_file_get_length (filtered_file);
 
+	// Fields need to be picked out of the output in a different order
+	GPtrArray *outputs = split_filter_output (filtered, filtered_end);
+
 	StardictInfo *info = stardict_dict_get_info (dict);
 	gsize n_words = stardict_info_get_word_count (info);
 
-	StardictIterator *iterator = stardict_iterator_new (dict, 0);
+	// Not needing the data order still makes the scan read ahead
+	StardictScan *scan = stardict_scan_new (dict, 0, n_words, FALSE);
+	StardictIterator *iterator = NULL;
 	gulong last_percent = -1;
-	while (stardict_iterator_is_valid (iterator))
+	gboolean ok = TRUE;
+	for (gsize done = 0; ok && (iterator = stardict_scan_next (scan)); done++)
 	{
-		print_progress (&last_percent, iterator, n_words);
+		print_progress (&last_percent, done, n_words);
 
 		StardictEntry *entry = stardict_iterator_get_entry (iterator);
-		generator_begin_entry (generator);
+		guint32 i = field_starts[stardict_iterator_get_offset (iterator)];
+		ok = write_filtered_entry (generator, entry,
+			stardict_iterator_get_word (iterator), outputs, &i, error);
+		g_object_unref (entry);
+	}
+	if (ok)
+		printf ("\n");
+
+	stardict_scan_free (scan);
+	g_ptr_array_free (outputs, TRUE);
+	return ok;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Rather than spooling all fields through a single filter, the dictionary
+// can be cut into shards, each of which is given to a separate filter process,
+// several of them running concurrently.  Their output is reassembled in order,
+// and written out as soon as possible.  Only a limited number of shards may
+// exist at any time, so that memory usage stays bounded.
+
+/// Approximate amount of fields to be processed by a single filter process
+#define SHARD_SIZE  (1 << 20)
+
+/// How many shards may be in the pipeline per job
+#define SHARDS_PER_JOB  2
+
+typedef struct shard Shard;
+
+/// A contiguous part of the dictionary, filtered by a single process
+struct shard
+{
+	guint32 sequence;                   ///< Position of the shard
+	GPtrArray *words;                   ///< Words of the entries
+	GPtrArray *entries;                 ///< StardictEntry objects or NULL
+	GString *input;                     ///< NUL-separated textual fields
+	GByteArray *output;                 ///< Output of the filter
+};
+
+/// Tells jobs that there is nothing more to do
+static Shard end_of_input;
+
+static void
+entry_free (gpointer entry)
+{
+	if (entry)
+		g_object_unref (entry);
+}
+
+static Shard *
+shard_new (guint32 sequence)
+{
+	Shard *self = g_slice_new (Shard);
+	self->sequence = sequence;
+	self->words = g_ptr_array_new_with_free_func (g_free);
+	self->entries = g_ptr_array_new_with_free_func (entry_free);
+	self->input = g_string_new (NULL);
+	self->output = g_byte_array_new ();
+	return self;
+}
+
+static void
+shard_free (Shard *self)
+{
+	g_ptr_array_free (self->words, TRUE);
+	g_ptr_array_free (self->entries, TRUE);
+	g_string_free (self->input, TRUE);
+	g_byte_array_free (self->output, TRUE);
+	g_slice_free (Shard, self);
+}
+
+typedef struct parallel Parallel;
+
+struct parallel
+{
+	StardictDict *dict;                 ///< The dictionary object
+	gchar **argv;                       ///< The filter's command line
+	guint n_jobs;                       ///< Number of filters to run at once
+
+	GAsyncQueue *todo;                  ///< Shards to be filtered
+	GAsyncQueue *done;                  ///< Shards to be written out
+
+	GMutex slots_mutex;                 ///< Locks @a slots
+	GCond slots_cond;                   ///< Signals a freed slot
+	guint slots;                        ///< How many shards may be created
+};
+
+/// Reads entries in index order, and cuts them into shards.
+static gpointer
+parallel_producer (Parallel *self)
+{
+	StardictInfo *info = stardict_dict_get_info (self->dict);
+	StardictScan *scan = stardict_scan_new (self->dict,
+		0, stardict_info_get_word_count (info), FALSE);
+	StardictIterator *iterator = stardict_scan_next (scan);
 
-		for (GList *fields = entry->fields; fields; fields = fields->next)
+	guint32 sequence = 0;
+	while (iterator)
+	{
+		g_mutex_lock (&self->slots_mutex);
+		while (!self->slots)
+			g_cond_wait (&self->slots_cond, &self->slots_mutex);
+		self->slots--;
+		g_mutex_unlock (&self->slots_mutex);
+
+		Shard *shard = shard_new (sequence++);
+		for (; iterator && shard->input->len < SHARD_SIZE;
+			iterator = stardict_scan_next (scan))
 		{
-			StardictEntryField *field = fields->data;
-			if (!g_ascii_islower (field->type))
-				continue;
+			StardictEntry *entry = stardict_iterator_get_entry (iterator);
+			g_ptr_array_add (shard->words,
+				g_strdup (stardict_iterator_get_word (iterator)));
+			g_ptr_array_add (shard->entries, entry);
 
-			gchar *end = memchr (filtered, 0, filtered_end - filtered);
-			if (!end)
+			for (GList *fields = entry ? entry->fields : NULL;
+				fields; fields = fields->next)
 			{
-				g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
-					"filter seems to have ended too early");
-				return FALSE;
-			}
+				StardictEntryField *field = fields->data;
+				if (!g_ascii_islower (field->type))
+					continue;
 
-			g_free (field->data);
-			field->data = g_strdup (filtered);
-			field->data_size = end - filtered + 1;
-			filtered = end + 1;
+				// The data size of owned entries includes the terminator
+				g_string_append_len (shard->input,
+					field->data, strlen (field->data) + 1);
+			}
 		}
+		g_async_queue_push (self->todo, shard);
+	}
+	stardict_scan_free (scan);
 
-		if (!generator_write_fields (generator, entry->fields, error)
-		 || !generator_finish_entry (generator,
-				stardict_iterator_get_word (iterator), error))
-			return FALSE;
+	for (guint i = 0; i < self->n_jobs; i++)
+		g_async_queue_push (self->todo, &end_of_input);
 
-		g_object_unref (entry);
-		stardict_iterator_next (iterator);
+	// An empty shard tells the writer how many shards there are
+	g_async_queue_push (self->done, shard_new (sequence));
+	return NULL;
+}
+
+typedef struct feed Feed;
+
+struct feed
+{
+	gint fd;                            ///< Standard input of the filter
+	GString *input;                     ///< Data to be written
+};
+
+static gpointer
+parallel_feed (Feed *feed)
+{
+	GError *error = NULL;
+	if (!write_all (feed->fd, feed->input->str, feed->input->len, &error)
+	 || !g_close (feed->fd, &error))
+		fatal ("write to filter failed: %s\n", error->message);
+	return NULL;
+}
+
+/// Runs a new filter process over the shard.  It is fed from another thread,
+/// so that it may write output while still reading input.
+static void
+parallel_filter (Parallel *self, Shard *shard)
+{
+	GError *error = NULL;
+	GPid pid = -1;
+	gint child_in = -1, child_out = -1;
+	if (!g_spawn_async_with_pipes (NULL /* working_directory */,
+		self->argv, NULL /* envp */,
+		G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+		NULL /* child_setup */, NULL /* user_data */,
+		&pid, &child_in, &child_out, NULL /* standard_error */, &error))
+		fatal ("g_spawn: %s\n", error->message);
+
+	Feed feed = { .fd = child_in, .input = shard->input };
+	GThread *feeder =
+		g_thread_new ("feeder", (GThreadFunc) parallel_feed, &feed);
+
+	guint8 buffer[1 << 16];
+	ssize_t len;
+	while ((len = read (child_out, buffer, sizeof buffer)))
+		if (len > 0)
+			g_byte_array_append (shard->output, buffer, len);
+		else if (errno != EINTR)
+			fatal ("read from filter failed: %s\n", g_strerror (errno));
+
+	g_close (child_out, NULL);
+	g_thread_join (feeder);
+
+	int wstatus = errno = 0;
+	if (waitpid (pid, &wstatus, 0) < 1
+	 || !WIFEXITED (wstatus) || WEXITSTATUS (wstatus) > 0)
+		fatal ("Filter failed (%s, status %d)\n", g_strerror (errno), wstatus);
+	g_spawn_close_pid (pid);
+}
+
+/// Filters shards until there are none left.
+static gpointer
+parallel_job (Parallel *self)
+{
+	Shard *shard;
+	while ((shard = g_async_queue_pop (self->todo)) != &end_of_input)
+	{
+		parallel_filter (self, shard);
+		g_async_queue_push (self->done, shard);
 	}
-	printf ("\n");
-	return TRUE;
+	return NULL;
+}
+
+/// Write out all entries in the shard, with their textual fields replaced
+/// by the filter's output.
+static gboolean
+parallel_write_shard (Shard *shard, Generator *generator, GError **error)
+{
+	gchar *output = (gchar *) shard->output->data;
+	GPtrArray *outputs =
+		split_filter_output (output, output + shard->output->len);
+
+	guint32 next = 0;
+	gboolean ok = TRUE;
+	for (guint i = 0; ok && i < shard->entries->len; i++)
+		ok = write_filtered_entry (generator,
+			g_ptr_array_index (shard->entries, i),
+			g_ptr_array_index (shard->words, i), outputs, &next, error);
+
+	// Each shard has its own filter, so this can actually be checked
+	if (ok && (next < outputs->len
+	 || (shard->output->len && output[shard->output->len - 1])))
+	{
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			"filter has produced more output than expected");
+		ok = FALSE;
+	}
+
+	g_ptr_array_free (outputs, TRUE);
+	return ok;
+}
+
+/// Filter the dictionary using multiple processes at once.
+static gboolean
+parallel_transform (StardictDict *dict, gchar **argv, guint n_jobs,
+	Generator *generator, GError **error)
+{
+	Parallel self =
+	{
+		.dict = dict,
+		.argv = argv,
+		.n_jobs = n_jobs,
+		.todo = g_async_queue_new (),
+		.done = g_async_queue_new (),
+		.slots = SHARDS_PER_JOB * n_jobs,
+	};
+	g_mutex_init (&self.slots_mutex);
+	g_cond_init (&self.slots_cond);
+
+	GThread *producer = g_thread_new ("producer",
+		(GThreadFunc) parallel_producer, &self);
+	GThread **jobs = g_new (GThread *, n_jobs);
+	for (guint i = 0; i < n_jobs; i++)
+		jobs[i] = g_thread_new ("job", (GThreadFunc) parallel_job, &self);
+
+	// Shards come finished in any order, but have to be written in sequence
+	StardictInfo *info = stardict_dict_get_info (dict);
+	gsize n_words = stardict_info_get_word_count (info);
+	GHashTable *pending = g_hash_table_new (NULL, NULL);
+	guint32 next = 0, total = G_MAXUINT32;
+	gulong last_percent = -1;
+	gsize written = 0;
+	gboolean ok = TRUE;
+	while (next != total)
+	{
+		Shard *shard = g_hash_table_lookup (pending, GUINT_TO_POINTER (next));
+		if (!shard)
+		{
+			shard = g_async_queue_pop (self.done);
+			if (shard->entries->len)
+				g_hash_table_insert (pending,
+					GUINT_TO_POINTER (shard->sequence), shard);
+			else
+			{
+				total = shard->sequence;
+				shard_free (shard);
+			}
+			continue;
+		}
+
+		g_hash_table_remove (pending, GUINT_TO_POINTER (next++));
+		if (ok)
+			ok = parallel_write_shard (shard, generator, error);
+		written += shard->entries->len;
+		shard_free (shard);
+		print_progress (&last_percent, written, MAX (n_words, 1));
+
+		// Even after a failure, the pipeline needs to be drained
+		g_mutex_lock (&self.slots_mutex);
+		self.slots++;
+		g_cond_signal (&self.slots_cond);
+		g_mutex_unlock (&self.slots_mutex);
+	}
+	if (ok)
+		printf ("\n");
+
+	g_thread_join (producer);
+	for (guint i = 0; i < n_jobs; i++)
+		g_thread_join (jobs[i]);
+	g_free (jobs);
+
+	g_hash_table_destroy (pending);
+	g_async_queue_unref (self.todo);
+	g_async_queue_unref (self.done);
+	g_mutex_clear (&self.slots_mutex);
+	g_cond_clear (&self.slots_cond);
+	return ok;
 }
 
 int
@@ -151,11 +536,26 @@ main (int argc, char *argv[])
 		("input.ifo output-basename -- FILTER [ARG...]");
 	g_option_context_set_summary
 		(ctx, "Transform dictionaries using a filter program.");
+
+	gboolean uncompressed = FALSE;
+	gint n_jobs = 1;
+	GOptionEntry entries[] =
+	{
+		{ "uncompressed", 0, 0, G_OPTION_ARG_NONE, &uncompressed,
+		  "Write a plain .dict file instead of .dict.dz", NULL },
+		{ "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs,
+		  "Run N filters in parallel, each on a part of the input", "N" },
+		{ }
+	};
+
+	g_option_context_add_main_entries (ctx, entries, NULL);
 	if (!g_option_context_parse (ctx, &argc, &argv, &error))
 		fatal ("Error: option parsing failed: %s\n", error->message);
 
 	if (argc < 3)
 		fatal ("%s", g_option_context_get_help (ctx, TRUE, NULL));
+	if (n_jobs < 1)
+		fatal ("Error: invalid number of jobs\n");
 
 	// GLib is bullshit, getopt_long() always correctly removes this
 	gint program_argv_start = 3;
@@ -169,6 +569,32 @@ main (int argc, char *argv[])
 	if (!dict)
 		fatal ("Error: opening the dictionary failed: %s\n", error->message);
 
+	// Entries are only ever processed sequentially, caching would be wasteful
+	stardict_dict_set_entry_cache_limit (dict, 0);
+
+	if (n_jobs > 1)
+	{
+		Generator *generator = generator_new (argv[2], !uncompressed, &error);
+		if (!generator)
+			fatal ("Error: failed to create the output dictionary: %s\n",
+				error->message);
+
+		StardictInfo *info = generator->info;
+		stardict_info_copy (info, stardict_dict_get_info (dict));
+		info->word_count = 0;
+
+		printf ("Filtering entries in %d jobs...\n", n_jobs);
+		if (!parallel_transform (dict, argv + program_argv_start, n_jobs,
+				generator, &error)
+		 || !generator_finish (generator, &error))
+			fatal ("Error: failed to write the dictionary: %s\n",
+				error->message);
+
+		generator_free (generator);
+		g_object_unref (dict);
+		return 0;
+	}
+
 	printf ("Filtering entries...\n");
 	gint child_in[2];
 	if (!g_unix_open_pipe (child_in, 0, &error))
@@ -185,7 +611,9 @@ main (int argc, char *argv[])
 		NULL /* child_setup */, NULL /* user_data */,
 		&pid, child_in[PIPE_READ], fileno (child_out), STDERR_FILENO, &error))
 		fatal ("g_spawn: %s\n", error->message);
-	if (!write_to_filter (dict, child_in[PIPE_WRITE], &error))
+	guint32 *field_starts = g_new (guint32,
+		stardict_info_get_word_count (stardict_dict_get_info (dict)));
+	if (!write_to_filter (dict, child_in[PIPE_WRITE], field_starts, &error))
 		fatal ("write_to_filter: %s\n", error->message);
 	if (!g_close (child_in[PIPE_READ], &error)
 	 || !g_close (child_in[PIPE_WRITE], &error))
@@ -203,7 +631,7 @@ main (int argc, char *argv[])
 		fatal ("g_mapped_file_new_from_fd: %s\n", error->message);
 
 	printf ("Writing the new dictionary...\n");
-	Generator *generator = generator_new (argv[2], &error);
+	Generator *generator = generator_new (argv[2], !uncompressed, &error);
 	if (!generator)
 		fatal ("Error: failed to create the output dictionary: %s\n",
 			error->message);
@@ -214,10 +642,11 @@ main (int argc, char *argv[])
 	// This gets incremented each time an entry is finished
 	info->word_count = 0;
 
-	if (!update_from_filter (dict, generator, filtered, &error)
+	if (!update_from_filter (dict, generator, filtered, field_starts, &error)
 	 || !generator_finish (generator, &error))
 		fatal ("Error: failed to write the dictionary: %s\n", error->message);
 
+	g_free (field_starts);
 	g_mapped_file_unref (filtered);
 	fclose (child_out);
 	generator_free (generator);
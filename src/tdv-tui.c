@@ -46,6 +46,8 @@
 
 #define TOP_BAR_CUTOFF  2               ///< How many lines are reserved on top
 #define APP_TITLE  PROJECT_NAME " "     ///< Left top corner
+#define APP_MERGED_LIMIT  100          ///< Entries taken from each dictionary
+#define APP_LOADED_LIMIT  1024          ///< Decoded entries kept around
 
 #ifndef A_ITALIC
 #define A_ITALIC 0
@@ -100,7 +102,8 @@ add_read_watch (int fd, GIOFunc func, gpointer user_data)
 	XX( EVEN,      "even",          -1, -1, 0           ) \
 	XX( ODD,       "odd",           -1, -1, 0           ) \
 	XX( SELECTION, "selection",     -1, -1, A_REVERSE   ) \
-	XX( DEFOCUSED, "defocused",     -1, -1, A_REVERSE   )
+	XX( DEFOCUSED, "defocused",     -1, -1, A_REVERSE   ) \
+	XX( HINT,      "hint",          -1, -1, A_DIM       )
 
 enum
 {
@@ -119,20 +122,55 @@ struct attrs
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+/// Identifies an entry within any of the dictionaries.
+typedef struct entry_key                EntryKey;
 /// Data relating to one entry within the dictionary.
 typedef struct view_entry               ViewEntry;
+/// A request to decode an entry in the background.
+typedef struct entry_job                EntryJob;
+/// What has been drawn on a line of the view.
+typedef struct view_row                 ViewRow;
 /// Data relating to a dictionary file.
 typedef struct app_dictionary           AppDictionary;
 /// Encloses application data.
 typedef struct application              Application;
 
+struct entry_key
+{
+	StardictDict * dict;                ///< The dictionary, referenced
+	guint32     position;               ///< Index position within it
+};
+
 struct view_entry
 {
+	EntryKey    key;                    ///< Where the entry comes from
+	gboolean    placeholder;            ///< Still being decoded
+	guint64     serial;                 ///< Identifies the view's copy, or 0
+	const gchar * source;               ///< Name appended to the word or NULL
 	gchar     * word;                   ///< Word
 	GPtrArray * definitions;            ///< Word definition entries (gchar *)
 	GPtrArray * formatting;             ///< chtype * or NULL per definition
 };
 
+struct entry_job
+{
+	EntryKey    key;                    ///< The entry to decode
+	Application * app;                  ///< The application
+	ViewEntry * result;                 ///< The decoded entry, or NULL
+};
+
+struct view_row
+{
+	guint64     serial;                 ///< Serial of the entry, 0 if empty
+	guint       definition;             ///< Index of the definition
+	chtype      attrs;                  ///< Attributes of the whole row
+	gsize       common_prefix;          ///< Highlighted initial part of word
+	gint        left_width;             ///< Width of the left column
+};
+
+/// Stands for rows in an unknown state, which always need to be drawn
+#define VIEW_ROW_UNKNOWN  G_MAXUINT64
+
 struct app_dictionary
 {
 	Dictionary  super;                  ///< Superclass
@@ -149,20 +187,33 @@ struct application
 	gboolean        focused;            ///< Whether the terminal has focus
 
 	GPtrArray     * dictionaries;       ///< All loaded AppDictionaries
+	gsize           memory_budget;      ///< Limit for loaded dictionary data
+	guint           evict_timer;        ///< Releases idle dictionaries' data
 
 	StardictDict  * dict;               ///< The current dictionary
 	StardictDict  * last;               ///< The last dictionary
+	StardictSearch * search;            ///< Type-ahead search state
+	GArray        * results;            ///< Full-text search results or NULL
+	MergedSearch  * merged;             ///< All dictionaries' results or NULL
+	GThreadPool   * loader;             ///< Decodes entries in the background
+	GHashTable    * loaded;             ///< Decoded ViewEntry-s by EntryKey
+	GHashTable    * loading;            ///< EntryJob-s in progress by EntryKey
 	guint           show_help : 1;      ///< Whether help can be shown
 	guint           center_search : 1;  ///< Whether to center the search
 	guint           underline_last : 1; ///< Underline the last definition
 	guint           hl_prefix : 1;      ///< Highlight the common prefix
 	guint           watch_x11_sel : 1;  ///< Requested X11 selection watcher
+	guint           fulltext : 1;       ///< Search within definitions
+	guint           merge_all : 1;      ///< Search all dictionaries at once
+	guint           show_stats : 1;     ///< Show the current dict.'s statistics
 
 	guint           dict_offset;        ///< Scroll position of the tab bar
 	guint32         top_position;       ///< Index of the topmost dict. entry
 	guint           top_offset;         ///< Offset into the top entry
 	guint           selected;           ///< Offset to the selected definition
 	GPtrArray     * entries;            ///< ViewEntry-s within the view
+	guint64         last_serial;        ///< Last serial of a ViewEntry
+	GArray        * rows;               ///< ViewRow-s as shown on the screen
 
 	gchar         * search_label;       ///< Text of the "Search" label
 	gsize           search_label_width; ///< Visible width of "search_label"
@@ -170,6 +221,8 @@ struct application
 	guint           input_pos;          ///< Cursor position within input
 	guint           input_offset;       ///< Render offset in codepoints
 	gboolean        input_confirmed;    ///< Input has been confirmed
+	gchar         * hint;               ///< Similar words, or NULL
+	StardictDict  * fuzzy_pending;      ///< Awaiting its fuzzy index, or NULL
 
 	gfloat          division;           ///< Position of the division column
 
@@ -298,6 +351,11 @@ view_entry_new (StardictIterator *iterator)
 	g_return_val_if_fail (stardict_iterator_is_valid (iterator), NULL);
 
 	ViewEntry *ve = g_slice_alloc (sizeof *ve);
+	ve->key.dict = g_object_ref (iterator->owner);
+	ve->key.position = stardict_iterator_get_offset (iterator);
+	ve->placeholder = FALSE;
+	ve->serial = 0;
+	ve->source = NULL;
 	GString *word = g_string_new (stardict_iterator_get_word (iterator));
 
 	StardictEntry *entry = stardict_iterator_get_entry (iterator);
@@ -343,36 +401,224 @@ view_entry_new (StardictIterator *iterator)
 	return ve;
 }
 
+/// Make a stand-in for an entry that hasn't been decoded yet.
+static ViewEntry *
+view_entry_new_placeholder (StardictIterator *iterator)
+{
+	ViewEntry *ve = g_slice_alloc (sizeof *ve);
+	ve->key.dict = g_object_ref (iterator->owner);
+	ve->key.position = stardict_iterator_get_offset (iterator);
+	ve->placeholder = TRUE;
+	ve->serial = 0;
+	ve->source = NULL;
+	ve->word = g_strdup (stardict_iterator_get_word (iterator));
+	ve->definitions = g_ptr_array_new_with_free_func (g_free);
+	ve->formatting = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (ve->definitions, g_strdup_printf ("<%s>", _("loading")));
+	g_ptr_array_add (ve->formatting, NULL);
+	return ve;
+}
+
+/// Make a deep copy of the view entry.
+static ViewEntry *
+view_entry_copy (const ViewEntry *ve)
+{
+	ViewEntry *copy = g_slice_alloc (sizeof *copy);
+	copy->key.dict = g_object_ref (ve->key.dict);
+	copy->key.position = ve->key.position;
+	copy->placeholder = ve->placeholder;
+	copy->serial = ve->serial;
+	copy->source = ve->source;
+	copy->word = g_strdup (ve->word);
+	copy->definitions = g_ptr_array_new_with_free_func (g_free);
+	copy->formatting = g_ptr_array_new_with_free_func (g_free);
+	for (guint i = 0; i < ve->definitions->len; i++)
+	{
+		const gchar *definition = g_ptr_array_index (ve->definitions, i);
+		const chtype *formatting = g_ptr_array_index (ve->formatting, i);
+		g_ptr_array_add (copy->definitions, g_strdup (definition));
+		g_ptr_array_add (copy->formatting, !formatting ? NULL
+			: g_memdup2 (formatting, strlen (definition) * sizeof *formatting));
+	}
+	return copy;
+}
+
 /// Release resources associated with the view entry.
 static void
 view_entry_free (ViewEntry *ve)
 {
+	g_object_unref (ve->key.dict);
 	g_free (ve->word);
 	g_ptr_array_free (ve->definitions, TRUE);
 	g_ptr_array_free (ve->formatting, TRUE);
 	g_slice_free1 (sizeof *ve, ve);
 }
 
+static guint
+entry_key_hash (gconstpointer key)
+{
+	const EntryKey *k = key;
+	return g_direct_hash (k->dict) ^ k->position;
+}
+
+static gboolean
+entry_key_equal (gconstpointer a, gconstpointer b)
+{
+	const EntryKey *ka = a, *kb = b;
+	return ka->dict == kb->dict && ka->position == kb->position;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-/// Reload view items.
+/// Find the entry at the given position within the view's contents,
+/// which is either the whole dictionary, full-text search results,
+/// or results merged from all dictionaries.  Returns NULL past the end.
+static StardictIterator *
+app_resolve_position (Application *self, guint32 position,
+	const gchar **source)
+{
+	StardictDict *dict = self->dict;
+	if (self->merged)
+	{
+		GArray *results = self->merged->results;
+		if (position >= results->len)
+			return NULL;
+
+		MergedResult *result = &g_array_index (results, MergedResult, position);
+		Dictionary *dictionary =
+			g_ptr_array_index (self->dictionaries, result->dictionary);
+		dict = result->dict;
+		position = result->position;
+		if (source)
+			*source = dictionary->name;
+	}
+	else if (self->results)
+	{
+		if (position >= self->results->len)
+			return NULL;
+		position = g_array_index (self->results, guint32, position);
+	}
+
+	StardictIterator *iterator = stardict_iterator_new (dict, position);
+	if (stardict_iterator_is_valid (iterator))
+		return iterator;
+
+	g_object_unref (iterator);
+	return NULL;
+}
+
+static gboolean app_on_entry_loaded (gpointer data);
+
+static void
+entry_job_free (EntryJob *job)
+{
+	if (job->result)
+		view_entry_free (job->result);
+	g_object_unref (job->key.dict);
+	g_slice_free (EntryJob, job);
+}
+
+static void
+entry_job_run (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+	EntryJob *job = data;
+	StardictIterator *iterator =
+		stardict_iterator_new (job->key.dict, job->key.position);
+	if (stardict_iterator_is_valid (iterator))
+		job->result = view_entry_new (iterator);
+	g_object_unref (iterator);
+
+	g_idle_add (app_on_entry_loaded, job);
+}
+
+/// Have the entry decoded in the background, unless it already is.
+static void
+app_load_entry (Application *self, const EntryKey *key)
+{
+	if (g_hash_table_contains (self->loaded, key)
+	 || g_hash_table_contains (self->loading, key))
+		return;
+
+	EntryJob *job = g_slice_new0 (EntryJob);
+	job->key.dict = g_object_ref (key->dict);
+	job->key.position = key->position;
+	job->app = self;
+	g_hash_table_add (self->loading, job);
+	g_thread_pool_push (self->loader, job, NULL);
+}
+
+/// Create a view entry for the given position within the view's contents.
+/// Entries that haven't been decoded yet are substituted with placeholders.
+/// Decoded entries found in @a reusable are taken from there instead.
+static ViewEntry *
+entry_for_position (Application *self, guint32 position, GHashTable *reusable)
+{
+	const gchar *source = NULL;
+	StardictIterator *iterator =
+		app_resolve_position (self, position, &source);
+	if (!iterator)
+		return NULL;
+
+	EntryKey key = { iterator->owner, stardict_iterator_get_offset (iterator) };
+	ViewEntry *ve = reusable ? g_hash_table_lookup (reusable, &key) : NULL;
+	if (ve && ve->source == source)
+	{
+		g_hash_table_steal (reusable, ve);
+		g_object_unref (iterator);
+		return ve;
+	}
+
+	if ((ve = g_hash_table_lookup (self->loaded, &key)))
+		ve = view_entry_copy (ve);
+	else
+	{
+		ve = view_entry_new_placeholder (iterator);
+		app_load_entry (self, &key);
+	}
+	g_object_unref (iterator);
+
+	// Rows drawn on the screen refer to entries by this
+	ve->serial = ++self->last_serial;
+	if ((ve->source = source))
+	{
+		gchar *word = g_strdup_printf ("%s (%s)", ve->word, source);
+		g_free (ve->word);
+		ve->word = word;
+	}
+	return ve;
+}
+
+/// Reload view items.  Decoded entries that stay in the view are kept,
+/// so that they don't need to be copied, nor redrawn.
 static void
 app_reload_view (Application *self)
 {
-	if (self->entries->len != 0)
-		g_ptr_array_remove_range (self->entries, 0, self->entries->len);
+	GHashTable *reusable = g_hash_table_new_full (entry_key_hash,
+		entry_key_equal, (GDestroyNotify) view_entry_free, NULL);
+	for (guint i = 0; i < self->entries->len; i++)
+	{
+		ViewEntry *ve = g_ptr_array_index (self->entries, i);
+		if (ve->placeholder)
+			view_entry_free (ve);
+		else
+			g_hash_table_add (reusable, ve);
+	}
+
+	// The array would free entries that have rather been moved to the table
+	g_ptr_array_set_free_func (self->entries, NULL);
+	g_ptr_array_set_size (self->entries, 0);
+	g_ptr_array_set_free_func (self->entries,
+		(GDestroyNotify) view_entry_free);
 
 	gint remains = LINES - TOP_BAR_CUTOFF + self->top_offset;
-	StardictIterator *iterator =
-		stardict_iterator_new (self->dict, self->top_position);
-	while (remains > 0 && stardict_iterator_is_valid (iterator))
+	ViewEntry *entry;
+	while (remains > 0 && (entry = entry_for_position
+		(self, self->top_position + self->entries->len, reusable)))
 	{
-		ViewEntry *entry = view_entry_new (iterator);
 		remains -= entry->definitions->len;
 		g_ptr_array_add (self->entries, entry);
-		stardict_iterator_next (iterator);
 	}
-	g_object_unref (iterator);
+	g_hash_table_destroy (reusable);
 }
 
 /// Load configuration for a color using a subset of git config colors.
@@ -422,6 +668,19 @@ app_load_bool (GKeyFile *kf, const gchar *name, gboolean def)
 	return value;
 }
 
+static gint
+app_load_int (GKeyFile *kf, const gchar *name, gint def)
+{
+	GError *e = NULL;
+	gint value = g_key_file_get_integer (kf, "Settings", name, &e);
+	if (e)
+	{
+		g_error_free (e);
+		return def;
+	}
+	return value;
+}
+
 static void
 app_load_config_values (Application *self, GKeyFile *kf)
 {
@@ -434,6 +693,11 @@ app_load_config_values (Application *self, GKeyFile *kf)
 	self->watch_x11_sel =
 		app_load_bool (kf, "watch-selection", self->watch_x11_sel);
 
+	// Configured in MiB, so as to keep the numbers readable
+	gint budget = app_load_int (kf, "memory-budget", self->memory_budget >> 20);
+	if (budget >= 0)
+		self->memory_budget = (gsize) budget << 20;
+
 #define XX(name, config, fg_, bg_, attrs_) \
 	app_load_color (self, kf, config, ATTRIBUTE_ ## name);
 	ATTRIBUTE_TABLE (XX)
@@ -504,7 +768,9 @@ app_utf8_width (Application *self, const char *utf8)
 static gboolean
 app_load_dictionaries (Application *self, GError **e)
 {
-	if (!load_dictionaries (self->dictionaries, e))
+	// Only the current dictionary is needed to start up, others are loaded
+	// as they're used, and their data get released once they're idle
+	if (!open_dictionaries (self->dictionaries, e))
 		return FALSE;
 
 	for (gsize i = 0; i < self->dictionaries->len; i++)
@@ -517,7 +783,36 @@ app_load_dictionaries (Application *self, GError **e)
 		dict->super.name = tmp;
 		dict->name_width = app_utf8_width (self, dict->super.name);
 	}
-	return TRUE;
+	if (!self->dictionaries->len)
+		return TRUE;
+
+	// Startup failures can be reported properly, unlike those that come later
+	AppDictionary *first = g_ptr_array_index (self->dictionaries, 0);
+	return stardict_dict_load (first->super.dict, e);
+}
+
+/// Label the search input according to the current search mode.
+static void
+app_update_search_label (Application *self)
+{
+	const gchar *label = _("Search");
+	if (self->fulltext)
+		label = _("Full-text");
+	else if (self->merge_all)
+		label = _("All");
+
+	g_free (self->search_label);
+	self->search_label = g_strdup_printf ("%s: ", label);
+	self->search_label_width = app_utf8_width (self, self->search_label);
+}
+
+/// Release data of dictionaries that haven't been used in a while.
+static gboolean
+app_on_evict_timer (gpointer data)
+{
+	Application *self = data;
+	evict_dictionaries (self->dictionaries, self->memory_budget);
+	return G_SOURCE_CONTINUE;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -551,19 +846,37 @@ app_init (Application *self, char **filenames)
 	self->selected = 0;
 	self->entries = g_ptr_array_new_with_free_func
 		((GDestroyNotify) view_entry_free);
+	self->last_serial = 0;
+	self->rows = g_array_new (FALSE, TRUE, sizeof (ViewRow));
 
-	self->search_label = g_strdup_printf ("%s: ", _("Search"));
-	self->search_label_width = app_utf8_width (self, self->search_label);
+	self->search_label = NULL;
+	self->fulltext = FALSE;
+	self->merge_all = FALSE;
+	app_update_search_label (self);
 
 	self->input = g_array_new (TRUE, FALSE, sizeof (gunichar));
 	self->input_pos = self->input_offset = 0;
 	self->input_confirmed = FALSE;
+	self->hint = NULL;
+	self->fuzzy_pending = NULL;
 
 	self->division = 0.5;
 
 	app_init_attrs (self);
 	self->dictionaries =
 		g_ptr_array_new_with_free_func ((GDestroyNotify) dictionary_destroy);
+	self->memory_budget = DICTIONARY_MEMORY_BUDGET;
+	self->evict_timer = 0;
+	self->search = NULL;
+	self->results = NULL;
+	self->merged = NULL;
+
+	// Threads of non-exclusive pools are shared, so there's no harm in this
+	self->loader = g_thread_pool_new (entry_job_run, NULL,
+		g_get_num_processors (), FALSE, NULL);
+	self->loaded = g_hash_table_new_full (entry_key_hash, entry_key_equal,
+		NULL, (GDestroyNotify) view_entry_free);
+	self->loading = g_hash_table_new (entry_key_hash, entry_key_equal);
 
 	GError *error = NULL;
 	app_load_config (self, &error);
@@ -601,6 +914,9 @@ app_init (Application *self, char **filenames)
 	self->dict = ((AppDictionary *)
 		g_ptr_array_index (self->dictionaries, 0))->super.dict;
 	app_reload_view (self);
+
+	self->evict_timer = g_timeout_add_seconds (DICTIONARY_IDLE_TIMEOUT / 4,
+		app_on_evict_timer, self);
 }
 
 static void
@@ -612,6 +928,9 @@ app_init_terminal (Application *self)
 	if (!initscr () || nonl () == ERR)
 		abort ();
 
+	// Let curses shift lines using the terminal when the view scrolls
+	idlok (stdscr, TRUE);
+
 	// By default we don't use any colors so they're not required...
 	if (start_color () == ERR
 	 || use_default_colors () == ERR
@@ -651,10 +970,34 @@ app_destroy (Application *self)
 		termo_destroy (self->tk);
 	if (self->tk_timer)
 		g_source_remove (self->tk_timer);
+	if (self->evict_timer)
+		g_source_remove (self->evict_timer);
+
+	// Finished jobs are still waiting for their idle sources to collect them,
+	// the rest has been dropped without ever running
+	g_thread_pool_free (self->loader, TRUE, TRUE);
+	GHashTableIter iter;
+	gpointer job;
+	g_hash_table_iter_init (&iter, self->loading);
+	while (g_hash_table_iter_next (&iter, &job, NULL))
+	{
+		(void) g_source_remove_by_user_data (job);
+		entry_job_free (job);
+	}
+	g_hash_table_destroy (self->loading);
+	g_hash_table_destroy (self->loaded);
 
 	g_ptr_array_free (self->entries, TRUE);
+	g_array_free (self->rows, TRUE);
 	g_free (self->search_label);
 	g_array_free (self->input, TRUE);
+	g_free (self->hint);
+	if (self->search)
+		stardict_search_free (self->search);
+	if (self->results)
+		g_array_free (self->results, TRUE);
+	if (self->merged)
+		merged_search_free (self->merged);
 	g_ptr_array_free (self->dictionaries, TRUE);
 
 	g_iconv_close (self->ucs4_to_locale);
@@ -999,6 +1342,18 @@ app_redraw_top (Application *self)
 	row_buffer_append (&buf, input_utf8, word_attrs);
 	g_free (input_utf8);
 
+	// Only show the hint when it fits in its entirety
+	if (self->hint)
+	{
+		chtype hint_attrs = APP_ATTR (SEARCH);
+		row_buffer_merge_attributes (&hint_attrs, APP_ATTR (HINT));
+
+		gchar *hint = g_strdup_printf ("  %s", self->hint);
+		if (buf.total_width + (gint) app_utf8_width (self, hint) <= COLS)
+			row_buffer_append (&buf, hint, hint_attrs);
+		g_free (hint);
+	}
+
 	gint overflow = buf.total_width - COLS;
 	if (overflow > 0)
 	{
@@ -1026,6 +1381,13 @@ app_get_left_column_width (Application *self)
 	return width;
 }
 
+/// Forget what the view looks like on the screen, so that it gets redrawn.
+static void
+app_invalidate_view (Application *self)
+{
+	g_array_set_size (self->rows, 0);
+}
+
 /// Display a message in the view area.
 static void
 app_show_message (Application *self, const gchar *lines[], gsize len)
@@ -1056,6 +1418,7 @@ app_show_message (Application *self, const gchar *lines[], gsize len)
 
 	clrtobot ();
 	refresh ();
+	app_invalidate_view (self);
 }
 
 /// Show some information about the program.
@@ -1074,6 +1437,15 @@ app_show_help (Application *self)
 	app_show_message (self, lines, G_N_ELEMENTS (lines));
 }
 
+/// Show lookup and I/O statistics of the current dictionary.
+static void
+app_show_stats (Application *self)
+{
+	gchar **lines = format_dictionary_stats (self->dict);
+	app_show_message (self, (const gchar **) lines, g_strv_length (lines));
+	g_strfreev (lines);
+}
+
 static void
 app_draw_word (Application *self,
 	ViewEntry *ve, size_t common_prefix, int width, chtype attrs)
@@ -1096,73 +1468,201 @@ app_draw_definition (Application *self,
 	row_buffer_finish (&buf, width, attrs);
 }
 
-/// Redraw the dictionary view.
+/// Start decoding entries surrounding the view, a screenful in each direction.
 static void
-app_redraw_view (Application *self)
+app_prefetch (Application *self)
 {
-	if (self->show_help)
+	guint screenful = MAX (LINES - TOP_BAR_CUTOFF, 1);
+	guint32 begin = self->top_position > screenful
+		? self->top_position - screenful : 0;
+	guint32 end = self->top_position + self->entries->len + screenful;
+	for (guint32 i = begin; i < end; i++)
 	{
-		app_show_help (self);
-		return;
+		StardictIterator *iterator = app_resolve_position (self, i, NULL);
+		if (!iterator)
+			break;
+
+		EntryKey key =
+			{ iterator->owner, stardict_iterator_get_offset (iterator) };
+		app_load_entry (self, &key);
+		g_object_unref (iterator);
 	}
+}
 
-	move (TOP_BAR_CUTOFF, 0);
-	clrtobot ();
+static gboolean
+view_row_shows_same (const ViewRow *a, const ViewRow *b)
+{
+	return a->serial && a->serial == b->serial
+		&& a->definition == b->definition;
+}
+
+static gboolean
+view_row_equal (const ViewRow *a, const ViewRow *b)
+{
+	if (a->serial == VIEW_ROW_UNKNOWN || a->serial != b->serial)
+		return FALSE;
+	if (!a->serial)
+		return TRUE;
+
+	return a->definition == b->definition
+		&& a->attrs == b->attrs
+		&& a->common_prefix == b->common_prefix
+		&& a->left_width == b->left_width;
+}
+
+/// Find out by how many rows the view's contents have moved up.
+static gint
+app_find_view_shift (Application *self, const ViewRow *wanted)
+{
+	const ViewRow *shown = (const ViewRow *) self->rows->data;
+	for (gint k = 1; k < (gint) self->rows->len; k++)
+	{
+		if (view_row_shows_same (&shown[k], &wanted[0]))
+			return k;
+		if (view_row_shows_same (&shown[0], &wanted[k]))
+			return -k;
+	}
+	return 0;
+}
+
+/// Shift the contents of the view on the screen, which the terminal
+/// can usually do all by itself, freeing us from redrawing those rows.
+static void
+app_shift_view (Application *self, gint shift)
+{
+	gint height = self->rows->len;
+	scrollok (stdscr, TRUE);
+	setscrreg (TOP_BAR_CUTOFF, TOP_BAR_CUTOFF + height - 1);
+	scrl (shift);
+	setscrreg (0, LINES - 1);
+	scrollok (stdscr, FALSE);
+
+	// Rows that have been scrolled in are blank
+	ViewRow *rows = (ViewRow *) self->rows->data;
+	gint moved = height - ABS (shift);
+	if (shift > 0)
+		memmove (rows, rows + shift, moved * sizeof *rows);
+	else
+		memmove (rows - shift, rows, moved * sizeof *rows);
+	memset (shift > 0 ? rows + moved : rows, 0, ABS (shift) * sizeof *rows);
+}
 
+/// Describe what each row of the view should look like,
+/// and which entries they are drawn from.
+static void
+app_layout_view (Application *self,
+	ViewRow *rows, ViewEntry **row_entries, gint height)
+{
 	gint left_width = app_get_left_column_width (self);
 	gchar *input_utf8 = g_ucs4_to_utf8 ((gunichar *) self->input->data, -1,
 		NULL, NULL, NULL);
 
-	guint i, offset = self->top_offset, shown = 0;
-	for (i = 0; i < self->entries->len; i++)
+	gint shown = 0;
+	guint offset = self->top_offset;
+	for (guint i = 0; i < self->entries->len && shown < height; i++)
 	{
 		ViewEntry *ve = g_ptr_array_index (self->entries, i);
 		size_t common_prefix = 0;
-		if (self->hl_prefix)
+
+		// Full-text search results needn't have anything in common with it
+		if (self->hl_prefix && !self->results)
 		{
+			// Merged results are compared by rules of their own dictionaries,
+			// without the name of the source that follows the word
+			gchar *word = ve->source ? g_strndup (ve->word,
+				strlen (ve->word) - strlen (ve->source) - 3) : NULL;
 			common_prefix = stardict_longest_common_collation_prefix
-				(self->dict, ve->word, input_utf8);
+				(ve->key.dict, word ? word : ve->word, input_utf8);
+			g_free (word);
 		}
 		chtype ve_attrs = APP_ATTR_IF ((self->top_position + i) & 1, ODD, EVEN);
-		for (; offset < ve->definitions->len; offset++)
+		for (; offset < ve->definitions->len && shown < height; offset++)
 		{
 			chtype attrs = ve_attrs;
 			if ((offset + 1 == ve->definitions->len) && self->underline_last)
 				attrs |= A_UNDERLINE;
-			if (shown == self->selected)
+			if (shown == (gint) self->selected)
 				row_buffer_merge_attributes (&attrs,
 					APP_ATTR_IF (self->focused, SELECTION, DEFOCUSED));
 
-			app_draw_word (self, ve, common_prefix, left_width, attrs);
-			app_draw_definition (self, ve, offset, COLS - left_width, attrs);
-			if ((gint) ++shown == LINES - TOP_BAR_CUTOFF)
-				goto done;
+			row_entries[shown] = ve;
+			rows[shown++] = (ViewRow)
+			{
+				.serial = ve->serial,
+				.definition = offset,
+				.attrs = attrs,
+				.common_prefix = common_prefix,
+				.left_width = left_width,
+			};
 		}
 
 		offset = 0;
 	}
-
-done:
 	free (input_utf8);
-	refresh ();
 }
 
-static ViewEntry *
-entry_for_position (Application *self, guint32 position)
+/// Redraw the dictionary view.  Only rows that have changed since the last
+/// time are drawn, after shifting the rest into their new place.
+static void
+app_redraw_view (Application *self)
 {
-	StardictIterator *iterator = stardict_iterator_new (self->dict, position);
-	ViewEntry *ve = NULL;
-	if (stardict_iterator_is_valid (iterator))
-		ve = view_entry_new (iterator);
-	g_object_unref (iterator);
-	return ve;
+	if (self->show_help)
+	{
+		app_show_help (self);
+		return;
+	}
+	if (self->show_stats)
+	{
+		app_show_stats (self);
+		return;
+	}
+
+	gint height = MAX (LINES - TOP_BAR_CUTOFF, 0);
+	if (self->rows->len != (guint) height)
+	{
+		g_array_set_size (self->rows, height);
+		for (gint i = 0; i < height; i++)
+			g_array_index (self->rows, ViewRow, i).serial = VIEW_ROW_UNKNOWN;
+	}
+
+	ViewRow wanted[height + 1];
+	ViewEntry *row_entries[height + 1];
+	memset (wanted, 0, sizeof wanted);
+	app_layout_view (self, wanted, row_entries, height);
+
+	gint shift = app_find_view_shift (self, wanted);
+	if (shift)
+		app_shift_view (self, shift);
+
+	ViewRow *shown = (ViewRow *) self->rows->data;
+	for (gint i = 0; i < height; i++)
+	{
+		ViewRow *row = &wanted[i];
+		if (view_row_equal (&shown[i], row))
+			continue;
+
+		move (TOP_BAR_CUTOFF + i, 0);
+		if (!row->serial)
+			clrtoeol ();
+		else
+		{
+			app_draw_word (self, row_entries[i],
+				row->common_prefix, row->left_width, row->attrs);
+			app_draw_definition (self, row_entries[i],
+				row->definition, COLS - row->left_width, row->attrs);
+		}
+		shown[i] = *row;
+	}
+
+	refresh ();
+	app_prefetch (self);
 }
 
 /// Just prepends a new view entry into the entries array.
 static ViewEntry *
 prepend_entry (Application *self, guint32 position)
 {
-	ViewEntry *ve = entry_for_position (self, position);
+	ViewEntry *ve = entry_for_position (self, position, NULL);
 	g_ptr_array_add (self->entries, NULL);
 	memmove (self->entries->pdata + 1, self->entries->pdata,
 		sizeof ve * (self->entries->len - 1));
@@ -1242,7 +1742,7 @@ app_scroll_down (Application *self, guint n)
 		if ((gint) (to_be_definitions - to_be_offset) < LINES - TOP_BAR_CUTOFF)
 		{
 			ViewEntry *new_entry = entry_for_position
-				(self, self->top_position + self->entries->len);
+				(self, self->top_position + self->entries->len, NULL);
 			if (!new_entry)
 				break;
 
@@ -1341,23 +1841,256 @@ app_fill_view (Application *self)
 		self->selected += app_scroll_up (self, missing);
 }
 
-/// Search for the current entry.
+/// Replace placeholders of an entry that has just been decoded.
+/// The selection stays on the same entry, even as those above it grow.
+static gboolean
+app_on_entry_loaded (gpointer data)
+{
+	EntryJob *job = data;
+	Application *self = job->app;
+	g_hash_table_remove (self->loading, &job->key);
+	if (!job->result)
+	{
+		entry_job_free (job);
+		return G_SOURCE_REMOVE;
+	}
+
+	// The view holds copies, so this can be fairly indiscriminate
+	if (g_hash_table_size (self->loaded) >= APP_LOADED_LIMIT)
+		g_hash_table_remove_all (self->loaded);
+	g_hash_table_add (self->loaded, job->result);
+	job->result = NULL;
+
+	gboolean changed = FALSE;
+	gint first = -self->top_offset;
+	for (guint i = 0; i < self->entries->len; i++)
+	{
+		ViewEntry *ve = g_ptr_array_index (self->entries, i), *replacement;
+		gint len = ve->definitions->len;
+		if (!ve->placeholder || !entry_key_equal (&ve->key, &job->key)
+		 || !(replacement =
+				entry_for_position (self, self->top_position + i, NULL)))
+		{
+			first += len;
+			continue;
+		}
+
+		view_entry_free (ve);
+		g_ptr_array_index (self->entries, i) = replacement;
+		changed = TRUE;
+
+		gint growth = (gint) replacement->definitions->len - len;
+		if (first < (gint) self->selected)
+			self->selected += growth;
+		first += len + growth;
+	}
+	entry_job_free (job);
+	if (!changed)
+		return G_SOURCE_REMOVE;
+
+	gint overflow = (gint) self->selected - (LINES - TOP_BAR_CUTOFF - 1);
+	if (overflow > 0)
+		self->selected -= app_scroll_down (self, overflow);
+	app_fill_view (self);
+	app_redraw_view (self);
+	return G_SOURCE_REMOVE;
+}
+
+static void app_update_hint (Application *self, const gchar *input,
+	StardictIterator *iterator, gboolean success, gboolean may_wait);
+
 static void
-app_search_for_entry (Application *self)
+app_fuzzy_index_thread (GTask *task, G_GNUC_UNUSED gpointer source_object,
+	gpointer task_data, G_GNUC_UNUSED GCancellable *cancellable)
 {
+	stardict_dict_build_fuzzy_index (task_data, TRUE);
+	g_task_return_boolean (task, TRUE);
+}
+
+/// Show suggestions for the current input, now that they can be made.
+static void
+app_on_fuzzy_index_ready (G_GNUC_UNUSED GObject *source_object,
+	GAsyncResult *res, gpointer user_data)
+{
+	Application *self = user_data;
+	StardictDict *dict = g_task_get_task_data (G_TASK (res));
+	if (self->fuzzy_pending == dict)
+		self->fuzzy_pending = NULL;
+	if (dict != self->dict || self->results || self->merged)
+		return;
+
 	gchar *input_utf8 = g_ucs4_to_utf8
 		((gunichar *) self->input->data, -1, NULL, NULL, NULL);
 	g_return_if_fail (input_utf8 != NULL);
 
+	gboolean success = FALSE;
 	StardictIterator *iterator =
-		stardict_dict_search (self->dict, input_utf8, NULL);
+		stardict_dict_search (self->dict, input_utf8, &success);
+	app_update_hint (self, input_utf8, iterator, success, FALSE);
+	g_object_unref (iterator);
 	g_free (input_utf8);
 
+	app_redraw_top (self);
+}
+
+/// Have the hint updated once the fuzzy index for the current dictionary
+/// has been prepared in the background.
+static void
+app_wait_for_fuzzy_index (Application *self)
+{
+	if (self->fuzzy_pending == self->dict)
+		return;
+
+	GTask *task = g_task_new (NULL, NULL, app_on_fuzzy_index_ready, self);
+	g_task_set_task_data (task, g_object_ref (self->dict), g_object_unref);
+	g_task_run_in_thread (task, app_fuzzy_index_thread);
+	g_object_unref (task);
+	self->fuzzy_pending = self->dict;
+}
+
+/// Suggest similar words when there are no entries beginning with the input.
+/// Unless @a may_wait, suggestions are only made if they can be right away.
+static void
+app_update_hint (Application *self, const gchar *input,
+	StardictIterator *iterator, gboolean success, gboolean may_wait)
+{
+	g_free (self->hint);
+	self->hint = NULL;
+
+	gsize input_len = strlen (input);
+	if (success || !input_len || (stardict_iterator_is_valid (iterator)
+	 && stardict_longest_common_collation_prefix (self->dict, input,
+		stardict_iterator_get_word (iterator)) == input_len))
+		return;
+
+	// The first time around, this only starts preparing the fuzzy index
+	GArray *similar = stardict_dict_fuzzy_search (self->dict, input, 5);
+	if (!similar)
+	{
+		if (may_wait)
+			app_wait_for_fuzzy_index (self);
+		return;
+	}
+
+	GString *words = g_string_new (NULL);
+	const gchar *last = NULL;
+	for (guint i = 0; i < similar->len; i++)
+	{
+		StardictIterator *sdi = stardict_iterator_new
+			(self->dict, g_array_index (similar, guint32, i));
+		const gchar *word = stardict_iterator_get_word (sdi);
+		if (!last || strcmp (last, word))
+		{
+			if (words->len)
+				g_string_append (words, ", ");
+			g_string_append (words, word);
+		}
+		last = word;
+		g_object_unref (sdi);
+	}
+	if (words->len)
+		self->hint = g_strdup_printf (_("Did you mean: %s?"), words->str);
+	g_string_free (words, TRUE);
+	g_array_free (similar, TRUE);
+}
+
+/// Find the position of the input within the dictionary.
+static void
+app_search_index (Application *self, const gchar *input)
+{
+	// Successive searches in the same dictionary can narrow down the last one
+	if (self->search && stardict_search_get_dict (self->search) != self->dict)
+	{
+		stardict_search_free (self->search);
+		self->search = NULL;
+	}
+	if (!self->search)
+		self->search = stardict_search_new (self->dict);
+
+	gboolean success = FALSE;
+	StardictIterator *iterator =
+		stardict_search_update (self->search, input, &success);
+	app_update_hint (self, input, iterator, success, TRUE);
+
 	self->top_position = stardict_iterator_get_offset (iterator);
-	self->top_offset = 0;
-	self->selected = 0;
 	g_object_unref (iterator);
+}
+
+/// Only show entries that mention all words of the input in their definitions.
+static void
+app_search_fulltext (Application *self, const gchar *input)
+{
+	g_free (self->hint);
+	self->hint = NULL;
+
+	GError *error = NULL;
+	if (!(self->results =
+		stardict_dict_search_fulltext (self->dict, input, &error)))
+	{
+		self->results = g_array_new (FALSE, FALSE, sizeof (guint32));
+		self->hint = g_strdup (error->message);
+		g_error_free (error);
+	}
+	self->top_position = 0;
+}
+
+/// Show newly arrived results of a merged search without moving the view.
+static void
+app_on_merged_results (MergedSearch *search, gpointer user_data)
+{
+	Application *self = user_data;
+	gboolean dropped = FALSE;
+	if (self->entries->len && (self->top_position || self->top_offset))
+		self->top_position =
+			merged_search_remap (search, self->top_position, &dropped);
+	if (dropped)
+		self->top_offset = 0;
+
+	app_reload_view (self);
+	app_fill_view (self);
+	app_redraw_view (self);
+}
+
+/// Search for the input in all dictionaries, results are streamed in.
+static void
+app_search_merged (Application *self, const gchar *input)
+{
+	g_free (self->hint);
+	self->hint = NULL;
 
+	self->merged = merged_search_new (self->dictionaries, input,
+		APP_MERGED_LIMIT, app_on_merged_results, self);
+	self->top_position = 0;
+}
+
+/// Search for the current entry.
+static void
+app_search_for_entry (Application *self)
+{
+	gchar *input_utf8 = g_ucs4_to_utf8
+		((gunichar *) self->input->data, -1, NULL, NULL, NULL);
+	g_return_if_fail (input_utf8 != NULL);
+
+	if (self->results)
+	{
+		g_array_free (self->results, TRUE);
+		self->results = NULL;
+	}
+	if (self->merged)
+	{
+		merged_search_free (self->merged);
+		self->merged = NULL;
+	}
+	if (self->fulltext)
+		app_search_fulltext (self, input_utf8);
+	else if (self->merge_all)
+		app_search_merged (self, input_utf8);
+	else
+		app_search_index (self, input_utf8);
+	g_free (input_utf8);
+
+	self->top_offset = 0;
+	self->selected = 0;
 	self->show_help = FALSE;
 	app_reload_view (self);
 
@@ -1378,6 +2111,28 @@ app_search_for_entry (Application *self)
 	app_redraw_view (self);
 }
 
+/// Switch between searching the index and searching within definitions.
+static void
+app_toggle_fulltext (Application *self)
+{
+	self->fulltext = !self->fulltext;
+	self->merge_all = FALSE;
+	app_update_search_label (self);
+	app_search_for_entry (self);
+	app_redraw_top (self);
+}
+
+/// Switch between searching the current dictionary and all of them.
+static void
+app_toggle_merged (Application *self)
+{
+	self->merge_all = !self->merge_all;
+	self->fulltext = FALSE;
+	app_update_search_label (self);
+	app_search_for_entry (self);
+	app_redraw_top (self);
+}
+
 static void
 app_set_input (Application *self, const gchar *text, gsize text_len)
 {
@@ -1455,10 +2210,23 @@ app_goto_dictionary_directly (Application *self, StardictDict *dict)
 	if (dict == self->dict)
 		return;
 
+	// Only the first dictionary is loaded in advance, and this is where
+	// the others would otherwise fail quietly, looking empty
+	GError *error = NULL;
+	gboolean loaded = stardict_dict_load (dict, &error);
+
 	self->last = self->dict;
 	self->dict = dict;
 	app_search_for_entry (self);
 	app_redraw_top (self);
+
+	if (!loaded)
+	{
+		const gchar *lines[] =
+			{ _("Error loading dictionary"), error->message };
+		app_show_message (self, lines, G_N_ELEMENTS (lines));
+		g_error_free (error);
+	}
 }
 
 /// Switch to a different dictionary by number.
@@ -1493,6 +2261,7 @@ app_goto_dictionary_delta (Application *self, gint n)
 static gboolean
 app_process_resize (Application *self)
 {
+	app_invalidate_view (self);
 	app_reload_view (self);
 	app_fill_view (self);
 
@@ -1571,6 +2340,7 @@ app_process_user_action (Application *self, UserAction action)
 		return FALSE;
 	case USER_ACTION_REDRAW:
 		clear ();
+		app_invalidate_view (self);
 		app_redraw (self);
 		return TRUE;
 
@@ -1870,6 +2640,15 @@ app_process_alt_key (Application *self, termo_key_t *event)
 {
 	if (event->code.codepoint == 'c')
 		self->center_search = !self->center_search;
+	if (event->code.codepoint == 'f')
+		app_toggle_fulltext (self);
+	if (event->code.codepoint == 'a')
+		app_toggle_merged (self);
+	if (event->code.codepoint == 's')
+	{
+		self->show_stats = !self->show_stats;
+		app_redraw_view (self);
+	}
 
 	if (event->code.codepoint >= '0'
 	 && event->code.codepoint <= '9')
@@ -26,6 +26,7 @@
 #include "stardict.h"
 #include "stardict-private.h"
 #include "generator.h"
+#include "dictzip-input-stream.h"
 
 
 // --- Utilities ---------------------------------------------------------------
@@ -146,7 +147,7 @@ test_entry_word_compare (gconstpointer a, gconstpointer b)
 }
 
 static GArray *
-generate_dictionary_data (gsize length)
+generate_dictionary_data (gsize length, gsize max_data_size)
 {
 	GRand *rand = g_rand_new_with_seed (0);
 
@@ -162,7 +163,7 @@ generate_dictionary_data (gsize length)
 		te.meaning = generate_random_string
 			(g_rand_int_range (rand, 1, 1024), rand);
 
-		te.data_size = g_rand_int_range (rand, 0, 1048576);
+		te.data_size = g_rand_int_range (rand, 0, max_data_size);
 		te.data = generate_random_data (te.data_size, rand);
 
 		g_array_append_val (a, te);
@@ -174,7 +175,8 @@ generate_dictionary_data (gsize length)
 }
 
 static Dictionary *
-dictionary_create (void)
+dictionary_create (const gchar *collation, gboolean dictzip,
+	guint dictionary_size, gsize max_data_size)
 {
 	GError *error = NULL;
 	gchar *tmp_dir_path = g_dir_make_tmp ("stardict-test-XXXXXX", &error);
@@ -187,14 +189,13 @@ dictionary_create (void)
 	dict->ifo_file = g_file_get_child (dict->tmp_dir, "test.ifo");
 
 	gchar *base = g_build_filename (tmp_dir_path, "test", NULL);
-	Generator *generator = generator_new (base, &error);
+	Generator *generator = generator_new (base, dictzip, &error);
 	g_free (base);
 
 	if (!generator)
 		g_error ("Failed to create a dictionary: %s", error->message);
 
-	static const guint dictionary_size = 8;
-	dict->data = generate_dictionary_data (dictionary_size);
+	dict->data = generate_dictionary_data (dictionary_size, max_data_size);
 
 	generator->info->version             = SD_VERSION_3_0_0;
 	generator->info->book_name           = g_strdup ("Test Book");
@@ -203,6 +204,7 @@ dictionary_create (void)
 	generator->info->description         = g_strdup ("Test dictionary");
 	generator->info->date                = g_strdup ("21.12.2012");
 	generator->info->same_type_sequence  = g_strdup ("mX");
+	generator->info->collation           = g_strdup (collation);
 
 	guint i;
 	for (i = 0; i < dictionary_size; i++)
@@ -360,6 +362,537 @@ dict_test_data (DictFixture *fixture, gconstpointer user_data)
 	}
 }
 
+static void
+dict_test_dictzip (DictFixture *fixture, gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	GFile *plain = g_file_get_child (dict->tmp_dir, "test.dict");
+	g_assert (!g_file_query_exists (plain, NULL));
+	g_object_unref (plain);
+
+	// Make sure we don't rely on the fallback that inflates everything
+	GError *error = NULL;
+	gchar *tmp_path = g_file_get_path (dict->tmp_dir);
+	gchar *path = g_build_filename (tmp_path, "test.dict.dz", NULL);
+	DictzipInputStream *dzis = dictzip_input_stream_new_for_path (path, &error);
+	g_assert_no_error (error);
+	g_free (path);
+	g_free (tmp_path);
+
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		TestEntry *entry = &g_array_index (dict->data, TestEntry, i);
+		gsize meaning_size = strlen (entry->meaning) + 1;
+		gsize size = meaning_size + entry->data_size, read = 0;
+		gchar *buffer = g_malloc (size);
+		g_input_stream_read_all (G_INPUT_STREAM (dzis),
+			buffer, size, &read, NULL, &error);
+		g_assert_no_error (error);
+		g_assert_cmpuint (read, ==, size);
+		g_assert_cmpstr (buffer, ==, entry->meaning);
+		g_assert (!memcmp (buffer + meaning_size,
+			entry->data, entry->data_size));
+		g_free (buffer);
+	}
+	g_object_unref (dzis);
+
+	dict_test_data (fixture, user_data);
+}
+
+static void
+dict_test_common_prefix (DictFixture *fixture,
+	G_GNUC_UNUSED gconstpointer user_data)
+{
+	StardictDict *sd = fixture->dict;
+
+	// The first argument is cached, so alternate it as well
+	g_assert_cmpuint (stardict_longest_common_collation_prefix
+		(sd, "abcd", "abce"), ==, 3);
+	g_assert_cmpuint (stardict_longest_common_collation_prefix
+		(sd, "abcd", "xyz"), ==, 0);
+	g_assert_cmpuint (stardict_longest_common_collation_prefix
+		(sd, "\xc3\xa1bc", "\xc3\xa1bd"), ==, 3);
+	g_assert_cmpuint (stardict_longest_common_collation_prefix
+		(sd, "abcd", "ABCD"), ==, 4);
+	g_assert_cmpuint (stardict_longest_common_collation_prefix
+		(sd, "\xff", "abc"), ==, 0);
+
+	if (!g_test_perf ())
+		return;
+
+	// Emulate what happens on unsuccessful searches
+	const guint iterations = 100000;
+	g_test_timer_start ();
+	for (guint i = 0; i < iterations; i++)
+		(void) stardict_longest_common_collation_prefix
+			(sd, "prefixed", i & 1 ? "prefix" : "prefab");
+	gdouble ns = g_test_timer_elapsed () / iterations * 1e9;
+	g_test_minimized_result (ns, "a common prefix took %g ns", ns);
+}
+
+static void
+dict_test_search (DictFixture *fixture, gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	StardictDict *sd = fixture->dict;
+
+	// Every word must be found at its first case-insensitive occurrence,
+	// and words that only share a prefix with it mustn't be found at all
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		const gchar *word = g_array_index (dict->data, TestEntry, i).word;
+		guint first = 0;
+		while (g_ascii_strcasecmp (word,
+			g_array_index (dict->data, TestEntry, first).word))
+			first++;
+
+		gchar *upper = g_ascii_strup (word, -1);
+		gchar *longer = g_strconcat (word, "~", NULL);
+		const gchar *queries[] = { word, upper };
+		for (gsize k = 0; k < G_N_ELEMENTS (queries); k++)
+		{
+			gboolean success = FALSE;
+			StardictIterator *iterator =
+				stardict_dict_search (sd, queries[k], &success);
+			g_assert (success);
+			g_assert_cmpint (stardict_iterator_get_offset (iterator), ==,
+				first);
+			g_object_unref (iterator);
+		}
+
+		gboolean success = TRUE;
+		g_object_unref (stardict_dict_search (sd, longer, &success));
+		g_assert (!success);
+		g_free (upper);
+		g_free (longer);
+	}
+}
+
+static void
+dict_test_compare_words (DictFixture *fixture,
+	G_GNUC_UNUSED gconstpointer user_data)
+{
+	StardictDict *sd = fixture->dict;
+
+	// The index must be sorted in the order that the function defines
+	StardictIterator *iterator = stardict_iterator_new (sd, 0);
+	gchar *last = NULL;
+	for (; stardict_iterator_is_valid (iterator);
+		stardict_iterator_next (iterator))
+	{
+		const gchar *word = stardict_iterator_get_word (iterator);
+		if (last)
+			g_assert_cmpint
+				(stardict_dict_compare_words (sd, last, word), <=, 0);
+		g_free (last);
+		last = g_strdup (word);
+	}
+	g_free (last);
+	g_object_unref (iterator);
+}
+
+/// Type in @a text byte by byte, which mustn't make a difference
+/// to where each of the queries ends up, compared to a full search.
+static void
+search_session_type (StardictDict *sd, StardictSearch *search,
+	const gchar *text)
+{
+	for (gsize len = 0; len <= strlen (text); len++)
+	{
+		gchar *prefix = g_strndup (text, len);
+		gboolean full_success, session_success;
+		StardictIterator *full =
+			stardict_dict_search (sd, prefix, &full_success);
+		StardictIterator *session =
+			stardict_search_update (search, prefix, &session_success);
+		g_assert (full_success == session_success);
+		g_assert_cmpint (stardict_iterator_get_offset (full), ==,
+			stardict_iterator_get_offset (session));
+		g_object_unref (full);
+		g_object_unref (session);
+		g_free (prefix);
+	}
+}
+
+static void
+dict_test_search_session (DictFixture *fixture, gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	StardictDict *sd = fixture->dict;
+
+	// Also keep typing after the query has stopped matching anything,
+	// both past the end of a word, and from within it
+	StardictSearch *search = stardict_search_new (sd);
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		const gchar *word = g_array_index (dict->data, TestEntry, i).word;
+		const gchar *other = g_array_index (dict->data, TestEntry,
+			(i + 1) % dict->data->len).word;
+		gchar *past = g_strconcat (word, "~", other, NULL);
+		gchar *within =
+			g_strdup_printf ("%.*s%s", (int) strlen (word) / 2, word, other);
+
+		search_session_type (sd, search, word);
+		search_session_type (sd, search, past);
+		search_session_type (sd, search, within);
+		g_free (past);
+		g_free (within);
+	}
+	stardict_search_free (search);
+}
+
+static void
+dict_test_entry_view (DictFixture *fixture, gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	StardictDict *sd = fixture->dict;
+
+	StardictEntryView view;
+	stardict_entry_view_init (&view);
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		TestEntry *entry = &g_array_index (dict->data, TestEntry, i);
+		StardictIterator *sdi = stardict_dict_search (sd, entry->word, NULL);
+		g_assert (stardict_iterator_get_entry_view (sdi, &view));
+		g_assert_cmpuint (view.fields->len, ==, 2);
+
+		StardictEntryField *sdef =
+			&g_array_index (view.fields, StardictEntryField, 0);
+		g_assert (sdef->type == 'm');
+		g_assert_cmpuint (sdef->data_size, ==, strlen (entry->meaning));
+		g_assert (!memcmp (sdef->data, entry->meaning, sdef->data_size));
+
+		sdef = &g_array_index (view.fields, StardictEntryField, 1);
+		g_assert (sdef->type == 'X');
+		g_assert_cmpuint (sdef->data_size, ==, entry->data_size);
+		g_assert (!memcmp (sdef->data, entry->data, entry->data_size));
+		g_object_unref (sdi);
+	}
+	stardict_entry_view_clear (&view);
+}
+
+static void
+dict_test_entry_cache (DictFixture *fixture, G_GNUC_UNUSED gconstpointer data)
+{
+	StardictDict *sd = fixture->dict;
+	StardictEntryCacheStats stats;
+
+	StardictIterator *sdi = stardict_iterator_new (sd, 0);
+	StardictEntry *first = stardict_iterator_get_entry (sdi);
+	StardictEntry *second = stardict_iterator_get_entry (sdi);
+	g_assert (first != NULL);
+	g_assert (first == second);
+	g_object_unref (first);
+	g_object_unref (second);
+
+	stardict_dict_get_entry_cache_stats (sd, &stats);
+	g_assert_cmpuint (stats.hits, ==, 1);
+	g_assert_cmpuint (stats.misses, ==, 1);
+	g_assert_cmpuint (stats.n_entries, ==, 1);
+	g_assert_cmpuint (stats.size, <=, stats.limit);
+
+	stardict_dict_set_entry_cache_limit (sd, 0);
+	stardict_dict_get_entry_cache_stats (sd, &stats);
+	g_assert_cmpuint (stats.n_entries, ==, 0);
+	g_assert_cmpuint (stats.evictions, ==, 1);
+
+	first = stardict_iterator_get_entry (sdi);
+	second = stardict_iterator_get_entry (sdi);
+	g_assert (first != second);
+	g_object_unref (first);
+	g_object_unref (second);
+	g_object_unref (sdi);
+}
+
+static void
+dict_test_stats (DictFixture *fixture, G_GNUC_UNUSED gconstpointer data)
+{
+	StardictDict *sd = fixture->dict;
+	StardictDictStats stats;
+
+	stardict_dict_get_stats (sd, &stats);
+	g_assert_cmpuint (stats.searches, ==, 0);
+	g_assert_cmpuint (stats.entries_read, ==, 0);
+
+	StardictIterator *sdi = stardict_iterator_new (sd, 0);
+	gchar *word = g_strdup (stardict_iterator_get_word (sdi));
+	g_object_unref (sdi);
+
+	gboolean found = FALSE;
+	sdi = stardict_dict_search (sd, word, &found);
+	g_assert (found);
+	g_free (word);
+
+	StardictEntry *entry = stardict_iterator_get_entry (sdi);
+	g_assert (entry != NULL);
+	g_object_unref (entry);
+	g_object_unref (sdi);
+
+	stardict_dict_get_stats (sd, &stats);
+	g_assert_cmpuint (stats.searches, ==, 1);
+	g_assert_cmpuint (stats.search_comparisons, >, 0);
+	g_assert_cmpuint (stats.entries_read, ==, 1);
+	g_assert_cmpuint (stats.chunk_misses, >, 0);
+	g_assert_cmpuint (stats.chunk_inflated, >, 0);
+	g_assert_cmpuint (stats.entry_cache.misses, ==, 1);
+
+	guint64 histogram = 0;
+	for (guint i = 0; i < STARDICT_SEARCH_LATENCY_BUCKETS; i++)
+		histogram += stats.search_latency[i];
+	g_assert_cmpuint (histogram, ==, stats.searches);
+}
+
+/// Count entries in a scan from @a begin to @a end, checking their order.
+static guint32
+scan_count (StardictDict *sd, guint32 begin, guint32 end, gboolean data_order)
+{
+	StardictScan *scan = stardict_scan_new (sd, begin, end, data_order);
+	StardictIterator *iterator;
+	guint32 count = 0;
+	while ((iterator = stardict_scan_next (scan)))
+	{
+		gint64 offset = stardict_iterator_get_offset (iterator);
+		g_assert_cmpint (offset, >=, begin);
+		g_assert_cmpint (offset, <, end);
+		if (!data_order)
+			g_assert_cmpint (offset, ==, begin + count);
+		count++;
+	}
+	stardict_scan_free (scan);
+	return count;
+}
+
+static void
+dict_test_scan (DictFixture *fixture, gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	StardictDict *sd = fixture->dict;
+	guint32 n = dict->data->len;
+
+	for (gboolean data_order = FALSE; data_order <= TRUE; data_order++)
+	{
+		g_assert_cmpuint (scan_count (sd, 0, n, data_order), ==, n);
+		g_assert_cmpuint (scan_count (sd, 1, n + 10, data_order), ==, n - 1);
+		g_assert_cmpuint (scan_count (sd, n, n, data_order), ==, 0);
+
+		// Ranges past the end of the index are simply empty
+		g_assert_cmpuint (scan_count (sd, n + 1, n + 10, data_order), ==, 0);
+		g_assert_cmpuint
+			(scan_count (sd, G_MAXUINT32, G_MAXUINT32, data_order), ==, 0);
+	}
+}
+
+static void
+dict_test_deferred (gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+
+	gchar *ifo_filename = g_file_get_path (dict->ifo_file);
+	StardictInfo *sdi = stardict_info_new (ifo_filename, NULL);
+	g_free (ifo_filename);
+	g_assert (sdi != NULL);
+
+	StardictDict *sd = stardict_dict_new_deferred (sdi);
+	g_assert (!stardict_dict_is_loaded (sd));
+	g_assert_cmpuint (stardict_dict_get_memory_size (sd), ==, 0);
+
+	// Data get loaded on demand, and stay loaded while they're being used
+	StardictIterator *iterator = stardict_iterator_new (sd, 0);
+	g_assert (stardict_dict_is_loaded (sd));
+	g_assert (stardict_iterator_is_valid (iterator));
+	g_assert_cmpuint (stardict_dict_get_memory_size (sd), >, 0);
+	g_assert (!stardict_dict_unload (sd));
+	g_object_unref (iterator);
+
+	g_assert (stardict_dict_unload (sd));
+	g_assert (!stardict_dict_is_loaded (sd));
+	g_assert_cmpuint (stardict_dict_get_memory_size (sd), ==, 0);
+
+	TestEntry *entry = &g_array_index (dict->data, TestEntry, 0);
+	dict_test_data_entry (sd, entry);
+	g_assert (stardict_dict_is_loaded (sd));
+	g_object_unref (sd);
+}
+
+static void
+dict_test_collation_cache (gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	gchar *ifo_filename = g_file_get_path (dict->ifo_file);
+
+	// The first load sorts the index and stores the cache, the second one
+	// should end up with the very same order from the cache
+	StardictDict *sorted = stardict_dict_new (ifo_filename, NULL);
+	StardictDict *cached = stardict_dict_new (ifo_filename, NULL);
+	g_free (ifo_filename);
+	g_assert (sorted != NULL);
+	g_assert (cached != NULL);
+
+	GFile *cache_file = g_file_get_child (dict->tmp_dir, "test.idx.coll");
+	g_assert (g_file_query_exists (cache_file, NULL));
+	g_object_unref (cache_file);
+
+	StardictIterator *a = stardict_iterator_new (sorted, 0);
+	StardictIterator *b = stardict_iterator_new (cached, 0);
+	while (stardict_iterator_is_valid (a))
+	{
+		g_assert (stardict_iterator_is_valid (b));
+		g_assert_cmpstr (stardict_iterator_get_word (a), ==,
+			stardict_iterator_get_word (b));
+		stardict_iterator_next (a);
+		stardict_iterator_next (b);
+	}
+	g_assert (!stardict_iterator_is_valid (b));
+	g_object_unref (a);
+	g_object_unref (b);
+
+	for (guint i = 0; i < dict->data->len; i++)
+		dict_test_data_entry (cached, &g_array_index (dict->data, TestEntry, i));
+
+	g_object_unref (sorted);
+	g_object_unref (cached);
+}
+
+static void
+dict_test_parallel_sort (gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	gchar *ifo_filename = g_file_get_path (dict->ifo_file);
+	StardictDict *sd = stardict_dict_new (ifo_filename, NULL);
+	g_free (ifo_filename);
+	g_assert (sd != NULL);
+
+	// Searches would miss words if the index weren't properly ordered
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		gboolean success = FALSE;
+		const gchar *word = g_array_index (dict->data, TestEntry, i).word;
+		g_object_unref (stardict_dict_search (sd, word, &success));
+		g_assert (success);
+	}
+	g_object_unref (sd);
+}
+
+static void
+dict_test_index_cache (gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	gchar *ifo_filename = g_file_get_path (dict->ifo_file);
+
+	// Index tables are cached even for dictionaries that aren't collated
+	StardictDict *sd = stardict_dict_new (ifo_filename, NULL);
+	g_assert (sd != NULL);
+	g_object_unref (sd);
+
+	GFile *cache_file = g_file_get_child (dict->tmp_dir, "test.idx.coll");
+	gchar *cache_filename = g_file_get_path (cache_file);
+	g_object_unref (cache_file);
+
+	gchar *contents = NULL;
+	gsize length = 0;
+	g_assert (g_file_get_contents (cache_filename, &contents, &length, NULL));
+
+	// Point the last entry outside of the index, which has to be detected
+	g_assert_cmpuint (length, >=, sizeof (guint32));
+	memset (contents + length - sizeof (guint32), 0xff, sizeof (guint32));
+	g_assert (g_file_set_contents (cache_filename, contents, length, NULL));
+	g_free (contents);
+	g_free (cache_filename);
+
+	sd = stardict_dict_new (ifo_filename, NULL);
+	g_free (ifo_filename);
+	g_assert (sd != NULL);
+	for (guint i = 0; i < dict->data->len; i++)
+		dict_test_data_entry (sd, &g_array_index (dict->data, TestEntry, i));
+	g_object_unref (sd);
+}
+
+static void
+dict_test_fuzzy_search (gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	gchar *ifo_filename = g_file_get_path (dict->ifo_file);
+	StardictDict *sd = stardict_dict_new (ifo_filename, NULL);
+	g_free (ifo_filename);
+	g_assert (sd != NULL);
+
+	stardict_dict_build_fuzzy_index (sd, TRUE);
+	GFile *index_file = g_file_get_child (dict->tmp_dir, "test.idx.fuzzy");
+	g_assert (g_file_query_exists (index_file, NULL));
+	g_object_unref (index_file);
+
+	// Misspell each word by inserting a character, and change its case
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		const gchar *word = g_array_index (dict->data, TestEntry, i).word;
+		gchar *upper = g_ascii_strup (word, -1);
+		gchar *misspelled = g_strdup_printf ("%sq", upper);
+		GArray *found = stardict_dict_fuzzy_search (sd, misspelled, 10);
+		g_assert (found != NULL);
+
+		gboolean contained = FALSE;
+		for (guint k = 0; k < found->len; k++)
+		{
+			StardictIterator *sdi = stardict_iterator_new
+				(sd, g_array_index (found, guint32, k));
+			if (!strcmp (stardict_iterator_get_word (sdi), word))
+				contained = TRUE;
+			g_object_unref (sdi);
+		}
+		g_assert (contained);
+
+		g_array_free (found, TRUE);
+		g_free (misspelled);
+		g_free (upper);
+	}
+	g_object_unref (sd);
+}
+
+static void
+dict_test_fulltext (gconstpointer user_data)
+{
+	Dictionary *dict = (Dictionary *) user_data;
+	gchar *ifo_filename = g_file_get_path (dict->ifo_file);
+	StardictDict *sd = stardict_dict_new (ifo_filename, NULL);
+	g_free (ifo_filename);
+	g_assert (sd != NULL);
+
+	GError *error = NULL;
+	g_assert (!stardict_dict_search_fulltext (sd, "a", &error));
+	g_assert_error (error, STARDICT_ERROR, STARDICT_ERROR_FILE_NOT_FOUND);
+	g_clear_error (&error);
+
+	g_assert (stardict_dict_build_fulltext_index (sd, &error));
+	g_assert_no_error (error);
+	GFile *index_file = g_file_get_child (dict->tmp_dir, "test.idx.fts");
+	g_assert (g_file_query_exists (index_file, NULL));
+	g_object_unref (index_file);
+
+	// Each meaning is a single word, unless it is too long to be indexed
+	for (guint i = 0; i < dict->data->len; i++)
+	{
+		TestEntry *entry = &g_array_index (dict->data, TestEntry, i);
+		StardictIterator *sdi = stardict_dict_search (sd, entry->word, NULL);
+		guint32 position = stardict_iterator_get_offset (sdi);
+		g_object_unref (sdi);
+
+		gchar *upper = g_ascii_strup (entry->meaning, -1);
+		GArray *found = stardict_dict_search_fulltext (sd, upper, &error);
+		g_assert_no_error (error);
+		g_assert (found != NULL);
+
+		gboolean contained = FALSE;
+		for (guint k = 0; k < found->len; k++)
+			if (g_array_index (found, guint32, k) == position)
+				contained = TRUE;
+		g_assert (contained == (strlen (entry->meaning) <= 64));
+
+		g_array_free (found, TRUE);
+		g_free (upper);
+	}
+	g_object_unref (sd);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -370,15 +903,60 @@ G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 		g_type_init ();
 G_GNUC_END_IGNORE_DEPRECATIONS
 
-	Dictionary *dict = dictionary_create ();
+	Dictionary *dict = dictionary_create (NULL, FALSE, 8, 1048576);
+	Dictionary *collated = dictionary_create ("en", FALSE, 8, 1048576);
+	Dictionary *dictzipped = dictionary_create (NULL, TRUE, 8, 1048576);
+
+	// Large enough for the index to be sorted by multiple threads
+	Dictionary *large = dictionary_create ("en", FALSE, 20000, 16);
 
 	g_test_add_data_func ("/dict/list", dict, dict_test_list);
 	g_test_add_data_func ("/dict/new", dict, dict_test_new);
 
 	g_test_add ("/dict/data", DictFixture, dict,
 		dict_setup, dict_test_data, dict_teardown);
+	g_test_add ("/dict/dictzip", DictFixture, dictzipped,
+		dict_setup, dict_test_dictzip, dict_teardown);
+	g_test_add ("/dict/common-prefix", DictFixture, dict,
+		dict_setup, dict_test_common_prefix, dict_teardown);
+	g_test_add ("/dict/search", DictFixture, dict,
+		dict_setup, dict_test_search, dict_teardown);
+	g_test_add ("/dict/compare-words", DictFixture, dict,
+		dict_setup, dict_test_compare_words, dict_teardown);
+	g_test_add ("/dict/compare-words-collated", DictFixture, large,
+		dict_setup, dict_test_compare_words, dict_teardown);
+	g_test_add ("/dict/search-session", DictFixture, dict,
+		dict_setup, dict_test_search_session, dict_teardown);
+	g_test_add ("/dict/search-session-collated", DictFixture, collated,
+		dict_setup, dict_test_search_session, dict_teardown);
+	g_test_add ("/dict/search-session-large", DictFixture, large,
+		dict_setup, dict_test_search_session, dict_teardown);
+	g_test_add ("/dict/entry-view", DictFixture, dict,
+		dict_setup, dict_test_entry_view, dict_teardown);
+	g_test_add ("/dict/entry-cache", DictFixture, dict,
+		dict_setup, dict_test_entry_cache, dict_teardown);
+	g_test_add ("/dict/stats", DictFixture, dictzipped,
+		dict_setup, dict_test_stats, dict_teardown);
+	g_test_add ("/dict/scan", DictFixture, dictzipped,
+		dict_setup, dict_test_scan, dict_teardown);
+
+	g_test_add_data_func ("/dict/index-cache", dict,
+		dict_test_index_cache);
+	g_test_add_data_func ("/dict/deferred", collated,
+		dict_test_deferred);
+	g_test_add_data_func ("/dict/collation-cache", collated,
+		dict_test_collation_cache);
+	g_test_add_data_func ("/dict/parallel-sort", large,
+		dict_test_parallel_sort);
+	g_test_add_data_func ("/dict/fuzzy-search", collated,
+		dict_test_fuzzy_search);
+	g_test_add_data_func ("/dict/fulltext", collated,
+		dict_test_fulltext);
 
 	int result = g_test_run ();
 	dictionary_destroy (dict);
+	dictionary_destroy (collated);
+	dictionary_destroy (dictzipped);
+	dictionary_destroy (large);
 	return result;
 }
@@ -0,0 +1,17 @@
+#!/bin/sh -e
+# Check that tdv-transform gives the same results with several filters running
+# in parallel as with a single one, on input that spans multiple shards
+tabfile=${1:?} transform=${2:?}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+
+awk 'BEGIN {
+	for (i = 0; i < 100000; i++)
+		printf "word%05d\tdefinition number %d\\nsecond line\n", i, i
+}' | "$tabfile" --uncompressed input >/dev/null
+
+"$transform" --uncompressed input.ifo one -- tr a-z A-Z >/dev/null
+"$transform" --uncompressed --jobs 4 input.ifo four -- tr a-z A-Z >/dev/null
+for suffix in ifo idx dict; do cmp one.$suffix four.$suffix; done
+grep -q "DEFINITION NUMBER 99999" one.dict
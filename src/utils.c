@@ -27,6 +27,7 @@
 #include <glib/gstdio.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <stdarg.h>
 
@@ -269,17 +270,27 @@ dictionary_destroy (Dictionary *self)
 	g_free (self);
 }
 
-static gboolean
-dictionary_load (Dictionary *self, GError **e)
+static void
+dictionary_set_default_name (Dictionary *self)
 {
-	if (!(self->dict = stardict_dict_new (self->filename, e)))
-		return FALSE;
-
 	if (!self->name)
 	{
 		self->name = g_strdup (stardict_info_get_book_name
 			(stardict_dict_get_info (self->dict)));
 	}
+}
+
+static gboolean
+dictionary_load (Dictionary *self, GError **e)
+{
+	// Not all errors mention the file, and there may be many to choose from
+	if (!(self->dict = stardict_dict_new (self->filename, e)))
+	{
+		g_prefix_error (e, "%s: ", self->filename);
+		return FALSE;
+	}
+
+	dictionary_set_default_name (self);
 	return TRUE;
 }
 
@@ -327,3 +338,374 @@ load_dictionaries (GPtrArray *dictionaries, GError **e)
 	g_async_queue_unref (error_queue);
 	return result;
 }
+
+/// Only read information about dictionaries, leaving their data to be loaded
+/// once they're needed, or in advance with stardict_dict_load().
+gboolean
+open_dictionaries (GPtrArray *dictionaries, GError **e)
+{
+	for (guint i = 0; i < dictionaries->len; i++)
+	{
+		Dictionary *dictionary = g_ptr_array_index (dictionaries, i);
+		StardictInfo *info = stardict_info_new (dictionary->filename, e);
+		if (!info)
+			return FALSE;
+
+		dictionary->dict = stardict_dict_new_deferred (info);
+		dictionary_set_default_name (dictionary);
+	}
+	return TRUE;
+}
+
+static gint
+dictionary_last_used_cmp (gconstpointer a, gconstpointer b)
+{
+	gint64 ta = stardict_dict_get_last_used (*(StardictDict **) a);
+	gint64 tb = stardict_dict_get_last_used (*(StardictDict **) b);
+	return (ta > tb) - (ta < tb);
+}
+
+/// Release data of dictionaries that haven't been used for at least
+/// DICTIONARY_IDLE_TIMEOUT seconds, least recently used ones first,
+/// until all loaded data fit within @a budget bytes.
+void
+evict_dictionaries (GPtrArray *dictionaries, gsize budget)
+{
+	gint64 cutoff = g_get_monotonic_time ()
+		- (gint64) DICTIONARY_IDLE_TIMEOUT * G_USEC_PER_SEC;
+
+	gsize total = 0;
+	GPtrArray *idle = g_ptr_array_new ();
+	for (guint i = 0; i < dictionaries->len; i++)
+	{
+		StardictDict *dict =
+			((Dictionary *) g_ptr_array_index (dictionaries, i))->dict;
+		if (!dict || !stardict_dict_is_loaded (dict))
+			continue;
+
+		total += stardict_dict_get_memory_size (dict);
+		if (stardict_dict_get_last_used (dict) <= cutoff)
+			g_ptr_array_add (idle, dict);
+	}
+
+	g_ptr_array_sort (idle, dictionary_last_used_cmp);
+	for (guint i = 0; i < idle->len && total > budget; i++)
+	{
+		StardictDict *dict = g_ptr_array_index (idle, i);
+		gsize size = stardict_dict_get_memory_size (dict);
+		if (stardict_dict_unload (dict))
+			total -= MIN (total, size);
+	}
+	g_ptr_array_free (idle, TRUE);
+}
+
+// --- Statistics --------------------------------------------------------------
+
+static gdouble
+average (guint64 total, guint64 count)
+{
+	return count ? (gdouble) total / count : 0;
+}
+
+static gchar *
+format_latency_histogram (const StardictDictStats *stats)
+{
+	GString *s = g_string_new ("Search latency:");
+	const gchar *separator = " ";
+	for (guint i = 0; i < STARDICT_SEARCH_LATENCY_BUCKETS; i++)
+	{
+		guint64 count = stats->search_latency[i];
+		if (!count)
+			continue;
+
+		if (i + 1 < STARDICT_SEARCH_LATENCY_BUCKETS)
+			g_string_append_printf (s, "%s<%" G_GUINT64_FORMAT " us: %"
+				G_GUINT64_FORMAT, separator, (guint64) 1 << i, count);
+		else
+			g_string_append_printf (s, "%s>=%" G_GUINT64_FORMAT " us: %"
+				G_GUINT64_FORMAT, separator, (guint64) 1 << (i - 1), count);
+		separator = ", ";
+	}
+	return g_string_free (s, FALSE);
+}
+
+/// Describe a dictionary's statistics in a few lines of text.
+/// Returns a NULL-terminated array, to be freed with g_strfreev().
+gchar **
+format_dictionary_stats (StardictDict *dict)
+{
+	StardictDictStats stats;
+	stardict_dict_get_stats (dict, &stats);
+
+	GPtrArray *lines = g_ptr_array_new ();
+	g_ptr_array_add (lines, g_strdup_printf ("Loading: index %.1f ms,"
+		" data %.1f ms, synonyms %.1f ms, tables %.1f ms",
+		stats.load_idx_time / 1e3, stats.load_dict_time / 1e3,
+		stats.load_syn_time / 1e3, stats.load_collation_time / 1e3));
+	g_ptr_array_add (lines, g_strdup_printf ("Searches: %" G_GUINT64_FORMAT
+		", %.1f us and %.1f comparisons on average", stats.searches,
+		average (stats.search_time, stats.searches),
+		average (stats.search_comparisons, stats.searches)));
+	g_ptr_array_add (lines, format_latency_histogram (&stats));
+	g_ptr_array_add (lines, g_strdup_printf ("Entries: %" G_GUINT64_FORMAT
+		" read, %.1f us reading and %.1f us parsing on average",
+		stats.entries_read,
+		average (stats.entry_read_time, stats.entries_read),
+		average (stats.entry_parse_time, stats.entries_read)));
+	g_ptr_array_add (lines, g_strdup_printf ("Dictzip chunks: %"
+		G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %"
+		G_GUINT64_FORMAT " bytes inflated",
+		stats.chunk_hits, stats.chunk_misses, stats.chunk_inflated));
+
+	const StardictEntryCacheStats *cache = &stats.entry_cache;
+	g_ptr_array_add (lines, g_strdup_printf ("Entry cache: %"
+		G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %"
+		G_GUINT64_FORMAT " evictions, %u entries, %" G_GSIZE_FORMAT
+		" of %" G_GSIZE_FORMAT " bytes", cache->hits, cache->misses,
+		cache->evictions, cache->n_entries, cache->size, cache->limit));
+
+	g_ptr_array_add (lines, NULL);
+	return (gchar **) g_ptr_array_free (lines, FALSE);
+}
+
+// --- Merged search -----------------------------------------------------------
+
+// Each dictionary is searched and has its entries preloaded within a thread
+// pool, then its results are merged into the others' in the main context,
+// so that slow dictionaries (e.g., dictzip with cold chunks) don't hold up
+// the rest.  Since the dictionaries can be collated each in its own way,
+// all results are ordered by the collation of the current locale instead.
+
+typedef struct merged_job MergedJob;
+
+struct merged_job
+{
+	MergedSearch *search;            ///< The search this is a part of
+	StardictDict *dict;              ///< The dictionary to search in
+	guint         dictionary;        ///< Index of the dictionary
+	GArray       *results;           ///< Sorted MergedResult-s
+	gboolean      truncated;         ///< Results have hit the limit
+};
+
+static void
+merged_result_clear (MergedResult *self)
+{
+	g_object_unref (self->dict);
+	g_free (self->key);
+}
+
+static gint
+merged_result_cmp (const MergedResult *a, const MergedResult *b)
+{
+	gint cmp = strcmp (a->key, b->key);
+	if (!cmp)
+		cmp = (a->dictionary > b->dictionary) - (a->dictionary < b->dictionary);
+	if (!cmp)
+		cmp = (a->position > b->position) - (a->position < b->position);
+	return cmp;
+}
+
+static MergedSearch *
+merged_search_ref (MergedSearch *self)
+{
+	g_atomic_int_inc (&self->ref_count);
+	return self;
+}
+
+static void
+merged_search_unref (MergedSearch *self)
+{
+	if (!g_atomic_int_dec_and_test (&self->ref_count))
+		return;
+
+	g_array_unref (self->results);
+	g_free (self->word);
+	g_free (self->horizon);
+	g_main_context_unref (self->context);
+	g_slice_free (MergedSearch, self);
+}
+
+static void
+merged_job_free (MergedJob *self)
+{
+	// Results that haven't been merged in are still owned by the job
+	for (guint i = 0; i < self->results->len; i++)
+		merged_result_clear (&g_array_index (self->results, MergedResult, i));
+	g_array_free (self->results, TRUE);
+
+	g_object_unref (self->dict);
+	merged_search_unref (self->search);
+	g_slice_free (MergedJob, self);
+}
+
+/// Merge a sorted run of results into the sorted results of the search.
+static void
+merged_search_merge (MergedSearch *self, MergedJob *job)
+{
+	guint a = self->results->len, b = job->results->len;
+	if (!b)
+		return;
+
+	// The dictionary may have further entries past its last result,
+	// so nothing beyond that can be relied upon to be complete
+	const gchar *last = g_array_index (job->results, MergedResult, b - 1).key;
+	if (job->truncated && (!self->horizon || strcmp (last, self->horizon) < 0))
+	{
+		g_free (self->horizon);
+		self->horizon = g_strdup (last);
+	}
+
+	// Going from the back, nothing gets overwritten before it's been moved
+	g_array_set_size (self->results, a + b);
+	MergedResult *out = (MergedResult *) self->results->data;
+	MergedResult *in = (MergedResult *) job->results->data;
+	for (guint i = a + b; b; )
+		if (a && merged_result_cmp (&out[a - 1], &in[b - 1]) > 0)
+			out[--i] = out[--a];
+		else
+			out[--i] = in[--b];
+
+	// Ownership has been transferred, the job must not clear anything
+	g_array_set_size (job->results, 0);
+
+	guint len = self->results->len;
+	while (self->horizon && len && strcmp (g_array_index
+		(self->results, MergedResult, len - 1).key, self->horizon) > 0)
+		len--;
+	g_array_set_size (self->results, len);
+}
+
+static gboolean
+merged_search_on_job_done (gpointer data)
+{
+	MergedJob *job = data;
+	MergedSearch *self = job->search;
+	self->pending--;
+
+	if (!g_atomic_int_get (&self->cancelled))
+	{
+		self->last_dictionary = job->dictionary;
+		merged_search_merge (self, job);
+		self->callback (self, self->user_data);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static void
+merged_search_worker (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+	MergedJob *job = data;
+	MergedSearch *self = job->search;
+
+	StardictIterator *iterator = stardict_dict_search (job->dict,
+		self->word, NULL);
+	while (stardict_iterator_is_valid (iterator)
+		&& !g_atomic_int_get (&self->cancelled))
+	{
+		if (job->results->len == self->limit)
+		{
+			job->truncated = TRUE;
+			break;
+		}
+
+		const gchar *word = stardict_iterator_get_word (iterator);
+		MergedResult result =
+		{
+			.dict = g_object_ref (job->dict),
+			.dictionary = job->dictionary,
+			.position = stardict_iterator_get_offset (iterator),
+			.key = g_utf8_collate_key (word, -1),
+		};
+		g_array_append_val (job->results, result);
+
+		// This is what tends to take time, and the entry cache will keep it
+		StardictEntry *entry = stardict_iterator_get_entry (iterator);
+		if (entry)
+			g_object_unref (entry);
+
+		stardict_iterator_next (iterator);
+	}
+	g_object_unref (iterator);
+
+	g_array_sort (job->results, (GCompareFunc) merged_result_cmp);
+
+	GSource *source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_DEFAULT);
+	g_source_set_callback (source, merged_search_on_job_done,
+		job, (GDestroyNotify) merged_job_free);
+	g_source_attach (source, self->context);
+	g_source_unref (source);
+}
+
+/// Search for a word in all loaded dictionaries at once, taking at most
+/// @a limit entries from each of them, starting at the word's position.
+/// The callback is invoked within the thread-default main context every time
+/// results of another dictionary have been merged in.
+MergedSearch *
+merged_search_new (GPtrArray *dictionaries, const gchar *word,
+	guint limit, MergedSearchCallback callback, gpointer user_data)
+{
+	MergedSearch *self = g_slice_new0 (MergedSearch);
+	self->ref_count = 1;
+	self->results = g_array_new (FALSE, FALSE, sizeof (MergedResult));
+	g_array_set_clear_func (self->results,
+		(GDestroyNotify) merged_result_clear);
+
+	self->word = g_strdup (word);
+	self->limit = limit;
+	self->context = g_main_context_ref_thread_default ();
+	self->callback = callback;
+	self->user_data = user_data;
+
+	// Threads of non-exclusive pools are shared, so this is fairly cheap
+	GThreadPool *pool = g_thread_pool_new (merged_search_worker, NULL,
+		g_get_num_processors (), FALSE, NULL);
+	for (guint i = 0; i < dictionaries->len; i++)
+	{
+		Dictionary *dictionary = g_ptr_array_index (dictionaries, i);
+		if (!dictionary->dict)
+			continue;
+
+		MergedJob *job = g_slice_new0 (MergedJob);
+		job->search = merged_search_ref (self);
+		job->dict = g_object_ref (dictionary->dict);
+		job->dictionary = i;
+		job->results = g_array_new (FALSE, FALSE, sizeof (MergedResult));
+
+		self->pending++;
+		g_thread_pool_push (pool, job, NULL);
+	}
+
+	// The pool is only destroyed once all of its jobs have been processed
+	g_thread_pool_free (pool, FALSE, FALSE);
+	return self;
+}
+
+/// While within the callback, find out where the result at @a index
+/// has moved to, since the last time the callback has been invoked.
+/// Results that have since been dropped map to the last remaining one,
+/// which is indicated through @a dropped.
+guint
+merged_search_remap (MergedSearch *self, guint index, gboolean *dropped)
+{
+	// All results of the dictionary just merged in are new,
+	// and the relative order of the preceding results hasn't changed.
+	// A lowered horizon may have cut off any of them from the end, though.
+	guint i = 0;
+	*dropped = FALSE;
+	for (; i < self->results->len; i++)
+		if (g_array_index (self->results, MergedResult, i).dictionary
+			!= self->last_dictionary && !index--)
+			return i;
+
+	*dropped = TRUE;
+	return i ? i - 1 : 0;
+}
+
+/// Stop delivering results, and release the search.
+void
+merged_search_free (MergedSearch *self)
+{
+	g_atomic_int_set (&self->cancelled, TRUE);
+	merged_search_unref (self);
+}
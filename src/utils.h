@@ -27,7 +27,11 @@
 /// After this statement, the element has been found and its index is stored
 /// in the variable "imid".
 #define BINARY_SEARCH_BEGIN(max, compare)                                     \
-	gint imin = 0, imax = max, imid;                                          \
+	BINARY_SEARCH_RANGE_BEGIN (0, max, compare)
+
+/// Like BINARY_SEARCH_BEGIN, only limited to indexes from "min" to "max".
+#define BINARY_SEARCH_RANGE_BEGIN(min, max, compare)                          \
+	gint imin = min, imax = max, imid;                                        \
 	while (imin <= imax) {                                                    \
 		imid = imin + (imax - imin) / 2;                                      \
 		gint cmp = compare;                                                   \
@@ -67,7 +71,59 @@ struct dictionary
 	gchar        *name;              ///< Name to show
 };
 
+/// Dictionaries unused for this many seconds may have their data released
+#define DICTIONARY_IDLE_TIMEOUT  300
+
+/// The default amount of memory that loaded dictionaries may take
+#define DICTIONARY_MEMORY_BUDGET  (256 << 20)
+
 void dictionary_destroy (Dictionary *self);
 gboolean load_dictionaries (GPtrArray *dictionaries, GError **e);
+gboolean open_dictionaries (GPtrArray *dictionaries, GError **e);
+void evict_dictionaries (GPtrArray *dictionaries, gsize budget);
+
+// --- Statistics --------------------------------------------------------------
+
+gchar **format_dictionary_stats (StardictDict *dict);
+
+// --- Merged search -----------------------------------------------------------
+
+typedef struct merged_result MergedResult;
+typedef struct merged_search MergedSearch;
+
+/// Called in the main context whenever results of a dictionary come in.
+typedef void (*MergedSearchCallback) (MergedSearch *search, gpointer user_data);
+
+struct merged_result
+{
+	StardictDict *dict;              ///< The dictionary of the entry
+	guint         dictionary;        ///< Index of the Dictionary it came from
+	guint32       position;          ///< Index position of the entry
+	gchar        *key;               ///< Collation key of the entry's word
+};
+
+struct merged_search
+{
+	gint          ref_count;         ///< Reference count
+	gint          cancelled;         ///< Results are no longer wanted
+
+	GArray       *results;           ///< MergedResult-s in collation order
+	guint         pending;           ///< Dictionaries still being searched
+
+	gchar        *word;              ///< The word being searched for
+	guint         limit;             ///< Maximum results per dictionary
+	gchar        *horizon;           ///< Key past which results may be missing
+	guint         last_dictionary;   ///< Dictionary just merged in
+
+	GMainContext *context;           ///< Where results are delivered
+	MergedSearchCallback callback;   ///< Result notification callback
+	gpointer      user_data;         ///< User data for the callback
+};
+
+MergedSearch *merged_search_new (GPtrArray *dictionaries, const gchar *word,
+	guint limit, MergedSearchCallback callback, gpointer user_data);
+guint merged_search_remap
+	(MergedSearch *self, guint index, gboolean *dropped);
+void merged_search_free (MergedSearch *self);
 
 #endif  // ! UTILS_H